@@ -50,16 +50,54 @@ JsonObjects::JsonObjects() {
     field_aliases = insert_array_field(toplevel, "field_aliases");
 }
 
-Util::JsonObject*
-JsonObjects::find_object_by_name(Util::JsonArray* array, const cstring& name) {
-    for (auto e : *array) {
-        auto obj = e->to<Util::JsonObject>();
-        auto val = obj->get("name")->to<Util::JsonValue>();
-        if (val != nullptr && val->isString() && val->getString() == name) {
-            return obj;
+void JsonArrayIndex::update() {
+    for (; indexed < array->size(); ++indexed) {
+        auto obj = array->at(indexed)->to<Util::JsonObject>();
+        if (obj == nullptr)
+            continue;
+        auto name = obj->get("name");
+        if (name != nullptr) {
+            auto val = name->to<Util::JsonValue>();
+            if (val != nullptr && val->isString())
+                byName.emplace(val->getString(), obj);
+        }
+        auto id = obj->get("id");
+        if (id != nullptr) {
+            auto val = id->to<Util::JsonValue>();
+            if (val != nullptr && val->isNumber() && val->getValue().fits_uint_p())
+                byId.emplace(val->getValue().get_ui(), obj);
         }
     }
-    return nullptr;
+}
+
+Util::JsonObject* JsonArrayIndex::getByName(cstring name) {
+    update();
+    auto it = byName.find(name);
+    return it == byName.end() ? nullptr : it->second;
+}
+
+Util::JsonObject* JsonArrayIndex::getById(unsigned id) {
+    update();
+    auto it = byId.find(id);
+    return it == byId.end() ? nullptr : it->second;
+}
+
+JsonArrayIndex& JsonObjects::indexOf(const Util::JsonArray* array) {
+    CHECK_NULL(array);
+    auto it = indexes.find(array);
+    if (it == indexes.end())
+        it = indexes.emplace(array, JsonArrayIndex(array)).first;
+    return it->second;
+}
+
+Util::JsonObject*
+JsonObjects::find_object_by_name(Util::JsonArray* array, const cstring& name) {
+    return indexOf(array).getByName(name);
+}
+
+Util::JsonObject*
+JsonObjects::find_object_by_id(Util::JsonArray* array, unsigned id) {
+    return indexOf(array).getById(id);
 }
 
 /// Insert a json array to a parent object under key 'name'.
@@ -189,6 +227,7 @@ void
 JsonObjects::add_header_field(const cstring& name, Util::JsonArray*& field) {
     CHECK_NULL(field);
     Util::JsonObject* headerType = find_object_by_name(header_types, name);
+    BUG_CHECK(headerType != nullptr, "header type '%1%' not found", name);
     Util::JsonArray* fields = headerType->get("fields")->to<Util::JsonArray>();
     BUG_CHECK(fields != nullptr, "header '%1%' not found", name);
     fields->append(field);
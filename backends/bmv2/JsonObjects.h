@@ -18,17 +18,40 @@ limitations under the License.
 #define _BACKENDS_BMV2_JSONOBJECTS_H_
 
 #include <map>
+#include <unordered_map>
 #include "lib/json.h"
 #include "lib/ordered_map.h"
 
 namespace BMV2 {
 
+/// Indexes the objects in a json array by their "name" and "id" fields.
+/// The converters append to the top-level arrays directly, so the index
+/// picks up elements added since the previous lookup before each lookup.
+/// Elements are never removed from these arrays.
+class JsonArrayIndex {
+    const Util::JsonArray* array;
+    size_t indexed = 0;  // number of array elements already in the maps
+    std::unordered_map<cstring, Util::JsonObject*> byName;
+    std::unordered_map<unsigned, Util::JsonObject*> byId;
+    void update();
+
+ public:
+    explicit JsonArrayIndex(const Util::JsonArray* array) : array(array) {}
+    /// @return the first object with this name, or nullptr.
+    Util::JsonObject* getByName(cstring name);
+    /// @return the first object with this id, or nullptr.
+    Util::JsonObject* getById(unsigned id);
+};
+
 class JsonObjects {
- protected:
+    std::unordered_map<const Util::JsonArray*, JsonArrayIndex> indexes;
+    JsonArrayIndex& indexOf(const Util::JsonArray* array);
+
+ public:
     Util::JsonObject* find_object_by_name(Util::JsonArray* array,
                                           const cstring& name);
+    Util::JsonObject* find_object_by_id(Util::JsonArray* array, unsigned id);
 
- public:
     void add_program_info(const cstring& name);
     void add_meta_info();
     unsigned add_header_type(const cstring& name, Util::JsonArray*& fields, unsigned max_length);
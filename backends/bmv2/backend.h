@@ -108,8 +108,8 @@ class Backend : public PassManager {
         target(Target::SIMPLE) { refMap->setIsV1(isV1); setName("BackEnd"); }
     void process(const IR::ToplevelBlock* block, BMV2Options& options);
     void convert(BMV2Options& options);
-    void serialize(std::ostream& out) const
-    { jsonTop.serialize(out); }
+    void serialize(std::ostream& out, bool compact = false) const
+    { jsonTop.serialize(out, compact); }
     P4::P4CoreLibrary &   getCoreLibrary() const   { return corelib; }
     ErrorCodesMap &       getErrorCodesMap()       { return errorCodesMap; }
     ExpressionConverter * getExpressionConverter() { return conv; }
@@ -20,8 +20,10 @@ limitations under the License.
 
 #include "ir/ir.h"
 #include "control-plane/p4RuntimeSerializer.h"
+#include "frontends/common/compileServer.h"
 #include "frontends/common/parseInput.h"
 #include "frontends/p4/frontend.h"
+#include "lib/arena.h"
 #include "lib/error.h"
 #include "lib/exceptions.h"
 #include "lib/gc.h"
@@ -32,9 +34,7 @@ limitations under the License.
 #include "options.h"
 #include "JsonObjects.h"
 
-int main(int argc, char *const argv[]) {
-    setup_gc_logging();
-
+static int runCompiler(int argc, char *const argv[]) {
     BMV2::BMV2Options options;
     options.langVersion = BMV2::BMV2Options::FrontendVersion::P4_16;
     options.compilerVersion = "0.0.5";
@@ -48,6 +48,9 @@ int main(int argc, char *const argv[]) {
 
     // BMV2 is required for compatibility with the previous compiler.
     options.preprocessor_options += " -D__TARGET_BMV2__";
+    // The IR of this compilation lives in one arena, if requested.
+    Arena arena;
+    Arena::Scope arenaScope(options.irArena ? &arena : nullptr);
     auto program = P4::parseP4File(options);
     if (program == nullptr || ::errorCount() > 0)
         return 1;
@@ -96,7 +99,7 @@ int main(int argc, char *const argv[]) {
     if (!options.outputFile.isNullOrEmpty()) {
         std::ostream* out = openFile(options.outputFile, false);
         if (out != nullptr) {
-            backend.serialize(*out);
+            backend.serialize(*out, options.compactJson);
             out->flush();
         }
     }
@@ -105,3 +108,8 @@ int main(int argc, char *const argv[]) {
 
     return ::errorCount() > 0;
 }
+
+int main(int argc, char *const argv[]) {
+    setup_gc_logging();
+    return P4::compileMain(argc, argv, runCompiler);
+}
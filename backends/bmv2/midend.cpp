@@ -82,6 +82,8 @@ MidEnd::MidEnd(BMV2Options& options) {
     bool isv1 = options.isv1();
     setName("MidEnd");
     refMap.setIsV1(isv1);  // must be done BEFORE creating passes
+    refMap.setIncremental(options.incrementalMaps);
+    typeMap.setIncremental(options.incrementalMaps);
     auto evaluator = new P4::EvaluatorPass(&refMap, &typeMap);
     auto convertEnums = new P4::ConvertEnums(&refMap, &typeMap, new EnumOn32Bits());
     addPasses({
@@ -27,6 +27,8 @@ enum class Target { UNKNOWN, PORTABLE, SIMPLE };
 class BMV2Options : public CompilerOptions {
  public:
     BMV2::Target arch = BMV2::Target::UNKNOWN;
+    // write the output json without any whitespace
+    bool compactJson = false;
     BMV2Options() {
         registerOption("--arch", "arch",
                        [this](const char* arg) {
@@ -39,6 +41,9 @@ class BMV2Options : public CompilerOptions {
                         }
                         return true; },
                        "Compile for the specified architecture (psa or ss), default is ss.");
+        registerOption("--json-compact", nullptr,
+                       [this](const char*) { compactJson = true; return true; },
+                       "Write the output json without indentation or line breaks.");
      }
 };
 
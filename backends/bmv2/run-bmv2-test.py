@@ -301,6 +301,9 @@ def main(argv):
         if options.testName.endswith('.p4'):
             options.testName = options.testName[:-3]
         options.testName = "bmv2/" + options.testName
+        if "--json-compact" in options.compilerOptions:
+            # runs beside the test of the same program with indented json
+            options.testName += "-compact"
 
     if not options.observationLog:
         if options.testName:
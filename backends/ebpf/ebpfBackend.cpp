@@ -41,8 +41,11 @@ void run_ebpf_backend(const EbpfOptions& options, const IR::ToplevelBlock* tople
         target = new BccTarget();
     } else if (options.target == "kernel") {
         target = new KernelSamplesTarget();
+    } else if (options.target == "xdp") {
+        target = new XdpTarget();
     } else {
-        ::error("Unknown target %s; legal choices are 'bcc' and 'kernel'", options.target);
+        ::error("Unknown target %s; legal choices are 'bcc', 'kernel' and 'xdp'",
+                options.target);
         return;
     }
 
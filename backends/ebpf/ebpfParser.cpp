@@ -29,7 +29,8 @@ class StateTranslationVisitor : public CodeGenInspector {
     const EBPFParserState* state;
 
     void compileExtractField(const IR::Expression* expr, cstring name,
-                             unsigned alignment, EBPFType* type);
+                             unsigned alignment, EBPFType* type,
+                             cstring data, cstring byteOffset, bool advance);
     void compileExtract(const IR::Vector<IR::Expression>* args);
 
  public:
@@ -124,7 +125,8 @@ bool StateTranslationVisitor::preorder(const IR::SelectCase* selectCase) {
 
 void
 StateTranslationVisitor::compileExtractField(
-    const IR::Expression* expr, cstring field, unsigned alignment, EBPFType* type) {
+    const IR::Expression* expr, cstring field, unsigned alignment, EBPFType* type,
+    cstring data, cstring byteOffset, bool advance) {
     unsigned widthToExtract = dynamic_cast<IHasWidth*>(type)->widthInBits();
     auto program = state->parser->program;
 
@@ -155,10 +157,8 @@ StateTranslationVisitor::compileExtractField(
         visit(expr);
         builder->appendFormat(".%s = (", field.c_str());
         type->emit(builder);
-        builder->appendFormat(")((%s(%s, BYTES(%s))",
-                              helper,
-                              program->packetStartVar.c_str(),
-                              program->offsetVar.c_str());
+        builder->appendFormat(")((%s(%s, %s)",
+                              helper, data.c_str(), byteOffset.c_str());
         if (shift != 0)
             builder->appendFormat(" >> %d", shift);
         builder->append(")");
@@ -191,10 +191,8 @@ StateTranslationVisitor::compileExtractField(
             visit(expr);
             builder->appendFormat(".%s[%d] = (", field.c_str(), i);
             bt->emit(builder);
-            builder->appendFormat(")((%s(%s, BYTES(%s) + %d) >> %d)",
-                                  helper,
-                                  program->packetStartVar.c_str(),
-                                  program->offsetVar.c_str(), i, shift);
+            builder->appendFormat(")((%s(%s, %s + %d) >> %d)",
+                                  helper, data.c_str(), byteOffset.c_str(), i, shift);
 
             if ((i == bytes - 1) && (widthToExtract % 8 != 0)) {
                 builder->append(" & EBPF_MASK(");
@@ -207,9 +205,11 @@ StateTranslationVisitor::compileExtractField(
         }
     }
 
-    builder->emitIndent();
-    builder->appendFormat("%s += %d", program->offsetVar.c_str(), widthToExtract);
-    builder->endOfStatement(true);
+    if (advance) {
+        builder->emitIndent();
+        builder->appendFormat("%s += %d", program->offsetVar.c_str(), widthToExtract);
+        builder->endOfStatement(true);
+    }
     builder->newline();
 }
 
@@ -247,7 +247,29 @@ StateTranslationVisitor::compileExtract(const IR::Vector<IR::Expression>* args)
     builder->newline();
     builder->blockEnd(true);
 
+    // Either every field is read from the packet, or the header is copied
+    // from the packet with one read and the fields are read from the copy.
+    // The copy is padded, as the loads of the last field may go past the
+    // end of the header.
+    bool coalesce = builder->target->coalesceHeaderReads();
+    cstring data = program->packetStartVar;
+    if (coalesce) {
+        unsigned bytes = ROUNDUP(width, 8);
+        builder->emitIndent();
+        builder->blockStart();
+        builder->emitIndent();
+        builder->appendFormat("u8 %s[%d] = { 0 };", program->headerCopyVar.c_str(), bytes + 3);
+        builder->newline();
+        builder->emitIndent();
+        builder->appendFormat("__builtin_memcpy(%s, %s + BYTES(%s), %d);",
+                              program->headerCopyVar.c_str(), program->packetStartVar.c_str(),
+                              program->offsetVar.c_str(), bytes);
+        builder->newline();
+        data = program->headerCopyVar;
+    }
+
     unsigned alignment = 0;
+    unsigned fieldOffset = 0;
     for (auto f : ht->fields) {
         auto ftype = state->parser->typeMap->getType(f);
         auto etype = EBPFTypeFactory::instance->create(ftype);
@@ -256,11 +278,21 @@ StateTranslationVisitor::compileExtract(const IR::Vector<IR::Expression>* args)
             ::error("Only headers with fixed widths supported %1%", f);
             return;
         }
-        compileExtractField(expr, f->name, alignment, etype);
+        cstring byteOffset = coalesce ? Util::toString(fieldOffset / 8)
+                                      : cstring("BYTES(" + program->offsetVar + ")");
+        compileExtractField(expr, f->name, alignment, etype, data, byteOffset, !coalesce);
+        fieldOffset += et->widthInBits();
         alignment += et->widthInBits();
         alignment %= 8;
     }
 
+    if (coalesce) {
+        builder->blockEnd(true);
+        builder->emitIndent();
+        builder->appendFormat("%s += %d", program->offsetVar.c_str(), width);
+        builder->endOfStatement(true);
+    }
+
     builder->emitIndent();
     visit(expr);
     builder->appendLine(".ebpf_valid = 1;");
@@ -78,9 +78,7 @@ void EBPFProgram::emitC(CodeBuilder* builder, cstring header) {
     // HACK to force LLVM to put the headers on the stack.
     // This should not be needed, but the llvm bpf back-end seems to be broken.
     builder->emitIndent();
-    builder->append("printk(\"%p\", ");
-    builder->append(parser->headers->name);
-    builder->append(")");
+    builder->target->emitKeepOnStack(builder, parser->headers->name.name);
     builder->endOfStatement(true);
 
     emitLocalVariables(builder);
@@ -97,7 +95,7 @@ void EBPFProgram::emitC(CodeBuilder* builder, cstring header) {
     builder->appendLine(":");
     builder->emitIndent();
     builder->append("return ");
-    builder->append(control->accept->name.name);
+    builder->append(builder->target->verdict(control->accept->name.name));
     builder->appendLine(";");
     builder->blockEnd(true);  // end of function
 
@@ -46,7 +46,7 @@ class EBPFProgram : public EBPFObject {
 
     cstring endLabel, offsetVar, lengthVar;
     cstring zeroKey, functionName, errorVar;
-    cstring packetStartVar, packetEndVar, byteVar;
+    cstring packetStartVar, packetEndVar, byteVar, headerCopyVar;
     cstring errorEnum;
     cstring license = "GPL";  // TODO: this should be a compiler option probably
     cstring arrayIndexType = "u32";
@@ -65,6 +65,7 @@ class EBPFProgram : public EBPFObject {
         packetStartVar = EBPFModel::reserved("packetStart");
         packetEndVar = EBPFModel::reserved("packetEnd");
         byteVar = EBPFModel::reserved("byte");
+        headerCopyVar = EBPFModel::reserved("headerCopy");
         endLabel = EBPFModel::reserved("end");
         errorEnum = EBPFModel::reserved("errorCodes");
     }
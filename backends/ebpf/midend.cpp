@@ -70,6 +70,8 @@ const IR::ToplevelBlock* MidEnd::run(EbpfOptions& options, const IR::P4Program*
 
     bool isv1 = options.langVersion == CompilerOptions::FrontendVersion::P4_14;
     refMap.setIsV1(isv1);
+    refMap.setIncremental(options.incrementalMaps);
+    typeMap.setIncremental(options.incrementalMaps);
     auto evaluator = new P4::EvaluatorPass(&refMap, &typeMap);
 
     PassManager simplify = {
@@ -20,6 +20,7 @@ limitations under the License.
 
 #include "ir/ir.h"
 #include "lib/log.h"
+#include "lib/arena.h"
 #include "lib/crash.h"
 #include "lib/exceptions.h"
 #include "lib/gc.h"
@@ -28,6 +29,7 @@ limitations under the License.
 #include "midend.h"
 #include "ebpfOptions.h"
 #include "ebpfBackend.h"
+#include "frontends/common/compileServer.h"
 #include "frontends/common/parseInput.h"
 #include "frontends/p4/frontend.h"
 
@@ -38,6 +40,9 @@ void compile(EbpfOptions& options) {
         ::error("This compiler only handles P4-16");
         return;
     }
+    // The IR of this compilation lives in one arena, if requested.
+    Arena arena;
+    Arena::Scope arenaScope(options.irArena ? &arena : nullptr);
     auto program = P4::parseP4File(options);
     if (::errorCount() > 0)
         return;
@@ -58,10 +63,7 @@ void compile(EbpfOptions& options) {
     EBPF::run_ebpf_backend(options, toplevel, &midend.refMap, &midend.typeMap);
 }
 
-int main(int argc, char *const argv[]) {
-    setup_gc_logging();
-    setup_signals();
-
+static int runCompiler(int argc, char *const argv[]) {
     EbpfOptions options;
     options.compilerVersion = "0.0.1";
 
@@ -81,3 +83,9 @@ int main(int argc, char *const argv[]) {
         std::cerr << "Done." << std::endl;
     return ::errorCount() > 0;
 }
+
+int main(int argc, char *const argv[]) {
+    setup_gc_logging();
+    setup_signals();
+    return P4::compileMain(argc, argv, runCompiler);
+}
@@ -25,6 +25,8 @@ import stat
 import tempfile
 import shutil
 import difflib
+import platform
+import re
 
 SUCCESS = 0
 FAILURE = 1
@@ -38,6 +40,7 @@ class Options(object):
         self.verbose = False
         self.replace = False            # replace previous outputs
         self.compilerOptions = []
+        self.clang = None               # compile the output with this clang
 
 def usage(options):
     name = options.binary
@@ -49,6 +52,8 @@ def usage(options):
     print("          -b: do not remove temporary results for failing tests")
     print("          -v: verbose operation")
     print("          -f: replace reference outputs with newly generated ones")
+    print("          -a \"args\": pass args to the compiler")
+    print("          -c clang: compile the generated C with clang for the BPF target")
 
 def isError(p4filename):
     # True if the filename represents a p4 program that should fail
@@ -128,6 +133,41 @@ def check_generated_files(options, tmpdir, expecteddir):
                 return result
     return SUCCESS
 
+def isXdp(options):
+    return "--target=xdp" in options.compilerOptions
+
+def check_xdp_output(options, cfile):
+    # The XDP target reads packet data directly, so the generated code must
+    # keep to what the verifier accepts: every header is copied from the
+    # packet once, and its fields are read from that copy.
+    code = open(cfile).read()
+    errors = []
+    if re.search(r"load_(byte|half|word)\(ebpf_packetStart\b", code):
+        errors.append("header fields are read from the packet instead of ebpf_headerCopy")
+    if "load_" in code and "__builtin_memcpy(ebpf_headerCopy, ebpf_packetStart" not in code:
+        errors.append("headers are not copied from the packet")
+    if "printk(" in code:
+        errors.append("the program calls printk")
+    if not re.search(r'asm volatile\(\"\" : : \"r\"\(&', code):
+        errors.append("the headers are not kept on the stack")
+    for e in errors:
+        print(cfile + ": " + e, file=sys.stderr)
+    return FAILURE if errors else SUCCESS
+
+def compile_bpf(options, cfile):
+    # Compile the generated C like a program of the kernel source tree, with
+    # the headers in runtime standing in for the kernel's.
+    runtime = os.path.join(options.compilerSrcdir, "backends", "ebpf", "runtime")
+    args = [options.clang, "-O2", "-target", "bpf", "-I", runtime]
+    multiarch = "/usr/include/" + platform.machine() + "-linux-gnu"
+    if os.path.isdir(multiarch):
+        args += ["-idirafter", multiarch]
+    args += ["-c", cfile, "-o", os.path.splitext(cfile)[0] + ".o"]
+    result = run_timeout(options, args, timeout, None)
+    if result != SUCCESS:
+        print("Error compiling the generated C for the BPF target")
+    return result
+
 def process_file(options, argv):
     assert isinstance(options, Options)
 
@@ -145,7 +185,7 @@ def process_file(options, argv):
 
     if not os.path.isfile(options.p4filename):
         raise Exception("No such file " + options.p4filename)
-    args = ["./p4c-ebpf", "-o", ppfile]
+    args = ["./p4c-ebpf", "-o", ppfile] + options.compilerOptions
     args.extend(argv)
 
     result = run_timeout(options, args, timeout, stderr)
@@ -160,6 +200,11 @@ def process_file(options, argv):
             result = FAILURE
         else:
             result = SUCCESS
+    else:
+        if result == SUCCESS and isXdp(options):
+            result = check_xdp_output(options, ppfile)
+        if result == SUCCESS and options.clang is not None and isXdp(options):
+            result = compile_bpf(options, ppfile)
 
     if options.cleanupTmp:
         if options.verbose:
@@ -197,6 +242,20 @@ def main(argv):
             options.verbose = True
         elif argv[0] == "-f":
             options.replace = True
+        elif argv[0] == "-a":
+            if len(argv) == 1:
+                print("Missing argument for -a option", file=sys.stderr)
+                usage(options)
+                sys.exit(FAILURE)
+            options.compilerOptions += argv[1].split()
+            argv = argv[1:]
+        elif argv[0] == "-c":
+            if len(argv) == 1:
+                print("Missing argument for -c option", file=sys.stderr)
+                usage(options)
+                sys.exit(FAILURE)
+            options.clang = argv[1]
+            argv = argv[1:]
         else:
             print("Uknown option ", argv[0], file=sys.stderr)
             usage(options)
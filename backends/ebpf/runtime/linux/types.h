@@ -0,0 +1,33 @@
+/*
+Copyright 2013-present Barefoot Networks, Inc.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+/* Stands in for the kernel's include/linux/types.h when the programs
+   generated for the XDP target are compiled outside the kernel source
+   tree, as the tests do: the kernel's integer types, on top of the uapi
+   ones. */
+
+#ifndef _BACKENDS_EBPF_RUNTIME_LINUX_TYPES_H_
+#define _BACKENDS_EBPF_RUNTIME_LINUX_TYPES_H_
+
+#include_next <linux/types.h>
+#include <stddef.h>
+
+typedef __u8 u8;
+typedef __u16 u16;
+typedef __u32 u32;
+typedef __u64 u64;
+
+#endif /* _BACKENDS_EBPF_RUNTIME_LINUX_TYPES_H_ */
@@ -0,0 +1,25 @@
+/*
+Copyright 2013-present Barefoot Networks, Inc.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+/* Stands in for the kernel's include/uapi/linux/bpf.h, which is installed
+   as linux/bpf.h. */
+
+#ifndef _BACKENDS_EBPF_RUNTIME_UAPI_LINUX_BPF_H_
+#define _BACKENDS_EBPF_RUNTIME_UAPI_LINUX_BPF_H_
+
+#include <linux/bpf.h>
+
+#endif /* _BACKENDS_EBPF_RUNTIME_UAPI_LINUX_BPF_H_ */
@@ -19,6 +19,14 @@ limitations under the License.
 
 namespace EBPF {
 
+void Target::emitKeepOnStack(Util::SourceCodeBuilder* builder, cstring var) const {
+    builder->append("printk(\"%p\", ");
+    builder->append(var);
+    builder->append(")");
+}
+
+//////////////////////////////////////////////////////////////
+
 void KernelSamplesTarget::emitIncludes(Util::SourceCodeBuilder* builder) const {
     builder->append(
         "#include <linux/skbuff.h>\n"
@@ -119,6 +127,74 @@ void KernelSamplesTarget::emitMain(Util::SourceCodeBuilder* builder,
 
 //////////////////////////////////////////////////////////////
 
+// The generated C file includes the generated header, and both start with
+// these definitions, so they are guarded.
+void XdpTarget::emitIncludes(Util::SourceCodeBuilder* builder) const {
+    builder->append(
+        "#ifndef _P4_XDP_INCLUDES_\n"
+        "#define _P4_XDP_INCLUDES_\n"
+        "#include <linux/types.h>\n"
+        "#include <linux/version.h>\n"
+        "#include <uapi/linux/bpf.h>\n"
+        "#define SEC(NAME) __attribute__((section(NAME), used))\n"
+        "static void *(*bpf_map_lookup_elem)(void *map, void *key) =\n"
+        "       (void *) BPF_FUNC_map_lookup_elem;\n"
+        "static int (*bpf_map_update_elem)(void *map, void *key, void *value,\n"
+        "                                  unsigned long long flags) =\n"
+        "       (void *) BPF_FUNC_map_update_elem;\n"
+        "#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__\n"
+        "#define bpf_ntohs(x) __builtin_bswap16(x)\n"
+        "#define bpf_ntohl(x) __builtin_bswap32(x)\n"
+        "#else\n"
+        "#define bpf_ntohs(x) (x)\n"
+        "#define bpf_ntohl(x) (x)\n"
+        "#endif\n"
+        "/* Fields are not aligned, so they are read with memcpy, which the\n"
+        "   compiler turns into loads that the verifier accepts. */\n"
+        "static inline __attribute__((always_inline))\n"
+        "u8 load_byte(const void *data, u64 b) {\n"
+        "        return *((const u8 *)data + b);\n"
+        "}\n"
+        "static inline __attribute__((always_inline))\n"
+        "u16 load_half(const void *data, u64 b) {\n"
+        "        u16 v;\n"
+        "        __builtin_memcpy(&v, (const u8 *)data + b, sizeof(v));\n"
+        "        return bpf_ntohs(v);\n"
+        "}\n"
+        "static inline __attribute__((always_inline))\n"
+        "u32 load_word(const void *data, u64 b) {\n"
+        "        u32 v;\n"
+        "        __builtin_memcpy(&v, (const u8 *)data + b, sizeof(v));\n"
+        "        return bpf_ntohl(v);\n"
+        "}\n"
+        "struct bpf_map_def {\n"
+        "        __u32 type;\n"
+        "        __u32 key_size;\n"
+        "        __u32 value_size;\n"
+        "        __u32 max_entries;\n"
+        "        __u32 flags;\n"
+        "        __u32 id;\n"
+        "        __u32 pinning;\n"
+        "};\n"
+        "#endif\n");
+}
+
+// An empty asm statement that takes the address of var has the effect of
+// the printk of the other targets, without tracing every packet.
+void XdpTarget::emitKeepOnStack(Util::SourceCodeBuilder* builder, cstring var) const {
+    builder->append("asm volatile(\"\" : : \"r\"(&");
+    builder->append(var);
+    builder->append(") : \"memory\")");
+}
+
+void XdpTarget::emitMain(Util::SourceCodeBuilder* builder,
+                         cstring functionName,
+                         cstring argName) const {
+    builder->appendFormat("int %s(struct xdp_md* %s)", functionName, argName);
+}
+
+//////////////////////////////////////////////////////////////
+
 void BccTarget::emitTableLookup(Util::SourceCodeBuilder* builder, cstring tblName,
                                 cstring key, cstring value) const {
     builder->appendFormat("%s = %s.lookup(&%s)",
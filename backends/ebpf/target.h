@@ -55,6 +55,13 @@ class Target {
     virtual cstring forwardReturnCode() const = 0;
     virtual cstring dropReturnCode() const = 0;
     virtual cstring abortReturnCode() const = 0;
+    // Value returned by the program given the filter's accept variable
+    virtual cstring verdict(cstring acceptVar) const { return acceptVar; }
+    // Copy each header from the packet with one read, and extract its
+    // fields from the copy
+    virtual bool coalesceHeaderReads() const { return false; }
+    // Force var to be allocated on the stack
+    virtual void emitKeepOnStack(Util::SourceCodeBuilder* builder, cstring var) const;
     // Path on /sys filesystem where maps are stored
     virtual cstring sysMapPath() const = 0;
 };
@@ -88,6 +95,31 @@ class KernelSamplesTarget : public Target {
     cstring sysMapPath() const override { return "/sys/fs/bpf"; }
 };
 
+// Represents a target compiled within the kernel source tree which
+// attaches to an XDP hook.  Packet data is accessed directly instead of
+// through the skb load helpers: each header is checked against the end
+// of the packet, and then copied to the stack with one read.
+class XdpTarget : public KernelSamplesTarget {
+ public:
+    XdpTarget() : KernelSamplesTarget("XDP") {}
+    void emitIncludes(Util::SourceCodeBuilder* builder) const override;
+    void emitMain(Util::SourceCodeBuilder* builder,
+                  cstring functionName,
+                  cstring argName) const override;
+    cstring dataOffset(cstring base) const override
+    { return cstring("((void*)(long)") + base + "->data)"; }
+    cstring dataEnd(cstring base) const override
+    { return cstring("((void*)(long)") + base + "->data_end)"; }
+    cstring forwardReturnCode() const override { return "XDP_PASS"; }
+    cstring dropReturnCode() const override { return "XDP_DROP"; }
+    cstring abortReturnCode() const override { return "XDP_ABORTED"; }
+    cstring verdict(cstring acceptVar) const override {
+        return cstring("(") + acceptVar + " ? " + forwardReturnCode() +
+                " : " + dropReturnCode() + ")"; }
+    bool coalesceHeaderReads() const override { return true; }
+    void emitKeepOnStack(Util::SourceCodeBuilder* builder, cstring var) const override;
+};
+
 // Represents a target compiled by bcc that uses the TC
 class BccTarget : public Target {
  public:
@@ -17,6 +17,7 @@ limitations under the License.
 #include "ir/ir.h"
 #include "ir/json_loader.h"
 #include "lib/log.h"
+#include "lib/arena.h"
 #include "lib/error.h"
 #include "lib/exceptions.h"
 #include "lib/gc.h"
@@ -83,6 +84,9 @@ int main(int argc, char *const argv[]) {
 
     auto hook = options.getDebugHook();
 
+    // The IR of this compilation lives in one arena, if requested.
+    Arena arena;
+    Arena::Scope arenaScope(options.irArena ? &arena : nullptr);
     auto program = P4::parseP4File(options);
     if (program == nullptr || ::errorCount() > 0)
         return 1;
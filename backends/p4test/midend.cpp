@@ -69,6 +69,8 @@ class SkipControls : public P4::ActionSynthesisPolicy {
 MidEnd::MidEnd(CompilerOptions& options) {
     bool isv1 = options.langVersion == CompilerOptions::FrontendVersion::P4_14;
     refMap.setIsV1(isv1);
+    refMap.setIncremental(options.incrementalMaps);
+    typeMap.setIncremental(options.incrementalMaps);
     auto evaluator = new P4::EvaluatorPass(&refMap, &typeMap);
     setName("MidEnd");
 
@@ -112,6 +114,8 @@ MidEnd::MidEnd(CompilerOptions& options) {
         new P4::InlineActions(&refMap, &typeMap),
         // Parser loop unrolling: TODO
         // new P4::ParsersUnroll(true, &refMap, &typeMap),
+        options.maxParserStates != 0 ?
+            new P4::ParsersUnroll(false, &refMap, &typeMap, options.maxParserStates) : nullptr,
         new P4::LocalizeAllActions(&refMap),
         new P4::UniqueNames(&refMap),
         new P4::UniqueParameters(&refMap, &typeMap),
@@ -21,11 +21,13 @@ limitations under the License.
 #include "ir/ir.h"
 #include "ir/json_loader.h"
 #include "lib/log.h"
+#include "lib/arena.h"
 #include "lib/error.h"
 #include "lib/exceptions.h"
 #include "lib/gc.h"
 #include "lib/crash.h"
 #include "lib/nullstream.h"
+#include "frontends/common/compileServer.h"
 #include "frontends/common/parseInput.h"
 #include "frontends/p4/evaluator/evaluator.h"
 #include "frontends/p4/frontend.h"
@@ -56,10 +58,7 @@ static void log_dump(const IR::Node *node, const char *head) {
             std::cout << *node << std::endl; }
 }
 
-int main(int argc, char *const argv[]) {
-    setup_gc_logging();
-    setup_signals();
-
+static int runCompiler(int argc, char *const argv[]) {
     P4TestOptions options;
     options.langVersion = CompilerOptions::FrontendVersion::P4_16;
     options.compilerVersion = "0.0.5";
@@ -69,6 +68,9 @@ int main(int argc, char *const argv[]) {
     if (::errorCount() > 0)
         return 1;
 
+    // The IR of this compilation lives in one arena, if requested.
+    Arena arena;
+    Arena::Scope arenaScope(options.irArena ? &arena : nullptr);
     auto program = P4::parseP4File(options);
     auto hook = options.getDebugHook();
 
@@ -137,3 +139,9 @@ int main(int argc, char *const argv[]) {
         std::cerr << "Done." << std::endl;
     return ::errorCount() > 0;
 }
+
+int main(int argc, char *const argv[]) {
+    setup_gc_logging();
+    setup_signals();
+    return P4::compileMain(argc, argv, runCompiler);
+}
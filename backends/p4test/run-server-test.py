@@ -0,0 +1,131 @@
+#!/usr/bin/env python
+# Copyright 2013-present Barefoot Networks, Inc.
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#    http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+
+# Checks that compiling through "p4test --server" and "p4test --connect"
+# gives the same exit status and output as compiling directly.
+
+from __future__ import print_function
+import os
+import shutil
+import socket
+import subprocess
+import sys
+import tempfile
+import time
+
+p4test = "./p4test"
+timeout = 60
+
+class TestFailure(Exception):
+    pass
+
+def check(condition, message):
+    if not condition:
+        raise TestFailure(message)
+
+def run(args, env=None):
+    process = subprocess.Popen(args, stdout=subprocess.PIPE, stderr=subprocess.PIPE,
+                               env=env)
+    out, err = process.communicate()
+    return process.returncode, out, err
+
+def read(file):
+    if not os.path.isfile(file):
+        return None
+    with open(file) as f:
+        return f.read()
+
+def start_server(path):
+    server = subprocess.Popen([p4test, "--server", path, "1"])
+    deadline = time.time() + timeout
+    while time.time() < deadline:
+        check(server.poll() is None, "server exited with status " + str(server.returncode))
+        client = socket.socket(socket.AF_UNIX, socket.SOCK_STREAM)
+        try:
+            client.connect(path)
+            return server
+        except socket.error:
+            time.sleep(0.1)
+        finally:
+            client.close()
+    server.kill()
+    raise TestFailure("server does not accept connections")
+
+def stop_server(server):
+    server.kill()
+    server.wait()
+
+def compare(tmpdir, path, file, env):
+    direct = os.path.join(tmpdir, "direct.p4")
+    served = os.path.join(tmpdir, "served.p4")
+    expected = run([p4test, "--pp", direct, file])
+    result = run([p4test, "--connect", path, "--pp", served, file], env)
+    check(result[0] == expected[0], file + ": exit status " + str(result[0]) +
+          " instead of " + str(expected[0]))
+    check(result[1] == expected[1], file + ": different output")
+    check(result[2] == expected[2], file + ": different errors")
+    check(read(served) == read(direct), file + ": different program")
+    return result[0]
+
+def main(argv):
+    if len(argv) != 2:
+        print("usage: run-server-test.py sourcedir", file=sys.stderr)
+        sys.exit(1)
+    srcdir = argv[1]
+    sample = os.path.join(srcdir, "testdata", "p4_16_samples", "action-uses.p4")
+    error = os.path.join(srcdir, "testdata", "p4_16_errors", "accept_e.p4")
+
+    tmpdir = tempfile.mkdtemp(dir=".")
+    path = os.path.join(tmpdir, "server")
+    # A core.p4 that is only found by the compilations run by the client,
+    # so that the test fails if the server does not compile the program.
+    include = os.path.join(tmpdir, "include")
+    os.mkdir(include)
+    with open(os.path.join(include, "core.p4"), "w") as f:
+        f.write("not a P4 program\n")
+    env = dict(os.environ, P4C_16_INCLUDE_PATH=include)
+
+    server = None
+    try:
+        # The server must not remove a file that is not a socket.
+        open(path, "w").close()
+        status = subprocess.call([p4test, "--server", path, "1"])
+        check(status != 0, "server started on a regular file")
+        check(os.path.isfile(path), "server removed a regular file")
+        os.remove(path)
+
+        server = start_server(path)
+        check(compare(tmpdir, path, sample, env) == 0, sample + ": compilation failed")
+        check(compare(tmpdir, path, error, env) != 0, error + ": compilation succeeded")
+        stop_server(server)
+
+        # Without a server the client compiles locally and finds the bad core.p4.
+        status = run([p4test, "--connect", path, sample], env)[0]
+        check(status != 0, "the client does not compile locally")
+
+        # A new server replaces the socket left behind.
+        server = start_server(path)
+        check(compare(tmpdir, path, sample, env) == 0, sample + ": compilation failed")
+    except TestFailure as e:
+        print("FAILURE:", e, file=sys.stderr)
+        sys.exit(1)
+    finally:
+        if server is not None and server.poll() is None:
+            stop_server(server)
+        shutil.rmtree(tmpdir)
+    print("SUCCESS")
+
+if __name__ == "__main__":
+    main(sys.argv)
@@ -0,0 +1,378 @@
+/*
+Copyright 2013-present Barefoot Networks, Inc.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include "compileServer.h"
+
+#include <dirent.h>
+#include <errno.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "frontends/common/options.h"
+#include "frontends/common/parseInput.h"
+#include "frontends/common/preprocessor.h"
+#include "lib/error.h"
+#include "lib/path.h"
+
+namespace P4 {
+
+namespace {
+
+// The protocol, over a stream socket: the client sends one byte with its
+// standard input, output and error attached, then the length and text of
+// the request -- its working directory and the arguments, each terminated
+// by a 0 byte.  The server answers with the exit status.
+const uint32_t maxRequest = 1 << 20;
+
+bool readAll(int fd, void* data, size_t size) {
+    auto p = static_cast<char*>(data);
+    while (size > 0) {
+        ssize_t count = read(fd, p, size);
+        if (count < 0 && errno == EINTR)
+            continue;
+        if (count <= 0)
+            return false;
+        p += count;
+        size -= count;
+    }
+    return true;
+}
+
+bool writeAll(int fd, const void* data, size_t size) {
+    auto p = static_cast<const char*>(data);
+    while (size > 0) {
+        ssize_t count = send(fd, p, size, MSG_NOSIGNAL);
+        if (count < 0 && errno == EINTR)
+            continue;
+        if (count <= 0)
+            return false;
+        p += count;
+        size -= count;
+    }
+    return true;
+}
+
+bool socketAddress(const char* path, sockaddr_un& address) {
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    if (strlen(path) >= sizeof(address.sun_path)) {
+        ::error("%1%: socket path is too long", path);
+        return false;
+    }
+    strncpy(address.sun_path, path, sizeof(address.sun_path) - 1);
+    return true;
+}
+
+/// Read the architecture include files, so that the compilations started
+/// by the server find them in the preprocessor's file cache.
+/// @returns the names of the P4-16 include files.
+std::vector<std::string> preloadIncludes() {
+    // Each directory, and whether it has P4-16 include files.
+    std::vector<std::pair<const char*, bool>> dirs = {
+        { p4includePath, true }, { p4_14includePath, false } };
+    if (auto dir = getenv("P4C_16_INCLUDE_PATH"))
+        dirs.emplace_back(dir, true);
+    if (auto dir = getenv("P4C_14_INCLUDE_PATH"))
+        dirs.emplace_back(dir, false);
+    std::vector<std::string> names;
+    for (auto& dirEntry : dirs) {
+        const char* dir = dirEntry.first;
+        bool p4_16 = dirEntry.second;
+        DIR* d = opendir(dir);
+        if (d == nullptr)
+            continue;
+        while (auto entry = readdir(d)) {
+            Util::PathName name(entry->d_name);
+            if (name.getExtension() != "p4")
+                continue;
+            Preprocessor::preload(Util::PathName(dir).join(entry->d_name).toString());
+            if (p4_16)
+                names.push_back(entry->d_name);
+        }
+        closedir(d);
+    }
+    return names;
+}
+
+/// Parse the P4-16 include files the way programs include them, after
+/// core.p4, so that the compilations started by the server take their
+/// parse from memory.  The output of the two preprocessors differs, so
+/// each one is used.
+void preparseArchitectures(const std::vector<std::string>& names) {
+    char dir[] = "/tmp/p4c-server-XXXXXX";
+    if (mkdtemp(dir) == nullptr)
+        return;
+    std::string main = std::string(dir) + "/main.p4";
+    for (auto& name : names) {
+        {
+            std::ofstream out(main);
+            out << "#include <core.p4>" << std::endl;
+            if (name != "core.p4")
+                out << "#include <" << name << ">" << std::endl;
+        }
+        for (bool builtin : { true, false }) {
+            CompilerOptions options;
+            options.langVersion = CompilerOptions::FrontendVersion::P4_16;
+            options.builtinPreprocessor = builtin;
+            options.file = main;
+            preparseIncludes(options);
+        }
+    }
+    unlink(main.c_str());
+    rmdir(dir);
+}
+
+/// The number of compilations running.  Finished ones are reaped by
+/// reapCompilations as soon as they exit.
+volatile sig_atomic_t running = 0;
+
+void reapCompilations(int) {
+    int saved = errno;
+    while (waitpid(-1, nullptr, WNOHANG) > 0)
+        --running;
+    errno = saved;
+}
+
+/// Read the request on connection, and take over the client's standard
+/// input, output, error and working directory.
+bool readRequest(int connection, std::string& request, std::vector<char*>& argv) {
+    char tag;
+    int fds[3];
+    iovec data = { &tag, 1 };
+    char control[CMSG_SPACE(sizeof(fds))];
+    msghdr message;
+    memset(&message, 0, sizeof(message));
+    message.msg_iov = &data;
+    message.msg_iovlen = 1;
+    message.msg_control = control;
+    message.msg_controllen = sizeof(control);
+    if (recvmsg(connection, &message, 0) != 1)
+        return false;
+    auto header = CMSG_FIRSTHDR(&message);
+    if (header == nullptr || header->cmsg_type != SCM_RIGHTS ||
+        header->cmsg_len != CMSG_LEN(sizeof(fds)))
+        return false;
+    memcpy(fds, CMSG_DATA(header), sizeof(fds));
+    for (int i = 0; i < 3; ++i) {
+        dup2(fds[i], i);
+        close(fds[i]);
+    }
+
+    uint32_t length;
+    if (!readAll(connection, &length, sizeof(length)) || length == 0 || length > maxRequest)
+        return false;
+    request.assign(length, '\0');
+    if (!readAll(connection, &request[0], length) || request.back() != '\0')
+        return false;
+    const char* cwd = request.c_str();
+    if (chdir(cwd) != 0) {
+        ::error("%1%: %2%", cwd, strerror(errno));
+        return false;
+    }
+    for (size_t i = strlen(cwd) + 1; i < request.size(); i += strlen(&request[i]) + 1)
+        argv.push_back(&request[i]);
+    argv.push_back(nullptr);
+    return true;
+}
+
+/// The connection of the request served by this process.
+int replyConnection = -1;
+
+/// Send the exit status of the process on replyConnection, after the
+/// output of the compilation.
+void sendExitStatus(int exitStatus, void*) {
+    fflush(nullptr);
+    std::cout.flush();
+    std::cerr.flush();
+    int32_t status = exitStatus;
+    writeAll(replyConnection, &status, sizeof(status));
+}
+
+/// Run the compilation requested on connection, in the process forked for
+/// it, and exit.  The exit status is sent when the process exits, so that
+/// the compilation may also end by calling exit.  If it crashes, the
+/// connection is closed without a status.
+void serveRequest(int connection, const char* program, CompileFunction compile) {
+    std::string request;
+    std::vector<char*> argv = { const_cast<char*>(program) };
+    if (!readRequest(connection, request, argv)) {
+        int32_t status = 1;
+        writeAll(connection, &status, sizeof(status));
+        _exit(1);
+    }
+    replyConnection = connection;
+    on_exit(sendExitStatus, nullptr);
+    exit(compile(argv.size() - 1, argv.data()));
+}
+
+int runServer(const char* path, unsigned jobs, const char* program, CompileFunction compile) {
+    sockaddr_un address;
+    if (!socketAddress(path, address))
+        return 1;
+    int listener = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (listener < 0) {
+        ::error("%1%: %2%", path, strerror(errno));
+        return 1;
+    }
+    // Remove the socket left behind by a previous server, but nothing else.
+    struct stat status;
+    if (lstat(path, &status) == 0 && S_ISSOCK(status.st_mode))
+        unlink(path);
+    if (bind(listener, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0 ||
+        listen(listener, 64) != 0) {
+        ::error("%1%: %2%", path, strerror(errno));
+        close(listener);
+        return 1;
+    }
+
+    preparseArchitectures(preloadIncludes());
+    clearProgramState();
+
+    // SIGCHLD is only delivered while waiting for a connection or for a
+    // compilation to finish, so running changes only there.
+    struct sigaction action;
+    memset(&action, 0, sizeof(action));
+    action.sa_handler = reapCompilations;
+    action.sa_flags = SA_RESTART | SA_NOCLDSTOP;
+    sigemptyset(&action.sa_mask);
+    sigaction(SIGCHLD, &action, nullptr);
+    sigset_t childSignal, waiting;
+    sigemptyset(&childSignal);
+    sigaddset(&childSignal, SIGCHLD);
+    sigprocmask(SIG_BLOCK, &childSignal, &waiting);
+    sigdelset(&waiting, SIGCHLD);
+
+    while (true) {
+        sigprocmask(SIG_SETMASK, &waiting, nullptr);
+        int connection = accept(listener, nullptr, nullptr);
+        sigprocmask(SIG_BLOCK, &childSignal, nullptr);
+        if (connection < 0) {
+            if (errno == EINTR || errno == ECONNABORTED)
+                continue;
+            ::error("%1%: %2%", path, strerror(errno));
+            return 1;
+        }
+        while (static_cast<unsigned>(running) >= jobs)
+            sigsuspend(&waiting);
+
+        // One process per compilation; it sends the reply itself.
+        pid_t pid = fork();
+        if (pid == 0) {
+            // The compilation may wait for processes of its own.
+            signal(SIGCHLD, SIG_DFL);
+            sigprocmask(SIG_SETMASK, &waiting, nullptr);
+            close(listener);
+            serveRequest(connection, program, compile);
+        }
+        if (pid < 0)
+            perror("fork");
+        else
+            ++running;
+        close(connection);
+    }
+}
+
+/// @returns the exit status of the compilation, or -1 if there is no server.
+int runClient(const char* path, int argc, char* const argv[]) {
+    sockaddr_un address;
+    if (!socketAddress(path, address))
+        return 1;
+    int connection = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (connection < 0 ||
+        connect(connection, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0) {
+        if (connection >= 0)
+            close(connection);
+        return -1;
+    }
+
+    char tag = 'C';
+    int fds[3] = { 0, 1, 2 };
+    iovec data = { &tag, 1 };
+    char control[CMSG_SPACE(sizeof(fds))];
+    memset(control, 0, sizeof(control));
+    msghdr message;
+    memset(&message, 0, sizeof(message));
+    message.msg_iov = &data;
+    message.msg_iovlen = 1;
+    message.msg_control = control;
+    message.msg_controllen = sizeof(control);
+    auto header = CMSG_FIRSTHDR(&message);
+    header->cmsg_level = SOL_SOCKET;
+    header->cmsg_type = SCM_RIGHTS;
+    header->cmsg_len = CMSG_LEN(sizeof(fds));
+    memcpy(CMSG_DATA(header), fds, sizeof(fds));
+
+    std::string request;
+    char* cwd = getcwd(nullptr, 0);
+    if (cwd == nullptr) {
+        perror("getcwd");
+        return 1;
+    }
+    request.append(cwd, strlen(cwd) + 1);
+    free(cwd);
+    for (int i = 0; i < argc; ++i)
+        request.append(argv[i], strlen(argv[i]) + 1);
+    uint32_t length = request.size();
+
+    int32_t status;
+    if (sendmsg(connection, &message, MSG_NOSIGNAL) != 1 ||
+        !writeAll(connection, &length, sizeof(length)) ||
+        !writeAll(connection, request.data(), request.size()) ||
+        !readAll(connection, &status, sizeof(status))) {
+        ::error("%1%: compile server failed", path);
+        status = 1;
+    }
+    close(connection);
+    return status;
+}
+
+}  // namespace
+
+int compileMain(int argc, char* const argv[], CompileFunction compile) {
+    if (argc >= 3 && strcmp(argv[1], "--server") == 0) {
+        long jobs = argc >= 4 ? atol(argv[3]) : sysconf(_SC_NPROCESSORS_ONLN);
+        if (argc > 4 || jobs <= 0) {
+            ::error("usage: %1% --server socket [jobs]", argv[0]);
+            return 1;
+        }
+        return runServer(argv[2], jobs, argv[0], compile);
+    }
+    if (argc >= 3 && strcmp(argv[1], "--connect") == 0) {
+        int status = runClient(argv[2], argc - 3, argv + 3);
+        if (status >= 0)
+            return status;
+        // No server: compile here, without the --connect option.
+        std::vector<char*> local(argv, argv + argc + 1);
+        local.erase(local.begin() + 1, local.begin() + 3);
+        return compile(argc - 2, local.data());
+    }
+    return compile(argc, argv);
+}
+
+}  // namespace P4
@@ -0,0 +1,52 @@
+/*
+Copyright 2013-present Barefoot Networks, Inc.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#ifndef FRONTENDS_COMMON_COMPILESERVER_H_
+#define FRONTENDS_COMMON_COMPILESERVER_H_
+
+#include <functional>
+
+namespace P4 {
+
+/// Compiles the program given by the command line; returns the exit code.
+typedef std::function<int(int argc, char* const argv[])> CompileFunction;
+
+/**
+ * Entry point of the compiler executables, which adds two modes to the
+ * normal command line:
+ *
+ *   compiler --server socket [jobs]
+ *      Listen on the Unix socket and run a compilation for each client,
+ *      at most jobs (default: the number of processors) at the same time.
+ *   compiler --connect socket <options> file
+ *      Have the server listening on socket compile file, and exit with the
+ *      status of that compilation.  If no server answers, the compilation
+ *      runs in this process.
+ *
+ * The server forks a process for every compilation, so each one starts
+ * from the state of the server -- initialized, with the architecture
+ * include files read, and parsed as programs include them after core.p4
+ * -- and compilations are isolated from each other just like separate
+ * runs.  A P4-16 program whose preprocessed include files are the same as
+ * one of those parses only the rest of its text.  The client passes its standard input, output
+ * and error and its working directory, so messages and relative paths
+ * behave the same as when compiling directly.
+ */
+int compileMain(int argc, char* const argv[], CompileFunction compile);
+
+}  // namespace P4
+
+#endif /* FRONTENDS_COMMON_COMPILESERVER_H_ */
@@ -147,27 +147,33 @@ DoConstantFolding::cast(const IR::Constant* node, unsigned base, const IR::Type_
 }
 
 const IR::Node* DoConstantFolding::postorder(IR::Add* e) {
-    return binary(e, [](mpz_class a, mpz_class b) -> mpz_class { return a + b; });
+    return binary(e, [](const mpz_class& a, const mpz_class& b) -> mpz_class { return a + b; },
+                  [](long a, long b, long& r) { return !__builtin_add_overflow(a, b, &r); });
 }
 
 const IR::Node* DoConstantFolding::postorder(IR::Sub* e) {
-    return binary(e, [](mpz_class a, mpz_class b) -> mpz_class { return a - b; });
+    return binary(e, [](const mpz_class& a, const mpz_class& b) -> mpz_class { return a - b; },
+                  [](long a, long b, long& r) { return !__builtin_sub_overflow(a, b, &r); });
 }
 
 const IR::Node* DoConstantFolding::postorder(IR::Mul* e) {
-    return binary(e, [](mpz_class a, mpz_class b) -> mpz_class { return a * b; });
+    return binary(e, [](const mpz_class& a, const mpz_class& b) -> mpz_class { return a * b; },
+                  [](long a, long b, long& r) { return !__builtin_mul_overflow(a, b, &r); });
 }
 
 const IR::Node* DoConstantFolding::postorder(IR::BXor* e) {
-    return binary(e, [](mpz_class a, mpz_class b) -> mpz_class { return a ^ b; });
+    return binary(e, [](const mpz_class& a, const mpz_class& b) -> mpz_class { return a ^ b; },
+                  [](long a, long b, long& r) { r = a ^ b; return true; });
 }
 
 const IR::Node* DoConstantFolding::postorder(IR::BAnd* e) {
-    return binary(e, [](mpz_class a, mpz_class b) -> mpz_class { return a & b; });
+    return binary(e, [](const mpz_class& a, const mpz_class& b) -> mpz_class { return a & b; },
+                  [](long a, long b, long& r) { r = a & b; return true; });
 }
 
 const IR::Node* DoConstantFolding::postorder(IR::BOr* e) {
-    return binary(e, [](mpz_class a, mpz_class b) -> mpz_class { return a | b; });
+    return binary(e, [](const mpz_class& a, const mpz_class& b) -> mpz_class { return a | b; },
+                  [](long a, long b, long& r) { r = a | b; return true; });
 }
 
 const IR::Node* DoConstantFolding::postorder(IR::Equ* e) {
@@ -179,23 +185,27 @@ const IR::Node* DoConstantFolding::postorder(IR::Neq* e) {
 }
 
 const IR::Node* DoConstantFolding::postorder(IR::Lss* e) {
-    return binary(e, [](mpz_class a, mpz_class b) -> mpz_class { return a < b; });
+    return binary(e, [](const mpz_class& a, const mpz_class& b) -> mpz_class { return a < b; },
+                  [](long a, long b, long& r) { r = a < b; return true; });
 }
 
 const IR::Node* DoConstantFolding::postorder(IR::Grt* e) {
-    return binary(e, [](mpz_class a, mpz_class b) -> mpz_class { return a > b; });
+    return binary(e, [](const mpz_class& a, const mpz_class& b) -> mpz_class { return a > b; },
+                  [](long a, long b, long& r) { r = a > b; return true; });
 }
 
 const IR::Node* DoConstantFolding::postorder(IR::Leq* e) {
-    return binary(e, [](mpz_class a, mpz_class b) -> mpz_class { return a <= b; });
+    return binary(e, [](const mpz_class& a, const mpz_class& b) -> mpz_class { return a <= b; },
+                  [](long a, long b, long& r) { r = a <= b; return true; });
 }
 
 const IR::Node* DoConstantFolding::postorder(IR::Geq* e) {
-    return binary(e, [](mpz_class a, mpz_class b) -> mpz_class { return a >= b; });
+    return binary(e, [](const mpz_class& a, const mpz_class& b) -> mpz_class { return a >= b; },
+                  [](long a, long b, long& r) { r = a >= b; return true; });
 }
 
 const IR::Node* DoConstantFolding::postorder(IR::Div* e) {
-    return binary(e, [e](mpz_class a, mpz_class b) -> mpz_class {
+    return binary(e, [e](const mpz_class& a, const mpz_class& b) -> mpz_class {
             if (sgn(a) < 0 || sgn(b) < 0) {
                 ::error("%1%: Division is not defined for negative numbers", e);
                 return 0;
@@ -209,7 +219,7 @@ const IR::Node* DoConstantFolding::postorder(IR::Div* e) {
 }
 
 const IR::Node* DoConstantFolding::postorder(IR::Mod* e) {
-    return binary(e, [e](mpz_class a, mpz_class b) -> mpz_class {
+    return binary(e, [e](const mpz_class& a, const mpz_class& b) -> mpz_class {
             if (sgn(a) < 0 || sgn(b) < 0) {
                 ::error("%1%: Modulo is not defined for negative numbers", e);
                 return 0;
@@ -258,14 +268,17 @@ DoConstantFolding::compare(const IR::Operation_Binary* e) {
     }
 
     if (eqTest)
-        return binary(e, [](mpz_class a, mpz_class b) -> mpz_class { return a == b; });
+        return binary(e, [](const mpz_class& a, const mpz_class& b) -> mpz_class { return a == b; },
+                  [](long a, long b, long& r) { r = a == b; return true; });
     else
-        return binary(e, [](mpz_class a, mpz_class b) -> mpz_class { return a != b; });
+        return binary(e, [](const mpz_class& a, const mpz_class& b) -> mpz_class { return a != b; },
+                  [](long a, long b, long& r) { r = a != b; return true; });
 }
 
 const IR::Node*
 DoConstantFolding::binary(const IR::Operation_Binary* e,
-                          std::function<mpz_class(mpz_class, mpz_class)> func) {
+                          std::function<mpz_class(const mpz_class&, const mpz_class&)> func,
+                          SmallIntFunc small) {
     auto eleft = getConstant(e->left);
     auto eright = getConstant(e->right);
     if (eleft == nullptr || eright == nullptr)
@@ -288,7 +301,13 @@ DoConstantFolding::binary(const IR::Operation_Binary* e,
     bool runk = rt->is<IR::Type_InfInt>();
 
     const IR::Type* resultType;
-    mpz_class value = func(left->value, right->value);
+    mpz_class value;
+    long smallValue;
+    if (small != nullptr && left->fitsLong() && right->fitsLong() &&
+        small(left->value.get_si(), right->value.get_si(), smallValue))
+        value = smallValue;
+    else
+        value = func(left->value, right->value);
 
     const IR::Type_Bits* ltb = nullptr;
     const IR::Type_Bits* rtb = nullptr;
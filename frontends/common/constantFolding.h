@@ -71,9 +71,17 @@ class DoConstantFolding : public Transform {
     const IR::Constant* cast(
         const IR::Constant* node, unsigned base, const IR::Type_Bits* type) const;
 
+    /// Computes an operation on operands that fit in a long.  Returns
+    /// false if the result may not fit, in which case the mpz_class
+    /// version is used instead.
+    typedef bool (*SmallIntFunc)(long a, long b, long& result);
+
     /// Statically evaluate binary operation @p e implemented by @p func.
+    /// @p small, if not null, computes the same operation without using GMP
+    /// when both operands are small.
     const IR::Node* binary(const IR::Operation_Binary* op,
-                           std::function<mpz_class(mpz_class, mpz_class)> func);
+                           std::function<mpz_class(const mpz_class&, const mpz_class&)> func,
+                           SmallIntFunc small = nullptr);
     /// Statically evaluate comparison operation @p e.
     /// Note that this only handles the case where @p e represents `==` or `!=`.
     const IR::Node* compare(const IR::Operation_Binary* op);
@@ -102,7 +110,7 @@ class DoConstantFolding : public Transform {
  public:
     DoConstantFolding(const ReferenceMap* refMap, TypeMap* typeMap, bool warnings = true) :
             refMap(refMap), typeMap(typeMap), typesKnown(typeMap != nullptr), warnings(warnings) {
-        visitDagOnce = true; setName("DoConstantFolding");
+        visitDagOnce = true; cloneOnlyOnChange = true; setName("DoConstantFolding");
     }
 
     const IR::Node* postorder(IR::Declaration_Constant* d) override;
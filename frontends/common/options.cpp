@@ -15,17 +15,22 @@ limitations under the License.
 */
 
 #include <getopt.h>
+#include <stdlib.h>
+#include <string.h>
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <unistd.h>
+#include <sstream>
 
 #include "options.h"
 #include "lib/log.h"
 #include "lib/exceptions.h"
 #include "lib/nullstream.h"
 #include "lib/path.h"
+#include "frontends/common/preprocessor.h"
 #include "frontends/p4/toP4/toP4.h"
 #include "ir/json_generator.h"
+#include "ir/pass_manager.h"
 
 const char* p4includePath = CONFIG_PKGDATADIR "/p4include";
 const char* p4_14includePath = CONFIG_PKGDATADIR "/p4_14include";
@@ -59,6 +64,10 @@ CompilerOptions::CompilerOptions() : Util::Options(defaultMessage) {
     registerOption("--nocpp", nullptr,
                    [this](const char*) { doNotPreprocess = true; return true; },
                    "Skip preprocess, assume input file is already preprocessed.");
+    registerOption("--builtin-cpp", nullptr,
+                   [this](const char*) { builtinPreprocessor = true; return true; },
+                   "[Experimental] Preprocess the input in the compiler instead of\n"
+                   "running cpp; only -I, -D and -U preprocessor options are supported.");
     registerOption("--p4-14", nullptr,
                    [this](const char*) {
                        langVersion = CompilerOptions::FrontendVersion::P4_14;
@@ -81,6 +90,32 @@ CompilerOptions::CompilerOptions() : Util::Options(defaultMessage) {
                        }
                        return true; },
                     "Specify language version to compile");
+#ifdef MULTITHREAD
+    registerOption("-j", "jobs",
+                   [](const char* arg) {
+                       int jobs = atoi(arg);
+                       if (jobs <= 0) {
+                           ::error("Illegal number of jobs %1%", arg);
+                           return false; }
+                       ApplyToDeclarations::jobs = jobs;
+                       return true; },
+                   "Run passes that process each parser and control separately\n"
+                   "on up to <jobs> threads");
+#endif  // MULTITHREAD
+    registerOption("--incremental-maps", nullptr,
+                   [this](const char*) { incrementalMaps = true; return true; },
+                   "[Experimental] Only recompute reference and type information\n"
+                   "for the declarations changed by each pass");
+    registerOption("--max-parser-states", "n",
+                   [this](const char* arg) {
+                       int states = atoi(arg);
+                       if (states <= 0) {
+                           ::error("Illegal number of parser states %1%", arg);
+                           return false; }
+                       maxParserStates = states;
+                       return true; },
+                   "Analyze the parsers symbolically in the mid end, and report an\n"
+                   "error for a parser whose analysis evaluates more than <n> states");
     registerOption("--target", "target",
                    [this](const char* arg) { target = arg; return true; },
                     "Compile for the specified target");
@@ -93,6 +128,24 @@ CompilerOptions::CompilerOptions() : Util::Options(defaultMessage) {
     registerOption("--testJson", nullptr,
                     [this](const char*) { debugJson = true; return true; },
                     "Dump and undump the IR");
+    registerOption("--toBinary", "file",
+                   [this](const char* arg) { dumpBinaryFile = arg; return true; },
+                   "Write a binary snapshot of the IR after the front end\n"
+                   "to the specified file.");
+    registerOption("--fromBinary", "file",
+                   [this](const char* arg) { loadBinaryFile = arg; return true; },
+                   "Skip the front end and resume compilation from a snapshot\n"
+                   "written by --toBinary; no input file is needed.");
+    registerOption("--frontend-cache", "dir",
+                   [this](const char* arg) { frontendCacheDir = arg; return true; },
+                   "Cache the front end output in the specified directory, and\n"
+                   "reuse it when the same preprocessed program is compiled again,\n"
+                   "for any target; programs with warnings are not cached.  The\n"
+                   "parse of the standard include files is also cached there.");
+    registerOption("--ir-arena", nullptr,
+                   [this](const char*) { irArena = true; return true; },
+                   "[Experimental] Allocate the IR in an arena, which is compacted\n"
+                   "after the front end");
     registerOption("--p4runtime-file", "file",
                    [this](const char* arg) { p4RuntimeFile = arg; return true; },
                    "Write a P4Runtime control plane API description to the specified file.");
@@ -129,6 +182,10 @@ CompilerOptions::CompilerOptions() : Util::Options(defaultMessage) {
     registerOption("-v", nullptr,
                    [this](const char*) { Log::increaseVerbosity(); return true; },
                    "[Compiler debugging] Increase verbosity level (can be repeated)");
+    registerOption("--pass-profile", "file",
+                   [](const char* arg) { Visitor::enableProfileReport(arg); return true; },
+                   "Write the time and memory used by each pass to <file>,\n"
+                   "in the Chrome trace event format");
     registerOption("--top4", "pass1[,pass2]",
                    [this](const char* arg) {
                        auto copy = strdup(arg);
@@ -153,6 +210,8 @@ void CompilerOptions::setInputFile() {
         ::error("Only one input file must be specified: %s",
                 cstring::join(remainingOptions.begin(), remainingOptions.end(), ","));
         usage();
+    } else if (remainingOptions.size() == 0 && loadBinaryFile) {
+        file = loadBinaryFile;
     } else if (remainingOptions.size() == 0) {
         ::error("No input files specified");
         usage();
@@ -220,10 +279,61 @@ void CompilerOptions::validateOptions() const {
     }
 }
 
+FILE* CompilerOptions::preprocessBuiltin() {
+    std::vector<cstring> includePath;
+    std::vector<std::pair<char, cstring>> macros;
+    std::istringstream words(preprocessor_options.c_str());
+    std::string word;
+    while (words >> word) {
+        if (word.size() >= 2 && word[0] == '-' && strchr("IDU", word[1])) {
+            std::string arg = word.substr(2);
+            // The argument may also be the next word, as in "-I dir"
+            if (arg.empty() && !(words >> arg)) {
+                ::warning("Preprocessor option %1% ignored: missing argument", cstring(word));
+                break;
+            }
+            if (word[1] == 'I')
+                includePath.push_back(arg);
+            else
+                macros.emplace_back(word[1], arg);
+        } else {
+            ::warning("Preprocessor option %1% ignored by --builtin-cpp", cstring(word));
+        }
+    }
+    char * driverP4IncludePath =
+      isv1() ? getenv("P4C_14_INCLUDE_PATH") : getenv("P4C_16_INCLUDE_PATH");
+    if (driverP4IncludePath)
+        includePath.push_back(driverP4IncludePath);
+    includePath.push_back(isv1() ? p4_14includePath : p4includePath);
+
+    P4::Preprocessor preprocessor(includePath);
+    for (auto& m : macros) {
+        if (m.first == 'D')
+            preprocessor.define(m.second);
+        else
+            preprocessor.undefine(m.second);
+    }
+    if (Log::verbose())
+        std::cerr << "Preprocessing " << file << std::endl;
+    preprocessed = new std::string;
+    if (!preprocessor.process(file, *preprocessed))
+        return nullptr;
+    if (file == "-")
+        file = "<stdin>";
+    FILE* in = fmemopen(&(*preprocessed)[0], preprocessed->size(), "r");
+    if (in == nullptr)
+        ::error("Error reading preprocessor output");
+    return in;
+}
+
 FILE* CompilerOptions::preprocess() {
     FILE* in = nullptr;
 
-    if (file == "-") {
+    if (builtinPreprocessor) {
+        in = preprocessBuiltin();
+        if (in == nullptr)
+            return nullptr;
+    } else if (file == "-") {
         file = "<stdin>";
         in = stdin;
     } else {
@@ -269,7 +379,9 @@ FILE* CompilerOptions::preprocess() {
 }
 
 void CompilerOptions::closeInput(FILE* inputStream) const {
-    if (close_input) {
+    if (preprocessed) {
+        fclose(inputStream);
+    } else if (close_input) {
         int exitCode = pclose(inputStream);
         if (WIFEXITED(exitCode) && WEXITSTATUS(exitCode) == 4)
             ::error("input file %s does not exist", file);
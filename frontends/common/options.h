@@ -35,6 +35,8 @@ extern const char* p4_14includePath;
 // Each back-end should subclass this file.
 class CompilerOptions : public Util::Options {
     bool close_input = false;
+    // output of the builtin preprocessor, which the input stream reads from
+    std::string* preprocessed = nullptr;
     static const char* defaultMessage;
 
     // Checks if parsed options make sense with respect to each-other.
@@ -65,6 +67,8 @@ class CompilerOptions : public Util::Options {
     bool doNotCompile = false;
     // if true skip preprocess
     bool doNotPreprocess = false;
+    // if true preprocess in the compiler instead of running cpp
+    bool builtinPreprocessor = false;
     // debugging dumps of programs written in this folder
     cstring dumpFolder = ".";
     // Pretty-print the program in the specified file
@@ -80,6 +84,22 @@ class CompilerOptions : public Util::Options {
     // Dump and undump the IR tree
     bool debugJson = false;
 
+    // Write a binary snapshot of the IR after the front end to this file
+    cstring dumpBinaryFile = nullptr;
+    // Read the front end output from this binary snapshot instead of
+    // parsing and checking the input program
+    cstring loadBinaryFile = nullptr;
+    // Directory caching the parse of the standard include files and the
+    // front end output, keyed by the preprocessed input; programs with
+    // warnings are not cached, so that every compilation reports them
+    cstring frontendCacheDir = nullptr;
+    // Cache entry to write the front end output to; set when it is missing
+    cstring frontendCacheFile = nullptr;
+    // Key of that entry, which is stored in it
+    std::string frontendCacheKey;
+    // Allocate the IR in an arena, compacted after the front end
+    bool irArena = false;
+
     // Write a P4Runtime control plane API description to the specified file.
     cstring p4RuntimeFile = nullptr;
 
@@ -91,6 +111,12 @@ class CompilerOptions : public Util::Options {
 
     // Compiler target architecture
     cstring target = nullptr;
+    // Update the reference and type maps incrementally when
+    // passes only change some top-level declarations
+    bool incrementalMaps = false;
+    // Bound on the number of states evaluated for each parser by the
+    // symbolic parser analysis; 0 if the analysis is not requested
+    unsigned maxParserStates = 0;
     // substrings matched agains pass names
     std::vector<cstring> top4;
 
@@ -99,6 +125,8 @@ class CompilerOptions : public Util::Options {
 
     // Returns the output of the preprocessor.
     FILE* preprocess();
+    // Runs the builtin preprocessor; returns a stream reading its output.
+    FILE* preprocessBuiltin();
     // Closes the input stream returned by preprocess.
     void closeInput(FILE* input) const;
 
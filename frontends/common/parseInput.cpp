@@ -17,27 +17,44 @@ limitations under the License.
 #include "parseInput.h"
 
 #include <boost/optional.hpp>
+#include <ctype.h>
+#include <link.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
 #include <cstdio>
+#include <fstream>
 #include <iostream>
+#include <map>
 #include <sstream>
+#include <string>
+#include <vector>
 
+#include "frontends/common/resolveReferences/resolveReferences.h"
 #include "frontends/parsers/parserDriver.h"
+#include "frontends/p4/createBuiltins.h"
 #include "frontends/p4/fromv1.0/converters.h"
 #include "frontends/p4/frontend.h"
+#include "frontends/p4/typeChecking/typeChecker.h"
+#include "ir/binary_generator.h"
+#include "ir/binary_loader.h"
 #include "lib/error.h"
+#include "lib/log.h"
 #include "lib/source_file.h"
+#include "lib/stringify.h"
 
 namespace P4 {
 
 template <typename Input>
 static const IR::P4Program*
 parseV1Program(const char* name, Input& stream,
-               boost::optional<DebugHook> debugHook = boost::none) {
+               boost::optional<DebugHook> debugHook = boost::none,
+               bool builtinPreprocessor = false) {
     // We load the model before parsing the input file, so that the SourceInfo
     // in the model comes first.
     P4V1::Converter converter;
     if (debugHook) converter.addDebugHook(*debugHook);
-    converter.loadModel();
+    converter.loadModel(builtinPreprocessor);
 
     // Parse.
     const IR::Node* v1 = V1::V1ParserDriver::parse(name, stream);
@@ -56,9 +73,481 @@ parseV1Program(const char* name, Input& stream,
     return nullptr;  // Conversion failed.
 }
 
+template <typename Input>
+static const IR::P4Program* parseProgram(const CompilerOptions& options, Input& in) {
+    return options.isv1()
+         ? parseV1Program(options.file, in, options.getDebugHook(),
+                          options.builtinPreprocessor)
+         : P4ParserDriver::parse(options.file, in);
+}
+
+/// Snapshots include the InputSources, so the source positions in the loaded
+/// program are the same as in the program that was saved.
+static const IR::P4Program* readP4Snapshot(cstring file) {
+    const IR::P4Program* program = nullptr;
+    BinaryLoader loader(file);
+    loader >> *Util::InputSources::instance >> program;
+    return program;
+}
+
+static const IR::P4Program* loadP4Snapshot(cstring file) {
+    const IR::P4Program* program = nullptr;
+    try {
+        program = readP4Snapshot(file);
+    } catch (const Util::CompilationError &e) {
+        ::error("%1%", e.what());
+        return nullptr;
+    }
+    if (program == nullptr)
+        ::error("%1%: IR snapshot does not contain a P4 program", file);
+    return program;
+}
+
+static std::string readInput(FILE* in) {
+    std::string result;
+    char buffer[64 * 1024];
+    size_t count;
+    while ((count = fread(buffer, 1, sizeof(buffer), in)) > 0)
+        result.append(buffer, count);
+    return result;
+}
+
+/// Identifies the compiler build: the GNU build ids of the executable and
+/// of the libraries it loaded, or for an object linked without one, the
+/// identity and modification time of its file.
+static const std::string& buildId() {
+    static std::string id;
+    if (!id.empty())
+        return id;
+    std::stringstream out;
+    dl_iterate_phdr([](struct dl_phdr_info* info, size_t, void* data) {
+        auto& out = *static_cast<std::stringstream*>(data);
+        for (int i = 0; i < info->dlpi_phnum; ++i) {
+            const auto& phdr = info->dlpi_phdr[i];
+            if (phdr.p_type != PT_NOTE)
+                continue;
+            size_t align = phdr.p_align == 8 ? 8 : 4;
+            auto p = reinterpret_cast<const char*>(info->dlpi_addr + phdr.p_vaddr);
+            auto end = p + phdr.p_memsz;
+            while (p + sizeof(ElfW(Nhdr)) <= end) {
+                auto note = reinterpret_cast<const ElfW(Nhdr)*>(p);
+                const char* name = p + sizeof(*note);
+                auto desc = reinterpret_cast<const unsigned char*>(
+                    name + ((note->n_namesz + align - 1) & ~(align - 1)));
+                if (note->n_type == NT_GNU_BUILD_ID && note->n_namesz == 4 &&
+                    memcmp(name, "GNU", 4) == 0) {
+                    char hex[3];
+                    for (unsigned j = 0; j < note->n_descsz; ++j) {
+                        snprintf(hex, sizeof(hex), "%02x", desc[j]);
+                        out << hex;
+                    }
+                    out << std::endl;
+                    return 0;
+                }
+                p = reinterpret_cast<const char*>(desc) +
+                    ((note->n_descsz + align - 1) & ~(align - 1));
+            }
+        }
+        const char* file = *info->dlpi_name ? info->dlpi_name : "/proc/self/exe";
+        struct stat st;
+        out << file;
+        if (stat(file, &st) == 0)
+            out << " " << st.st_dev << " " << st.st_ino << " " << st.st_size
+                << " " << st.st_mtime;
+        out << std::endl;
+        return 0;
+    }, &out);
+    id = out.str();
+    return id;
+}
+
+/**
+ * The key of what is computed from text in the front end cache: the text
+ * together with everything else the result depends on -- the compiler
+ * build, the language version and, for a P4-14 program, the preprocessor
+ * the architecture model is read with.  Other options, such as defines,
+ * include paths, output files and target options, either only affect the
+ * preprocessed text or do not affect the front end, so compiling a
+ * program for several targets reuses its front end output.  The key is
+ * stored in the cache entry, and checked when the entry is read.
+ */
+static std::string cacheKey(const CompilerOptions& options, const std::string& text) {
+    std::stringstream key;
+    key << buildId();
+    if (options.isv1())
+        key << "P4-14" << (options.builtinPreprocessor ? " builtin-cpp" : "") << std::endl;
+    else
+        key << "P4-16" << std::endl;
+    key << text;
+    return key.str();
+}
+
+/// The file in the front end cache directory for key.
+static cstring cacheFile(const CompilerOptions& options, const std::string& key,
+                         const char* extension) {
+    char name[64];
+    snprintf(name, sizeof(name), "/%016zx-%zx.%s",
+             cstring::hash(key.data(), key.size()), key.size(), extension);
+    return options.frontendCacheDir + name;
+}
+
+/// Read a front end cache entry, which is a snapshot preceded by its key.
+/// @returns nullptr if the entry has another key.
+static const IR::P4Program* readCachedProgram(cstring file, const std::string& key) {
+    const IR::P4Program* program = nullptr;
+    BinaryLoader loader(file);
+    if (!loader.match_bytes(key))
+        return nullptr;
+    loader >> *Util::InputSources::instance >> program;
+    return program;
+}
+
+/**
+ * Look the preprocessed program up in the front end cache.  On a hit the
+ * cached front end output is returned, and options.loadBinaryFile is set so
+ * that the front end is skipped; on a miss options.frontendCacheFile is set
+ * so that the front end output is saved.  The cache is not used when the
+ * front end pretty-prints or dumps the program.
+ */
+static const IR::P4Program* lookupFrontendCache(CompilerOptions& options,
+                                                const std::string& source) {
+    // A hit skips the front end, and with it the output it is asked for.
+    if (options.prettyPrintFile || !options.top4.empty())
+        return nullptr;
+    std::string key = cacheKey(options, source);
+    cstring file = cacheFile(options, key, "p4ir");
+    if (access(file, R_OK) == 0) {
+        try {
+            if (auto program = readCachedProgram(file, key)) {
+                if (Log::verbose())
+                    std::cerr << "Using front end output cached in " << file << std::endl;
+                options.loadBinaryFile = file;
+                return program;
+            }
+        } catch (const Util::CompilationError &) {
+            // An unreadable entry is replaced.
+        }
+        clearProgramState();
+    }
+    options.frontendCacheFile = file;
+    options.frontendCacheKey = key;
+    return nullptr;
+}
+
+/// @returns true if line is a line marker ('# 12 "file" ...' or
+/// '#line 12 "file"'), and then sets file.
+static bool isLineMarker(const char* line, const char* end, std::string& file) {
+    if (end - line > 5 && strncmp(line, "#line", 5) == 0)
+        line += 5;
+    else if (end - line > 1 && *line == '#')
+        line += 1;
+    else
+        return false;
+    if (line == end || *line != ' ')
+        return false;
+    while (line < end && *line == ' ')
+        ++line;
+    if (line == end || !isdigit(static_cast<unsigned char>(*line)))
+        return false;
+    while (line < end && isdigit(static_cast<unsigned char>(*line)))
+        ++line;
+    while (line < end && *line == ' ')
+        ++line;
+    if (line == end || *line != '"')
+        return false;
+    auto close = static_cast<const char*>(memchr(line + 1, '"', end - line - 1));
+    if (close == nullptr)
+        return false;
+    file.assign(line + 1, close);
+    return true;
+}
+
+/// Scan the text of a line for comments, which may continue from and onto
+/// other lines.  @returns true if the line has text outside comments, and
+/// so contains tokens.
+static bool hasTokens(const char* p, const char* end, bool& inComment) {
+    bool tokens = false;
+    while (p < end) {
+        if (inComment) {
+            if (p + 1 < end && p[0] == '*' && p[1] == '/') {
+                inComment = false;
+                ++p;
+            }
+        } else if (p + 1 < end && p[0] == '/' && p[1] == '/') {
+            break;
+        } else if (p + 1 < end && p[0] == '/' && p[1] == '*') {
+            inComment = true;
+            ++p;
+        } else if (*p == '"') {
+            tokens = true;
+            auto close = static_cast<const char*>(memchr(p + 1, '"', end - p - 1));
+            p = close ? close : end;
+        } else if (!isspace(static_cast<unsigned char>(*p))) {
+            tokens = true;
+        }
+        ++p;
+    }
+    return tokens;
+}
+
+/**
+ * Split a preprocessed program into the standard include files at its
+ * start and the rest.  The text of the include files is usually the same
+ * in every program, unlike the lines of the program before and between
+ * the #include directives, which do not contain tokens and so are moved
+ * to the rest.  Each part keeps its line markers, so the source positions
+ * are the same when they are parsed one after the other.
+ *
+ * Only the files in the standard include directories are split off, so
+ * that the included text consists of complete declarations.  The markers
+ * cpp writes for its predefined and command-line macros belong to the
+ * program.
+ * @returns false if the program does not start with such includes.
+ */
+static bool splitIncludes(const std::string& source, std::string& includes, std::string& rest) {
+    std::vector<std::string> standardDirs = { std::string(p4includePath) + "/" };
+    if (auto dir = getenv("P4C_16_INCLUDE_PATH"))
+        standardDirs.push_back(std::string(dir) + "/");
+    auto isStandard = [&standardDirs](const std::string& file) {
+        for (auto& dir : standardDirs)
+            if (file.compare(0, dir.size(), dir) == 0)
+                return true;
+        return false;
+    };
+
+    const char* text = source.data();
+    const char* end = text + source.size();
+    std::string mainFile, file;
+    std::string programLines;
+    bool inComment = false;
+    includes.clear();
+    const char* line = text;
+    while (line < end) {
+        auto newline = static_cast<const char*>(memchr(line, '\n', end - line));
+        const char* next = newline ? newline + 1 : end;
+        bool marker = !inComment && isLineMarker(line, next, file);
+        if (mainFile.empty()) {
+            // the preprocessor output starts with a marker for the program
+            if (!marker)
+                return false;
+            mainFile = file;
+        }
+        if (!marker || file == mainFile || file == "<built-in>" || file == "<command-line>") {
+            // A line of the program; comments and directives are no tokens.
+            bool directive = !inComment && *line == '#';
+            if (!directive && hasTokens(line, next, inComment))
+                break;
+            programLines.append(line, next);
+            line = next;
+            continue;
+        }
+        // The included text lasts until the marker back to the program.
+        const char* includeStart = line;
+        bool standard = true;
+        while (line < end) {
+            newline = static_cast<const char*>(memchr(line, '\n', end - line));
+            next = newline ? newline + 1 : end;
+            if (!inComment && isLineMarker(line, next, file)) {
+                if (file == mainFile)
+                    break;
+                standard = standard && isStandard(file);
+            }
+            hasTokens(line, next, inComment);
+            line = next;
+        }
+        if (!standard || inComment) {
+            line = includeStart;
+            break;
+        }
+        includes.append(includeStart, line);
+    }
+    if (includes.empty())
+        return false;
+    rest = programLines;
+    rest.append(line, end);
+    return true;
+}
+
+/// Cached parses of include files are written like front end cache entries,
+/// followed by the symbols they declare.
+static const ParsedDeclarations* readIncludeSnapshot(cstring file, const std::string& key) {
+    BinaryLoader loader(file);
+    if (!loader.match_bytes(key))
+        return nullptr;
+    auto result = new ParsedDeclarations;
+    loader >> *Util::InputSources::instance >> result->declarations;
+    if (result->declarations == nullptr)
+        return nullptr;
+    for (auto count = loader.read_count(); count > 0; --count) {
+        Util::ProgramStructure::Symbol symbol;
+        loader >> symbol.name >> symbol.srcInfo;
+        auto kind = loader.read_uint();
+        symbol.kind = kind == 0 ? Util::ProgramStructure::SymbolKind::Identifier
+                                : Util::ProgramStructure::SymbolKind::Type;
+        symbol.container = kind >= 2;
+        symbol.allowDuplicates = kind == 3;
+        result->symbols.push_back(symbol);
+    }
+    return result;
+}
+
+static void writeIncludeSnapshot(cstring file, const std::string& key,
+                                 const ParsedDeclarations* parsed) {
+    cstring temp = file + ".tmp" + Util::toString(getpid());
+    std::ofstream out(temp, std::ios::binary);
+    BinaryGenerator gen(out);
+    gen.write_bytes(key);
+    gen << *Util::InputSources::instance << parsed->declarations;
+    gen.write_uint(parsed->symbols.size());
+    for (auto& symbol : parsed->symbols) {
+        gen << symbol.name << symbol.srcInfo;
+        gen.write_uint(symbol.allowDuplicates ? 3 : symbol.container ? 2 :
+                       symbol.kind == Util::ProgramStructure::SymbolKind::Type ? 1 : 0);
+    }
+    out.close();
+    if (!out || rename(temp, file) != 0) {
+        ::warning("%1%: cannot write IR snapshot", file);
+        unlink(temp);
+    }
+}
+
+/// The standard include files parsed by preparseIncludes, by their
+/// preprocessed text, with the input sources their parse left, and the
+/// maps of their declarations (nullptr if they could not be computed).
+struct PreparsedIncludes {
+    const ParsedDeclarations* parsed;
+    const Util::InputSources* sources;
+    const ReferenceMap* refMap;
+    const TypeMap* typeMap;
+};
+static std::map<std::string, PreparsedIncludes> preparsedIncludes;
+
+/// Resolve and type-check the declarations of the include files on their
+/// own, as the front end starts with, and keep the maps for seedIncludeMaps.
+static void checkIncludes(PreparsedIncludes& includes) {
+    auto refMap = new ReferenceMap;
+    auto typeMap = new TypeMap;
+    refMap->setIncremental(true);
+    typeMap->setIncremental(true);
+    auto program = new IR::P4Program(includes.parsed->declarations->srcInfo,
+                                     *includes.parsed->declarations);
+    PassManager passes = {
+        new CreateBuiltins(),
+        new ResolveReferences(refMap, true),
+        new TypeInference(refMap, typeMap, true),
+    };
+    passes.setStopOnError(true);
+    auto errors = ::errorCount();
+    program->apply(passes);
+    if (::errorCount() != errors)
+        return;
+    refMap->setPrefix();
+    typeMap->setPrefix();
+    includes.refMap = refMap;
+    includes.typeMap = typeMap;
+}
+
+/**
+ * Parse a P4-16 program, taking the parse of the standard include files at
+ * its start from those parsed by preparseIncludes or from the front end
+ * cache.  The include files are parsed first, on their own, and the rest of
+ * the program continues from the declarations and the input sources they
+ * left.
+ */
+static const IR::P4Program* parseWithCachedIncludes(const CompilerOptions& options,
+                                                    const std::string& source) {
+    std::string includes, rest;
+    if (!splitIncludes(source, includes, rest)) {
+        std::istringstream stream(source);
+        return P4ParserDriver::parse(options.file, stream);
+    }
+
+    const ParsedDeclarations* parsed = nullptr;
+    auto preparsed = preparsedIncludes.find(includes);
+    if (preparsed != preparsedIncludes.end()) {
+        // The rest of the program is appended to a copy of the sources.
+        parsed = preparsed->second.parsed;
+        Util::InputSources::instance = new Util::InputSources(*preparsed->second.sources);
+    }
+
+    std::string key;
+    cstring file = nullptr;
+    if (parsed == nullptr && options.frontendCacheDir) {
+        key = cacheKey(options, includes);
+        file = cacheFile(options, key, "p4inc");
+        if (access(file, R_OK) == 0) {
+            try {
+                parsed = readIncludeSnapshot(file, key);
+                if (parsed && Log::verbose())
+                    std::cerr << "Using include files parsed in " << file << std::endl;
+            } catch (const Util::CompilationError &) {
+                // An unreadable entry is replaced.
+            }
+            if (parsed == nullptr)
+                Util::InputSources::reset();
+        }
+    }
+    if (parsed == nullptr) {
+        std::istringstream stream(includes);
+        parsed = P4ParserDriver::parseDeclarations(options.file, stream);
+        if (parsed == nullptr || ::errorCount() > 0)
+            return nullptr;
+        if (file)
+            writeIncludeSnapshot(file, key, parsed);
+    }
+    std::istringstream stream(rest);
+    return P4ParserDriver::parse(options.file, stream, parsed);
+}
+
+bool preparseIncludes(CompilerOptions& options) {
+    clearProgramState();
+    FILE* in = options.preprocess();
+    if (::errorCount() > 0 || in == nullptr)
+        return false;
+    std::string source = readInput(in);
+    options.closeInput(in);
+    std::string includes, rest;
+    if (::errorCount() > 0 || !splitIncludes(source, includes, rest))
+        return false;
+    if (preparsedIncludes.count(includes))
+        return true;
+    std::istringstream stream(includes);
+    auto parsed = P4ParserDriver::parseDeclarations(options.file, stream);
+    if (parsed == nullptr || ::errorCount() > 0)
+        return false;
+    PreparsedIncludes preparsed{ parsed, Util::InputSources::instance, nullptr, nullptr };
+    checkIncludes(preparsed);
+    preparsedIncludes.emplace(includes, preparsed);
+    return true;
+}
+
+bool seedIncludeMaps(const IR::P4Program* program, ReferenceMap& refMap, TypeMap& typeMap) {
+    auto& declarations = program->declarations;
+    for (auto& p : preparsedIncludes) {
+        auto& preparsed = p.second;
+        auto& includes = *preparsed.parsed->declarations;
+        if (preparsed.refMap == nullptr || includes.size() > declarations.size())
+            continue;
+        // The parse of the program has its own copy of the error declaration.
+        bool prefix = true;
+        for (size_t i = 0; prefix && i < includes.size(); i++)
+            prefix = includes[i] == declarations[i] ||
+                     (includes[i]->is<IR::Type_Error>() && declarations[i]->is<IR::Type_Error>());
+        if (!prefix)
+            continue;
+        refMap = *preparsed.refMap;
+        typeMap = *preparsed.typeMap;
+        return true;
+    }
+    return false;
+}
+
 const IR::P4Program* parseP4File(CompilerOptions& options) {
     clearProgramState();
 
+    if (options.loadBinaryFile)
+        return loadP4Snapshot(options.loadBinaryFile);
+
     FILE* in = nullptr;
     if (options.doNotPreprocess) {
         in = fopen(options.file, "r");
@@ -72,10 +561,26 @@ const IR::P4Program* parseP4File(CompilerOptions& options) {
             return nullptr;
     }
 
-    auto result = options.isv1()
-                ? parseV1Program(options.file, in, options.getDebugHook())
-                : P4ParserDriver::parse(options.file, in);
-    options.closeInput(in);
+    const IR::P4Program* result = nullptr;
+    if (options.frontendCacheDir || (!options.isv1() && !preparsedIncludes.empty())) {
+        // The whole preprocessed program is needed for the lookups.
+        std::string source = readInput(in);
+        options.closeInput(in);
+        if (::errorCount() > 0)
+            return nullptr;
+        if (options.frontendCacheDir &&
+            (result = lookupFrontendCache(options, source)) != nullptr)
+            return result;
+        if (options.isv1()) {
+            std::istringstream stream(source);
+            result = parseProgram(options, stream);
+        } else {
+            result = parseWithCachedIncludes(options, source);
+        }
+    } else {
+        result = parseProgram(options, in);
+        options.closeInput(in);
+    }
 
     if (::errorCount() > 0) {
         ::error("%1% errors encountered, aborting compilation", ::errorCount());
@@ -26,6 +26,9 @@ class P4Program;
 
 namespace P4 {
 
+class ReferenceMap;
+class TypeMap;
+
 /**
  * Parse P4 source from a file. The filename and language version are specified
  * by @options. If the language version is not P4-16, then the program is
@@ -58,6 +61,29 @@ const IR::P4Program* parseP4File(CompilerOptions& options);
 const IR::P4Program* parseP4String(const std::string& input,
                                    CompilerOptions::FrontendVersion version);
 
+/**
+ * Preprocess the P4-16 program in the file given by @options, and parse the
+ * standard include files at its start.  The parse is kept in memory, and
+ * parseP4File() uses it for the programs that start with the same
+ * preprocessed include files, in this process and in the processes it
+ * forks.  The references and types of the include files are kept too,
+ * for seedIncludeMaps().  The rest of the program is not parsed.
+ *
+ * @return false if the program does not start with standard include files,
+ * or if they could not be preprocessed or parsed.
+ */
+bool preparseIncludes(CompilerOptions& options);
+
+/**
+ * If @program starts with the declarations of standard include files
+ * parsed by preparseIncludes(), set @refMap and @typeMap to the references
+ * and types of these declarations.  In incremental mode, the front end
+ * then keeps them and only resolves and type-checks the rest of @program.
+ *
+ * @return false if @program does not start with such declarations.
+ */
+bool seedIncludeMaps(const IR::P4Program* program, ReferenceMap& refMap, TypeMap& typeMap);
+
 /**
  * Clear global program state so that a new program can be parsed.
  *
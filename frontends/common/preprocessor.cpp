@@ -0,0 +1,997 @@
+/*
+Copyright 2013-present Barefoot Networks, Inc.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include "preprocessor.h"
+
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <algorithm>
+#include <fstream>
+#include <iterator>
+
+#include "lib/error.h"
+#include "lib/path.h"
+#include "lib/stringify.h"
+
+namespace P4 {
+
+namespace {
+
+/// Files read by any Preprocessor, with what identifies their version.
+struct CachedFile {
+    dev_t device;
+    ino_t inode;
+    off_t size;
+    struct timespec modified;
+    struct timespec changed;
+    std::string text;
+};
+
+bool sameTime(const struct timespec& a, const struct timespec& b)
+{ return a.tv_sec == b.tv_sec && a.tv_nsec == b.tv_nsec; }
+
+std::map<cstring, CachedFile>& fileCache() {
+    static std::map<cstring, CachedFile> cache;
+    return cache;
+}
+
+/// @returns the contents of the file, or nullptr if it cannot be read.
+const std::string* readFile(cstring path) {
+    struct stat st;
+    if (stat(path, &st) != 0 || !S_ISREG(st.st_mode))
+        return nullptr;
+    auto& cache = fileCache();
+    auto it = cache.find(path);
+    if (it != cache.end() && it->second.device == st.st_dev && it->second.inode == st.st_ino &&
+        it->second.size == st.st_size && sameTime(it->second.modified, st.st_mtim) &&
+        sameTime(it->second.changed, st.st_ctim))
+        return &it->second.text;
+
+    std::ifstream in(path.c_str(), std::ios::binary);
+    if (!in)
+        return nullptr;
+    std::string text((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    auto& entry = cache[path];
+    entry.device = st.st_dev;
+    entry.inode = st.st_ino;
+    entry.size = st.st_size;
+    entry.modified = st.st_mtim;
+    entry.changed = st.st_ctim;
+    entry.text = std::move(text);
+    return &entry.text;
+}
+
+bool isIdentifierStart(char c) { return isalpha(static_cast<unsigned char>(c)) || c == '_'; }
+bool isIdentifierChar(char c) { return isalnum(static_cast<unsigned char>(c)) || c == '_'; }
+
+/// Evaluates the tokens of an #if expression after macro expansion; any
+/// identifier left is 0.
+class ExpressionEvaluator {
+    const std::vector<std::string>& tokens;
+    size_t position = 0;
+    std::string error;
+
+    bool at(const char* op) const { return position < tokens.size() && tokens[position] == op; }
+    void fail(const std::string& message) { if (error.empty()) error = message; }
+
+    long long conditional(bool evaluate) {
+        long long condition = binary(0, evaluate);
+        if (!at("?"))
+            return condition;
+        ++position;
+        long long ifTrue = conditional(evaluate && condition);
+        if (!at(":")) {
+            fail("expected ':' in #if expression");
+            return 0;
+        }
+        ++position;
+        long long ifFalse = conditional(evaluate && !condition);
+        return condition ? ifTrue : ifFalse;
+    }
+
+    long long binary(int level, bool evaluate) {
+        static const std::vector<std::vector<std::string>> operators = {
+            { "||" }, { "&&" }, { "|" }, { "^" }, { "&" }, { "==", "!=" },
+            { "<", ">", "<=", ">=" }, { "<<", ">>" }, { "+", "-" }, { "*", "/", "%" } };
+        if (level == static_cast<int>(operators.size()))
+            return unary(evaluate);
+        long long left = binary(level + 1, evaluate);
+        while (position < tokens.size()) {
+            auto& ops = operators[level];
+            auto op = std::find(ops.begin(), ops.end(), tokens[position]);
+            if (op == ops.end())
+                break;
+            ++position;
+            bool evaluateRight = evaluate && !(*op == "||" && left) && !(*op == "&&" && !left);
+            long long right = binary(level + 1, evaluateRight);
+            if (*op == "||") left = left || right;
+            else if (*op == "&&") left = left && right;
+            else if (*op == "|") left |= right;
+            else if (*op == "^") left ^= right;
+            else if (*op == "&") left &= right;
+            else if (*op == "==") left = left == right;
+            else if (*op == "!=") left = left != right;
+            else if (*op == "<") left = left < right;
+            else if (*op == ">") left = left > right;
+            else if (*op == "<=") left = left <= right;
+            else if (*op == ">=") left = left >= right;
+            else if (*op == "<<") left = right >= 64 ? 0 : left << right;
+            else if (*op == ">>") left = right >= 64 ? 0 : left >> right;
+            else if (*op == "+") left += right;
+            else if (*op == "-") left -= right;
+            else if (*op == "*") left *= right;
+            else if (right == 0) {
+                if (evaluateRight)
+                    fail("division by zero in #if");
+                left = 0;
+            } else if (*op == "/") {
+                left /= right;
+            } else {
+                left %= right;
+            }
+        }
+        return left;
+    }
+
+    long long unary(bool evaluate) {
+        if (position >= tokens.size()) {
+            fail("#if with no expression");
+            return 0;
+        }
+        const std::string& token = tokens[position++];
+        if (token == "!") return !unary(evaluate);
+        if (token == "~") return ~unary(evaluate);
+        if (token == "-") return -unary(evaluate);
+        if (token == "+") return unary(evaluate);
+        if (token == "(") {
+            long long value = conditional(evaluate);
+            if (!at(")"))
+                fail("missing ')' in #if expression");
+            else
+                ++position;
+            return value;
+        }
+        if (isdigit(static_cast<unsigned char>(token[0]))) {
+            char* end;
+            long long value = static_cast<long long>(strtoull(token.c_str(), &end, 0));
+            while (*end == 'u' || *end == 'U' || *end == 'l' || *end == 'L')
+                ++end;
+            if (*end != 0)
+                fail("invalid integer constant " + token + " in #if");
+            return value;
+        }
+        if (isIdentifierStart(token[0]))
+            return 0;
+        fail("token " + token + " is not valid in #if expressions");
+        return 0;
+    }
+
+ public:
+    explicit ExpressionEvaluator(const std::vector<std::string>& tokens) : tokens(tokens) {}
+    /// @returns false, with the message in error, if the expression is invalid.
+    bool run(long long& value, std::string& message) {
+        value = conditional(true);
+        if (error.empty() && position < tokens.size())
+            fail("missing binary operator before token " + tokens[position]);
+        message = error;
+        return error.empty();
+    }
+};
+
+}  // namespace
+
+Preprocessor::Preprocessor(const std::vector<cstring>& includePath) : includePath(includePath) {
+    define("__STDC__");
+    define("__STDC_HOSTED__");
+    define("__STDC_VERSION__=201112L");
+}
+
+void Preprocessor::tokenize(const std::string& text, Tokens& out, bool& inComment) {
+    const char* p = text.c_str();
+    const char* end = p + text.size();
+    while (p < end) {
+        const char* start = p;
+        if (inComment) {
+            const char* close = strstr(p, "*/");
+            p = close ? close + 2 : end;
+            inComment = close == nullptr;
+            out.emplace_back(Token::Space, std::string(start, p));
+            continue;
+        }
+        char c = *p;
+        if (c == ' ' || c == '\t' || c == '\r' || c == '\f' || c == '\v') {
+            while (p < end && (*p == ' ' || *p == '\t' || *p == '\r' || *p == '\f' || *p == '\v'))
+                ++p;
+            out.emplace_back(Token::Space, std::string(start, p));
+        } else if (c == '/' && p + 1 < end && p[1] == '/') {
+            out.emplace_back(Token::Space, std::string(p, end));
+            p = end;
+        } else if (c == '/' && p + 1 < end && p[1] == '*') {
+            const char* close = strstr(p + 2, "*/");
+            p = close ? close + 2 : end;
+            inComment = close == nullptr;
+            out.emplace_back(Token::Space, std::string(start, p));
+        } else if (isIdentifierStart(c)) {
+            while (p < end && isIdentifierChar(*p))
+                ++p;
+            out.emplace_back(Token::Identifier, std::string(start, p));
+        } else if (isdigit(static_cast<unsigned char>(c)) ||
+                   (c == '.' && p + 1 < end && isdigit(static_cast<unsigned char>(p[1])))) {
+            // a C preprocessing number, which includes P4 literals like 8w0xFF
+            while (p < end) {
+                if ((*p == '+' || *p == '-') && strchr("eEpP", p[-1]))
+                    ++p;
+                else if (isIdentifierChar(*p) || *p == '.')
+                    ++p;
+                else
+                    break;
+            }
+            out.emplace_back(Token::Number, std::string(start, p));
+        } else if (c == '"') {
+            for (++p; p < end && *p != '"'; ++p)
+                if (*p == '\\' && p + 1 < end)
+                    ++p;
+            if (p < end)
+                ++p;
+            out.emplace_back(Token::String, std::string(start, p));
+        } else {
+            static const char* const multiChar[] = {
+                "...", "##", "&&", "||", "==", "!=", "<=", ">=", "<<", ">>" };
+            size_t length = 1;
+            for (auto op : multiChar) {
+                size_t opLength = strlen(op);
+                if (static_cast<size_t>(end - p) >= opLength && strncmp(p, op, opLength) == 0) {
+                    length = opLength;
+                    break;
+                }
+            }
+            p += length;
+            out.emplace_back(Token::Punctuation, std::string(start, p));
+        }
+    }
+}
+
+std::string Preprocessor::toText(const Tokens& tokens) {
+    std::string result;
+    for (auto& token : tokens)
+        result += token.text;
+    return result;
+}
+
+std::string Preprocessor::stringize(const Tokens& tokens) {
+    std::string result = "\"";
+    bool space = false;
+    for (auto& token : tokens) {
+        if (token.kind == Token::Space) {
+            space = result.size() > 1;
+            continue;
+        }
+        if (space)
+            result += ' ';
+        space = false;
+        if (token.kind != Token::String) {
+            result += token.text;
+            continue;
+        }
+        for (char c : token.text) {
+            if (c == '"' || c == '\\')
+                result += '\\';
+            result += c;
+        }
+    }
+    return result + "\"";
+}
+
+void Preprocessor::report(bool isError, const std::string& message) const {
+    cstring text = message;
+    if (!inputs.empty()) {
+        auto in = inputs.back();
+        text = Util::printf_format("%s(%d): %s", in->presumedName.c_str(),
+                                   in->line + in->lineDelta, message.c_str());
+    }
+    if (isError)
+        ::error("%1%", text);
+    else
+        ::warning("%1%", text);
+}
+
+bool Preprocessor::isActive() const {
+    auto& conditionals = inputs.back()->conditionals;
+    return conditionals.empty() || conditionals.back().active;
+}
+
+std::string Preprocessor::marker(unsigned line) const {
+    auto in = inputs.back();
+    return Util::printf_format("# %d \"%s\"\n", line, in->presumedName.c_str()).c_str();
+}
+
+/// Reads the next line of the current input, joining lines ending with a
+/// backslash.
+bool Preprocessor::readLine(std::string& line, unsigned& physicalLines) {
+    auto in = inputs.back();
+    auto& text = *in->text;
+    if (in->position >= text.size())
+        return false;
+    line.clear();
+    physicalLines = 0;
+    in->line = in->linesRead + 1;
+    while (in->position < text.size()) {
+        size_t start = in->position;
+        size_t end = text.find('\n', start);
+        in->position = end == std::string::npos ? text.size() : end + 1;
+        if (end == std::string::npos)
+            end = text.size();
+        if (end > start && text[end - 1] == '\r')
+            --end;
+        ++physicalLines;
+        ++in->linesRead;
+        if (end > start && text[end - 1] == '\\' && in->position < text.size()) {
+            line.append(text, start, end - 1 - start);
+            continue;
+        }
+        line.append(text, start, end - start);
+        break;
+    }
+    return true;
+}
+
+void Preprocessor::processFile(cstring path, const std::string* text, std::string& output) {
+    if (inputs.size() >= 200) {
+        report(true, "#include nested too deeply");
+        return;
+    }
+    auto in = new Input;
+    in->path = path;
+    in->text = text;
+    in->presumedName = path;
+    inputs.push_back(in);
+    output += marker(1);
+
+    std::string line;
+    unsigned physicalLines;
+    while (readLine(line, physicalLines)) {
+        bool startsInComment = in->inComment;
+        Tokens tokens;
+        tokenize(line, tokens, in->inComment);
+        size_t first = 0;
+        while (first < tokens.size() && tokens[first].kind == Token::Space && !startsInComment)
+            ++first;
+        if (!startsInComment && first < tokens.size() && tokens[first].is("#")) {
+            directive(tokens, first + 1, physicalLines, line, output);
+            continue;
+        }
+        if (!isActive()) {
+            // a comment left open in the output may have ended in skipped lines
+            if (in->outputInComment) {
+                output += "*/";
+                in->outputInComment = false;
+            }
+            output.append(physicalLines, '\n');
+            continue;
+        }
+
+        // The arguments of a macro call may continue on the following lines,
+        // but not into a directive.  The lines are separated by their line
+        // breaks, so that they stay in place if no call consumes them.
+        unsigned extraLines = 0;
+        unsigned lastLines = physicalLines;
+        auto more = [this, in, &extraLines, &lastLines](std::deque<Token>& queue) {
+            auto& text = *in->text;
+            size_t peek = in->position;
+            while (peek < text.size() && (text[peek] == ' ' || text[peek] == '\t'))
+                ++peek;
+            if (!in->inComment && peek < text.size() && text[peek] == '#')
+                return false;
+            std::string next;
+            unsigned count;
+            if (!readLine(next, count))
+                return false;
+            extraLines += count;
+            Tokens nextTokens;
+            tokenize(next, nextTokens, in->inComment);
+            queue.emplace_back(Token::Space, std::string(lastLines, '\n'));
+            lastLines = count;
+            queue.insert(queue.end(), nextTokens.begin(), nextTokens.end());
+            return true;
+        };
+        std::deque<Token> queue(tokens.begin(), tokens.end());
+        Tokens expanded;
+        expand(queue, expanded, more);
+        // A comment may have been opened by a line that was not copied.
+        if (startsInComment && !in->outputInComment)
+            output += "/*";
+        auto text = toText(expanded);
+        output += text;
+        size_t breaks = std::count(text.begin(), text.end(), '\n');
+        output.append(physicalLines + extraLines - breaks, '\n');
+        in->outputInComment = in->inComment;
+    }
+
+    if (in->inComment)
+        report(true, "unterminated comment");
+    for (auto& c : in->conditionals) {
+        in->line = c.line;
+        report(true, "unterminated conditional directive");
+    }
+    inputs.pop_back();
+}
+
+void Preprocessor::directive(const Tokens& tokens, size_t start, unsigned physicalLines,
+                             const std::string& line, std::string& output) {
+    auto in = inputs.back();
+    auto& conditionals = in->conditionals;
+    size_t i = start;
+    while (i < tokens.size() && tokens[i].kind == Token::Space)
+        ++i;
+    std::string name;
+    if (i < tokens.size() && (tokens[i].kind == Token::Identifier ||
+                              tokens[i].kind == Token::Number)) {
+        name = tokens[i].kind == Token::Number ? "line" : tokens[i].text;
+        if (tokens[i].kind == Token::Identifier)
+            ++i;
+    }
+    Tokens rest(tokens.begin() + i, tokens.end());
+    bool active = isActive();
+    bool parentActive = conditionals.size() < 2 || conditionals[conditionals.size() - 2].active;
+
+    auto firstIdentifier = [&rest]() -> std::string {
+        for (auto& t : rest) {
+            if (t.kind == Token::Identifier)
+                return t.text;
+            if (t.kind != Token::Space)
+                break;
+        }
+        return "";
+    };
+    auto macroName = [&]() {
+        auto result = firstIdentifier();
+        if (result.empty())
+            report(true, "no macro name given in #" + name + " directive");
+        return result;
+    };
+
+    if (name == "if" || name == "ifdef" || name == "ifndef") {
+        bool value = false;
+        if (active) {
+            if (name == "if")
+                value = evaluate(rest) != 0;
+            else
+                value = (macros.count(macroName()) != 0) == (name == "ifdef");
+        }
+        conditionals.push_back({active && value, !active || value, false, in->line});
+    } else if (name == "elif" || name == "else") {
+        if (conditionals.empty()) {
+            report(true, "#" + name + " without #if");
+        } else {
+            auto& c = conditionals.back();
+            if (c.sawElse)
+                report(true, "#" + name + " after #else");
+            if (c.taken || !parentActive) {
+                c.active = false;
+            } else {
+                c.active = name == "else" || evaluate(rest) != 0;
+                c.taken = c.active;
+            }
+            if (name == "else")
+                c.sawElse = true;
+        }
+    } else if (name == "endif") {
+        if (conditionals.empty())
+            report(true, "#endif without #if");
+        else
+            conditionals.pop_back();
+    } else if (!active) {
+        // other directives in skipped groups are ignored
+    } else if (name == "include") {
+        include(rest, physicalLines, output);
+        return;
+    } else if (name == "define") {
+        defineMacro(rest, 0);
+    } else if (name == "undef") {
+        auto undefined = macroName();
+        if (!undefined.empty())
+            macros.erase(undefined);
+    } else if (name == "error" || name == "warning") {
+        auto message = line.substr(line.find(name) + name.size());
+        auto first = message.find_first_not_of(" \t");
+        message = first == std::string::npos ? "" : message.substr(first);
+        report(name == "error", "#" + name + " " + message);
+    } else if (name == "line") {
+        std::deque<Token> queue(rest.begin(), rest.end());
+        Tokens expanded;
+        expand(queue, expanded, nullptr);
+        Tokens arguments;
+        for (auto& t : expanded)
+            if (t.kind != Token::Space)
+                arguments.push_back(t);
+        char* end = nullptr;
+        unsigned long number = arguments.empty() || arguments[0].kind != Token::Number ? 0 :
+                strtoul(arguments[0].text.c_str(), &end, 10);
+        if (end == nullptr || *end != 0 ||
+            (arguments.size() > 1 && arguments[1].kind != Token::String)) {
+            report(true, "invalid #line directive");
+        } else {
+            if (arguments.size() > 1) {
+                auto& file = arguments[1].text;
+                in->presumedName = file.substr(1, file.size() - 2);
+            }
+            in->lineDelta = static_cast<int>(number) - static_cast<int>(in->linesRead + 1);
+            output.append(physicalLines - 1, '\n');
+            output += marker(number);
+            return;
+        }
+    } else if (name == "pragma") {
+        if (firstIdentifier() == "once") {
+            onceFiles.insert(in->path);
+        } else {
+            output += line;
+            output.append(physicalLines, '\n');
+            return;
+        }
+    } else if (!name.empty() || i < tokens.size()) {
+        report(true, "invalid preprocessing directive #" + name);
+    }
+    output.append(physicalLines, '\n');
+}
+
+cstring Preprocessor::findInclude(cstring name, bool quoted) const {
+    struct stat st;
+    auto exists = [&st](cstring path) {
+        return stat(path, &st) == 0 && S_ISREG(st.st_mode);
+    };
+    if (name.startsWith("/"))
+        return exists(name) ? name : nullptr;
+    if (quoted) {
+        auto folder = Util::PathName(inputs.back()->path).getFolder();
+        cstring path = folder.isNullOrEmpty() ? name : folder.join(name).toString();
+        if (exists(path))
+            return path;
+    }
+    for (auto dir : includePath) {
+        cstring path = Util::PathName(dir).join(name).toString();
+        if (exists(path))
+            return path;
+    }
+    return nullptr;
+}
+
+void Preprocessor::include(const Tokens& tokens, unsigned physicalLines, std::string& output) {
+    Tokens arguments;
+    for (auto& t : tokens)
+        if (t.kind != Token::Space)
+            arguments.push_back(t);
+    if (!arguments.empty() && arguments[0].kind != Token::String && !arguments[0].is("<")) {
+        // a computed include
+        std::deque<Token> queue(tokens.begin(), tokens.end());
+        Tokens expanded;
+        expand(queue, expanded, nullptr);
+        arguments.clear();
+        for (auto& t : expanded)
+            if (t.kind != Token::Space)
+                arguments.push_back(t);
+    }
+
+    std::string name;
+    bool quoted = false;
+    if (!arguments.empty() && arguments[0].kind == Token::String) {
+        name = arguments[0].text.substr(1, arguments[0].text.size() - 2);
+        quoted = true;
+    } else if (!arguments.empty() && arguments[0].is("<")) {
+        size_t i = 1;
+        while (i < arguments.size() && !arguments[i].is(">"))
+            name += arguments[i++].text;
+        if (i == arguments.size())
+            name.clear();
+    }
+    if (name.empty()) {
+        report(true, "#include expects \"FILENAME\" or <FILENAME>");
+        output.append(physicalLines, '\n');
+        return;
+    }
+
+    auto in = inputs.back();
+    cstring path = findInclude(name, quoted);
+    const std::string* text = path ? readFile(path) : nullptr;
+    if (text == nullptr) {
+        report(true, name + ": No such file or directory");
+        output.append(physicalLines, '\n');
+        return;
+    }
+    if (onceFiles.count(path)) {
+        output.append(physicalLines, '\n');
+        return;
+    }
+    processFile(path, text, output);
+    output += marker(in->linesRead + 1 + in->lineDelta);
+}
+
+void Preprocessor::defineMacro(const Tokens& tokens, size_t start) {
+    size_t i = start;
+    while (i < tokens.size() && tokens[i].kind == Token::Space)
+        ++i;
+    if (i == tokens.size() || tokens[i].kind != Token::Identifier) {
+        report(true, "macro names must be identifiers");
+        return;
+    }
+    std::string name = tokens[i++].text;
+    if (name == "defined") {
+        report(true, "\"defined\" cannot be used as a macro name");
+        return;
+    }
+
+    Macro macro;
+    if (i < tokens.size() && tokens[i].is("(")) {
+        // no space before the parenthesis: a function-like macro
+        macro.functionLike = true;
+        ++i;
+        bool valid = false;
+        while (i < tokens.size()) {
+            auto& t = tokens[i++];
+            if (t.kind == Token::Space)
+                continue;
+            if (t.is(")") && macro.parameters.empty() && !macro.variadic) {
+                valid = true;
+                break;
+            }
+            if (t.is("...")) {
+                macro.variadic = true;
+                macro.parameters.push_back("__VA_ARGS__");
+            } else if (t.kind == Token::Identifier && !macro.variadic) {
+                macro.parameters.push_back(t.text);
+                if (i < tokens.size() && tokens[i].is("...")) {
+                    macro.variadic = true;
+                    ++i;
+                }
+            } else {
+                break;
+            }
+            while (i < tokens.size() && tokens[i].kind == Token::Space)
+                ++i;
+            if (i < tokens.size() && tokens[i].is(")")) {
+                ++i;
+                valid = true;
+                break;
+            }
+            if (i == tokens.size() || !tokens[i].is(",") || macro.variadic)
+                break;
+            ++i;
+        }
+        if (!valid) {
+            report(true, "invalid parameter list for macro \"" + name + "\"");
+            return;
+        }
+    }
+
+    // Whitespace, including comments, becomes a single space.
+    for (; i < tokens.size(); ++i) {
+        if (tokens[i].kind != Token::Space)
+            macro.body.push_back(tokens[i]);
+        else if (!macro.body.empty() && macro.body.back().kind != Token::Space)
+            macro.body.emplace_back(Token::Space, " ");
+    }
+    if (!macro.body.empty() && macro.body.back().kind == Token::Space)
+        macro.body.pop_back();
+
+    auto it = macros.find(name);
+    if (it != macros.end()) {
+        auto& old = it->second;
+        if (old.functionLike != macro.functionLike || old.parameters != macro.parameters ||
+            toText(old.body) != toText(macro.body))
+            report(false, "\"" + name + "\" redefined");
+    }
+    macros[name] = macro;
+}
+
+void Preprocessor::define(cstring definition) {
+    std::string text = definition.c_str();
+    auto equals = text.find('=');
+    if (equals == std::string::npos)
+        text += " 1";
+    else
+        text[equals] = ' ';
+    Tokens tokens;
+    bool inComment = false;
+    tokenize(text, tokens, inComment);
+    defineMacro(tokens, 0);
+}
+
+void Preprocessor::undefine(cstring name) {
+    macros.erase(name.c_str());
+}
+
+long long Preprocessor::evaluate(const Tokens& tokens) {
+    // 'defined' is handled before any macro is expanded.
+    std::deque<Token> queue;
+    for (size_t i = 0; i < tokens.size(); ++i) {
+        if (tokens[i].kind != Token::Identifier || tokens[i].text != "defined") {
+            queue.push_back(tokens[i]);
+            continue;
+        }
+        size_t j = i + 1;
+        while (j < tokens.size() && tokens[j].kind == Token::Space)
+            ++j;
+        bool parenthesized = j < tokens.size() && tokens[j].is("(");
+        if (parenthesized) {
+            ++j;
+            while (j < tokens.size() && tokens[j].kind == Token::Space)
+                ++j;
+        }
+        if (j == tokens.size() || tokens[j].kind != Token::Identifier) {
+            report(true, "operator \"defined\" requires an identifier");
+            return 0;
+        }
+        bool defined = macros.count(tokens[j].text) != 0;
+        if (parenthesized) {
+            ++j;
+            while (j < tokens.size() && tokens[j].kind == Token::Space)
+                ++j;
+            if (j == tokens.size() || !tokens[j].is(")")) {
+                report(true, "missing ')' after \"defined\"");
+                return 0;
+            }
+        }
+        queue.emplace_back(Token::Number, defined ? "1" : "0");
+        i = j;
+    }
+
+    Tokens expanded;
+    expand(queue, expanded, nullptr);
+    std::vector<std::string> texts;
+    for (auto& t : expanded)
+        if (t.kind != Token::Space)
+            texts.push_back(t.text);
+    long long value = 0;
+    std::string message;
+    if (!ExpressionEvaluator(texts).run(value, message)) {
+        report(true, message);
+        return 0;
+    }
+    return value;
+}
+
+void Preprocessor::expand(std::deque<Token>& input, Tokens& output,
+                          const std::function<bool(std::deque<Token>&)>& more) {
+    auto emit = [&output](const Token& token) {
+        // Keep tokens from an expansion from lexing together with their
+        // neighbours, as cpp does.
+        if (!output.empty() && token.kind != Token::Space &&
+            output.back().kind != Token::Space && (token.hideSet || output.back().hideSet) &&
+            (token.kind == Token::Punctuation) == (output.back().kind == Token::Punctuation))
+            output.emplace_back(Token::Space, " ");
+        output.push_back(token);
+    };
+
+    while (!input.empty()) {
+        Token token = input.front();
+        input.pop_front();
+        if (token.kind != Token::Identifier ||
+            (token.hideSet && token.hideSet->count(token.text))) {
+            emit(token);
+            continue;
+        }
+        auto it = macros.find(token.text);
+        if (it == macros.end()) {
+            auto in = inputs.empty() ? nullptr : inputs.back();
+            if (in && token.text == "__LINE__")
+                token = Token(Token::Number, std::to_string(in->line + in->lineDelta));
+            else if (in && token.text == "__FILE__")
+                token = Token(Token::String, std::string("\"") + in->presumedName.c_str() + "\"");
+            emit(token);
+            continue;
+        }
+        const Macro& macro = it->second;
+
+        auto hideSet = std::make_shared<std::set<std::string>>();
+        if (!macro.functionLike) {
+            if (token.hideSet)
+                *hideSet = *token.hideSet;
+            hideSet->insert(token.text);
+            Tokens body = substitute(macro, {}, hideSet);
+            input.insert(input.begin(), body.begin(), body.end());
+            continue;
+        }
+
+        // A function-like macro is only expanded when followed by '('.
+        size_t next = 0;
+        while (true) {
+            while (next < input.size() && input[next].kind == Token::Space)
+                ++next;
+            if (next < input.size() || !more || !more(input))
+                break;
+        }
+        if (next >= input.size() || !input[next].is("(")) {
+            emit(token);
+            continue;
+        }
+
+        std::vector<Tokens> arguments(1);
+        size_t parameters = macro.parameters.size();
+        int depth = 0;
+        size_t k = next + 1;
+        bool closed = false;
+        std::shared_ptr<const std::set<std::string>> closingHideSet;
+        while (true) {
+            if (k >= input.size()) {
+                if (more && more(input))
+                    continue;
+                break;
+            }
+            Token t = input[k++];
+            if (t.kind == Token::Space && t.text.find('\n') != std::string::npos)
+                t.text = " ";  // the call is written on one line
+            if (t.is("(")) {
+                ++depth;
+            } else if (t.is(")")) {
+                if (depth == 0) {
+                    closed = true;
+                    closingHideSet = t.hideSet;
+                    break;
+                }
+                --depth;
+            } else if (t.is(",") && depth == 0 &&
+                       !(macro.variadic && arguments.size() == parameters)) {
+                arguments.emplace_back();
+                continue;
+            }
+            arguments.back().push_back(t);
+        }
+        if (!closed) {
+            report(true, "unterminated argument list invoking macro \"" + token.text + "\"");
+            emit(token);
+            continue;
+        }
+        input.erase(input.begin(), input.begin() + k);
+
+        for (auto& argument : arguments) {
+            while (!argument.empty() && argument.back().kind == Token::Space)
+                argument.pop_back();
+            size_t leading = 0;
+            while (leading < argument.size() && argument[leading].kind == Token::Space)
+                ++leading;
+            argument.erase(argument.begin(), argument.begin() + leading);
+        }
+        if (parameters == 0 && arguments.size() == 1 && arguments[0].empty())
+            arguments.clear();
+        if (macro.variadic && arguments.size() + 1 == parameters)
+            arguments.emplace_back();
+        if (arguments.size() != parameters) {
+            report(true, Util::printf_format("macro \"%s\" requires %d arguments, but %d given",
+                                             token.text.c_str(), parameters,
+                                             arguments.size()).c_str());
+            emit(token);
+            continue;
+        }
+
+        // hide set: the macro, and what was hidden at both ends of the call
+        if (token.hideSet && closingHideSet)
+            for (auto& name : *token.hideSet)
+                if (closingHideSet->count(name))
+                    hideSet->insert(name);
+        hideSet->insert(token.text);
+        Tokens body = substitute(macro, arguments, hideSet);
+        input.insert(input.begin(), body.begin(), body.end());
+    }
+}
+
+Preprocessor::Tokens
+Preprocessor::substitute(const Macro& macro, const std::vector<Tokens>& arguments,
+                         std::shared_ptr<const std::set<std::string>> hideSet) {
+    auto& body = macro.body;
+    auto parameter = [&macro](const Token& t) -> int {
+        if (!macro.functionLike || t.kind != Token::Identifier)
+            return -1;
+        for (size_t i = 0; i < macro.parameters.size(); ++i)
+            if (macro.parameters[i] == t.text)
+                return i;
+        return -1;
+    };
+    auto nextNonSpace = [&body](size_t i) {
+        for (++i; i < body.size() && body[i].kind == Token::Space; ++i) {}
+        return i;
+    };
+
+    Tokens result;
+    for (size_t i = 0; i < body.size(); ++i) {
+        auto& t = body[i];
+        size_t next = nextNonSpace(i);
+        if (macro.functionLike && t.is("#") && next < body.size() && parameter(body[next]) >= 0) {
+            result.emplace_back(Token::String, stringize(arguments[parameter(body[next])]));
+            i = next;
+        } else if (t.is("##") && next < body.size()) {
+            while (!result.empty() && result.back().kind == Token::Space)
+                result.pop_back();
+            int index = parameter(body[next]);
+            Tokens right = index >= 0 ? arguments[index] : Tokens{ body[next] };
+            i = next;
+            if (right.empty())
+                continue;
+            if (result.empty() || result.back().kind == Token::Placemarker) {
+                if (!result.empty())
+                    result.pop_back();
+                result.insert(result.end(), right.begin(), right.end());
+                continue;
+            }
+            std::string text = result.back().text + right.front().text;
+            result.pop_back();
+            Tokens pasted;
+            bool inComment = false;
+            tokenize(text, pasted, inComment);
+            if (pasted.size() != 1)
+                report(true, "pasting does not give a valid preprocessing token: " + text);
+            result.insert(result.end(), pasted.begin(), pasted.end());
+            result.insert(result.end(), right.begin() + 1, right.end());
+        } else if (parameter(t) >= 0) {
+            auto& argument = arguments[parameter(t)];
+            if (next < body.size() && body[next].is("##")) {
+                // operands of ## are not expanded
+                if (argument.empty())
+                    result.emplace_back(Token::Placemarker, "");
+                result.insert(result.end(), argument.begin(), argument.end());
+            } else {
+                std::deque<Token> queue(argument.begin(), argument.end());
+                Tokens expanded;
+                expand(queue, expanded, nullptr);
+                result.insert(result.end(), expanded.begin(), expanded.end());
+            }
+        } else {
+            result.push_back(t);
+        }
+    }
+
+    result.erase(std::remove_if(result.begin(), result.end(), [](const Token& t) {
+        return t.kind == Token::Placemarker; }), result.end());
+    for (auto& t : result) {
+        if (!t.hideSet) {
+            t.hideSet = hideSet;
+        } else if (t.hideSet != hideSet) {
+            auto merged = std::make_shared<std::set<std::string>>(*t.hideSet);
+            merged->insert(hideSet->begin(), hideSet->end());
+            t.hideSet = merged;
+        }
+    }
+    return result;
+}
+
+bool Preprocessor::process(cstring file, std::string& output) {
+    auto errors = ::errorCount();
+    const std::string* text;
+    if (file == "-" || file == "<stdin>") {
+        auto input = new std::string;
+        char buffer[64 * 1024];
+        size_t count;
+        while ((count = fread(buffer, 1, sizeof(buffer), stdin)) > 0)
+            input->append(buffer, count);
+        text = input;
+        file = "<stdin>";
+    } else {
+        text = readFile(file);
+    }
+    if (text == nullptr) {
+        ::error("input file %s does not exist", file);
+        return false;
+    }
+    processFile(file, text, output);
+    return ::errorCount() == errors;
+}
+
+bool Preprocessor::preload(cstring file) {
+    return readFile(file) != nullptr;
+}
+
+}  // namespace P4
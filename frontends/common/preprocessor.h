@@ -0,0 +1,138 @@
+/*
+Copyright 2013-present Barefoot Networks, Inc.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#ifndef FRONTENDS_COMMON_PREPROCESSOR_H_
+#define FRONTENDS_COMMON_PREPROCESSOR_H_
+
+#include <deque>
+#include <functional>
+#include <map>
+#include <memory>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "lib/cstring.h"
+
+namespace P4 {
+
+/**
+ * A C preprocessor that runs inside the compiler, so that compiling a
+ * program does not need to start cpp.  It implements the parts of cpp
+ * that P4 sources use:
+ *  - #include "file" and <file>, also computed includes;
+ *  - object-like and function-like macros, including variadic macros,
+ *    stringizing (#) and token pasting (##);
+ *  - #if, #ifdef, #ifndef, #elif, #else and #endif, with defined() and the
+ *    C integer operators;
+ *  - #undef, #error, #warning, #line and #pragma once; other pragmas are
+ *    copied to the output.
+ * As with 'cpp -C -undef -nostdinc' comments are kept, only the standard
+ * macros are predefined, and the output has the same line markers, so
+ * the lexer maps positions back to the original files.
+ *
+ * Problems are reported with ::error and ::warning.  The files read are
+ * cached for the whole process (and checked for changes), so the
+ * architecture include files are only read once however many programs
+ * include them.
+ */
+class Preprocessor {
+    struct Token {
+        // A Placemarker stands for an empty operand of ## during substitution.
+        enum Kind { Identifier, Number, String, Punctuation, Space, Placemarker };
+        Kind kind;
+        std::string text;
+        // macros which must not be expanded again in this token
+        std::shared_ptr<const std::set<std::string>> hideSet;
+
+        Token(Kind kind, std::string text) : kind(kind), text(text) {}
+        bool is(const char* punctuation) const
+        { return kind == Punctuation && text == punctuation; }
+    };
+    typedef std::vector<Token> Tokens;
+
+    struct Macro {
+        bool functionLike = false;
+        bool variadic = false;
+        std::vector<std::string> parameters;
+        Tokens body;
+    };
+
+    /// The state of a conditional (#if ... #endif) group.
+    struct Conditional {
+        bool active;      // lines are currently processed
+        bool taken;       // a branch of this group was already active
+        bool sawElse;
+        unsigned line;    // of the #if, for error messages
+    };
+
+    /// A file being processed.
+    struct Input {
+        cstring path;
+        const std::string* text;
+        size_t position = 0;
+        unsigned linesRead = 0;
+        unsigned line = 0;          // first physical line of the current line
+        cstring presumedName;       // name and line offset, as changed by #line
+        int lineDelta = 0;
+        bool inComment = false;     // the text read so far ends inside a comment
+        bool outputInComment = false;  // so does the output written for it
+        std::vector<Conditional> conditionals;
+    };
+
+    std::vector<cstring> includePath;
+    std::map<std::string, Macro> macros;
+    std::set<cstring> onceFiles;
+    std::vector<Input*> inputs;
+
+    static void tokenize(const std::string& text, Tokens& out, bool& inComment);
+    static std::string toText(const Tokens& tokens);
+    static std::string stringize(const Tokens& tokens);
+
+    void report(bool isError, const std::string& message) const;
+    bool isActive() const;
+    bool readLine(std::string& line, unsigned& physicalLines);
+    void processFile(cstring path, const std::string* text, std::string& output);
+    void directive(const Tokens& tokens, size_t start, unsigned physicalLines,
+                   const std::string& line, std::string& output);
+    void include(const Tokens& tokens, unsigned physicalLines, std::string& output);
+    void defineMacro(const Tokens& tokens, size_t start);
+    long long evaluate(const Tokens& tokens);
+    std::string marker(unsigned line) const;
+    void expand(std::deque<Token>& input, Tokens& output,
+                const std::function<bool(std::deque<Token>&)>& more);
+    Tokens substitute(const Macro& macro, const std::vector<Tokens>& arguments,
+                      std::shared_ptr<const std::set<std::string>> hideSet);
+    cstring findInclude(cstring name, bool quoted) const;
+
+ public:
+    explicit Preprocessor(const std::vector<cstring>& includePath);
+    /// Define a macro, given as for cpp -D: 'name', 'name=value' or
+    /// 'name(args)=value'.
+    void define(cstring definition);
+    /// Remove a macro definition, as for cpp -U.
+    void undefine(cstring name);
+    /// Preprocess file ("-" is stdin) and append the result to output.
+    /// @returns false if errors were reported.
+    bool process(cstring file, std::string& output);
+    /// Read file into the cache shared by all preprocessors.
+    /// @returns false if it cannot be read.
+    static bool preload(cstring file);
+};
+
+}  // namespace P4
+
+#endif /* FRONTENDS_COMMON_PREPROCESSOR_H_ */
@@ -24,14 +24,113 @@ namespace P4 {
 // Base class for various maps.
 // A map is computed on a certain P4Program.
 // If the program has not changed, the map is up-to-date.
+// In incremental mode a map computed for a previous version of the program
+// may be partially reused: only the top-level declarations that have been
+// replaced need to be recomputed.
 class ProgramMap : public IHasDbPrint {
  protected:
     const IR::P4Program* program = nullptr;
     cstring mapKind;
+    bool incremental = false;
+    // The map was computed for the declarations that start the programs it
+    // is used for, like those of the standard include files.
+    bool prefix = false;
     explicit ProgramMap(cstring kind) : mapKind(kind) {}
     virtual ~ProgramMap() {}
 
+    // Top-level declarations whose body may change without forcing
+    // a recomputation of the map for the rest of the program.
+    static bool isReplaceable(const IR::Node* node) {
+        return node->is<IR::P4Control>() || node->is<IR::P4Parser>() ||
+               node->is<IR::P4Action>() || node->is<IR::Function>();
+    }
+
+    // True if the replacement @p after of declaration @p before has the same
+    // signature, so that the declarations that use it need no recomputation.
+    static bool sameSignature(const IR::Node* before, const IR::Node* after) {
+        if (auto control = before->to<IR::P4Control>()) {
+            auto other = after->to<IR::P4Control>();
+            return control->type == other->type &&
+                   control->constructorParams == other->constructorParams;
+        }
+        if (auto parser = before->to<IR::P4Parser>()) {
+            auto other = after->to<IR::P4Parser>();
+            return parser->type == other->type &&
+                   parser->constructorParams == other->constructorParams;
+        }
+        if (auto action = before->to<IR::P4Action>())
+            return action->parameters == after->to<IR::P4Action>()->parameters;
+        if (auto function = before->to<IR::Function>())
+            return function->type == after->to<IR::Function>()->type;
+        return false;
+    }
+
+    // True if @p after is @p before with more errors: the error
+    // declarations of a program are merged into a copy of the first one.
+    static bool moreErrors(const IR::Node* before, const IR::Node* after) {
+        auto errors = before->to<IR::Type_Error>();
+        auto other = after->to<IR::Type_Error>();
+        if (errors == nullptr || other == nullptr ||
+            errors->members.size() > other->members.size())
+            return false;
+        for (size_t i = 0; i < errors->members.size(); i++)
+            if (errors->members[i] != other->members[i])
+                return false;
+        return true;
+    }
+
  public:
+    void setIncremental(bool incremental) { this->incremental = incremental; }
+    bool isIncremental() const { return incremental; }
+    // Until the map is updated, it is for the declarations that start
+    // the programs it is compared with.
+    void setPrefix() { prefix = true; }
+
+    // Compare the top-level declarations of @p node with the ones of the
+    // program the map was computed for.  Returns false if the map must be
+    // recomputed from scratch.  Otherwise the declarations present in both
+    // programs are inserted in @p unchanged, and each replaced declaration
+    // is mapped in @p replaced to its new version.  Only controls, parsers,
+    // actions and functions may be replaced, and their name, kind, signature
+    // and position in the program must stay the same.  If the map is for a
+    // prefix, @p node may have more declarations, which are neither unchanged
+    // nor replaced, and its error declaration may have more errors.
+    bool diffDeclarations(const IR::Node* node,
+                          std::set<const IR::Node*>& unchanged,
+                          std::map<const IR::Node*, const IR::Node*>& replaced) const {
+        if (!incremental || program == nullptr || node == nullptr)
+            return false;
+        auto newProgram = node->to<IR::P4Program>();
+        if (newProgram == nullptr)
+            return false;
+        auto& before = program->declarations;
+        auto& after = newProgram->declarations;
+        if (prefix ? before.size() > after.size() : before.size() != after.size())
+            return false;
+        for (size_t i = 0; i < before.size(); i++) {
+            auto o = before[i];
+            auto n = after[i];
+            if (o == n) {
+                unchanged.emplace(n);
+                continue;
+            }
+            if (prefix && moreErrors(o, n)) {
+                replaced.emplace(o, n);
+                continue;
+            }
+            if (!isReplaceable(o) || o->node_type_name() != n->node_type_name())
+                return false;
+            if (o->to<IR::IDeclaration>()->getName() != n->to<IR::IDeclaration>()->getName())
+                return false;
+            if (!sameSignature(o, n))
+                return false;
+            replaced.emplace(o, n);
+        }
+        LOG2(mapKind << " reused for " << unchanged.size() << " declarations, "
+             << replaced.size() << " replaced");
+        return true;
+    }
+
     // Check if map is up-to-date for the specified node; return true if it is
     bool checkMap(const IR::Node* node) const {
         if (node == program) {
@@ -54,6 +153,7 @@ class ProgramMap : public IHasDbPrint {
         if (node == nullptr || !node->is<IR::P4Program>())
             return;
         program = node->to<IR::P4Program>();
+        prefix = false;
         LOG2(mapKind << " updated to " << dbp(node));
     }
 };
@@ -27,10 +27,44 @@ void ReferenceMap::clear() {
     usedNames.clear();
     used.clear();
     thisToDeclaration.clear();
+    pathsByDeclaration.clear();
     usedNames.insert(P4::reservedWords.begin(), P4::reservedWords.end());
 }
 
-void ReferenceMap::setDeclaration(const IR::Path* path, const IR::IDeclaration* decl) {
+bool ReferenceMap::retainUnchanged(const IR::Node* node,
+                                   std::set<const IR::Node*>& unchanged) {
+    std::map<const IR::Node*, const IR::Node*> replaced;
+    // abstract method bodies are not tracked per declaration
+    if (!thisToDeclaration.empty() || !diffDeclarations(node, unchanged, replaced)) {
+        unchanged.clear();
+        return false;
+    }
+
+    // A path may be shared by several declarations; keep it if any of them is unchanged.
+    std::map<const IR::Path*, const IR::IDeclaration*> retained;
+    for (auto it = pathsByDeclaration.begin(); it != pathsByDeclaration.end(); ) {
+        if (it->first == nullptr || !unchanged.count(it->first)) {
+            it = pathsByDeclaration.erase(it);
+            continue;
+        }
+        for (auto path : it->second)
+            retained.emplace(path, pathToDeclaration.at(path));
+        ++it;
+    }
+    pathToDeclaration.swap(retained);
+
+    used.clear();
+    for (auto& e : pathToDeclaration) {
+        auto it = replaced.find(e.second->getNode());
+        if (it != replaced.end())
+            e.second = it->second->to<IR::IDeclaration>();
+        used.insert(e.second);
+    }
+    return true;
+}
+
+void ReferenceMap::setDeclaration(const IR::Path* path, const IR::IDeclaration* decl,
+                                  const IR::Node* owner) {
     CHECK_NULL(path);
     CHECK_NULL(decl);
     LOG1("Resolved " << path << " to " << decl);
@@ -39,6 +73,8 @@ void ReferenceMap::setDeclaration(const IR::Path* path, const IR::IDeclaration*
         BUG("%1% already resolved to %2% instead of %3%",
             dbp(path), dbp(previous), dbp(decl->getNode()));
     pathToDeclaration.emplace(path, decl);
+    if (incremental)
+        pathsByDeclaration[owner].push_back(path);
     usedName(path->name.name);
     used.insert(decl);
 }
@@ -48,14 +48,20 @@ class ReferenceMap final : public ProgramMap, public NameGenerator {
     /// Set containing all names used in the program.
     std::set<cstring> usedNames;
 
+    /// Paths resolved within each top-level declaration of the program.
+    /// Only maintained in incremental mode.
+    std::map<const IR::Node*, std::vector<const IR::Path*>> pathsByDeclaration;
+
  public:
     ReferenceMap();
     /// Looks up declaration for @p path. If @p notNull is false, then
     /// failure to find a declaration is an error.
     const IR::IDeclaration* getDeclaration(const IR::Path* path, bool notNull = false) const;
 
-    /// Sets declaration for @p path to @p decl.
-    void setDeclaration(const IR::Path* path, const IR::IDeclaration* decl);
+    /// Sets declaration for @p path to @p decl.  @p owner is the
+    /// top-level declaration of the program that contains @p path.
+    void setDeclaration(const IR::Path* path, const IR::IDeclaration* decl,
+                        const IR::Node* owner = nullptr);
 
     /// Looks up declaration for @p pointer. If @p notNull is false,
     /// then failure to find a declaration is an error.
@@ -75,6 +81,14 @@ class ReferenceMap final : public ProgramMap, public NameGenerator {
     /// Clear the reference map
     void clear();
 
+    /// Prepare the map to be updated incrementally for @p node.
+    /// Keeps the resolutions of all paths in the top-level declarations
+    /// shared with the previous program (inserted in @p unchanged) and
+    /// redirects references to replaced declarations.  Names used by
+    /// the previous program remain reserved.
+    /// @returns @false if the whole map has to be recomputed.
+    bool retainUnchanged(const IR::Node* node, std::set<const IR::Node*>& unchanged);
+
     /// @returns @true if this map is for a P4_14 program
     bool isV1() const { return isv1; }
 
@@ -19,98 +19,93 @@ limitations under the License.
 
 namespace P4 {
 
-std::vector<const IR::IDeclaration*>*
-ResolutionContext::resolve(IR::ID name, P4::ResolutionType type, bool forwardOK) const {
-    static std::vector<const IR::IDeclaration*> empty;
-
-    std::vector<const IR::INamespace*> toTry(stack);
-    toTry.insert(toTry.end(), globals.begin(), globals.end());
-
-    for (auto it = toTry.rbegin(); it != toTry.rend(); ++it) {
-        const IR::INamespace* current = *it;
-        LOG2("Trying to resolve in " << current->toString());
-
-        if (current->is<IR::IGeneralNamespace>()) {
-            auto gen = current->to<IR::IGeneralNamespace>();
-            Util::Enumerator<const IR::IDeclaration*>* decls = gen->getDeclsByName(name);
-            switch (type) {
-                case P4::ResolutionType::Any:
-                    break;
-                case P4::ResolutionType::Type: {
-                    std::function<bool(const IR::IDeclaration*)> kindFilter =
-                            [](const IR::IDeclaration* d) {
-                        return d->is<IR::Type>();
-                    };
-                    decls = decls->where(kindFilter);
-                    break;
-                }
-                case P4::ResolutionType::TypeVariable: {
-                    std::function<bool(const IR::IDeclaration*)> kindFilter =
-                            [](const IR::IDeclaration* d) {
-                    return d->is<IR::Type_Var>(); };
-                    decls = decls->where(kindFilter);
-                    break;
-                }
-            default:
-                BUG("Unexpected enumeration value %1%", static_cast<int>(type));
-            }
+const std::vector<const IR::IDeclaration*>&
+ResolutionContext::declsByName(const IR::IGeneralNamespace* ns, cstring name) const {
+    static const std::vector<const IR::IDeclaration*> empty;
+    auto it = generalIndex.find(ns);
+    if (it == generalIndex.end()) {
+        it = generalIndex.emplace(ns, NameIndex()).first;
+        for (auto decl : *ns->getDeclarations())
+            it->second[decl->getName().name].push_back(decl);
+    }
+    auto decls = it->second.find(name);
+    return decls == it->second.end() ? empty : decls->second;
+}
+
+bool ResolutionContext::matches(const IR::IDeclaration* decl, IR::ID name,
+                                P4::ResolutionType type, bool forwardOK) const {
+    switch (type) {
+        case P4::ResolutionType::Any:
+            break;
+        case P4::ResolutionType::Type:
+            if (!decl->is<IR::Type>())
+                return false;
+            break;
+        case P4::ResolutionType::TypeVariable:
+            if (!decl->is<IR::Type_Var>())
+                return false;
+            break;
+    default:
+        BUG("Unexpected enumeration value %1%", static_cast<int>(type));
+    }
 
-            if (!forwardOK) {
-                std::function<bool(const IR::IDeclaration*)> locationFilter =
-                        [name](const IR::IDeclaration* d) {
-                    Util::SourceInfo nsi = name.srcInfo;
-                    Util::SourceInfo dsi = d->getNode()->srcInfo;
-                    bool before = dsi <= nsi;
-                    LOG2("\tPosition test:" << dsi << "<=" << nsi << "=" << before);
-                    return before;
-                };
-                decls = decls->where(locationFilter);
-            }
+    if (!forwardOK) {
+        Util::SourceInfo nsi = name.srcInfo;
+        Util::SourceInfo dsi = decl->getNode()->srcInfo;
+        bool before = dsi <= nsi;
+        LOG2("\tPosition test:" << dsi << "<=" << nsi << "=" << before);
+        if (!before)
+            return false;
+    }
+    return true;
+}
 
-            auto vector = decls->toVector();
-            if (!vector->empty()) {
-                LOG2("Resolved in " << dbp(current->getNode()));
-                return vector;
-            } else {
-                continue;
-            }
-        } else {
-            auto simple = current->to<IR::ISimpleNamespace>();
-            auto decl = simple->getDeclByName(name);
-            if (decl == nullptr)
-                continue;
-            switch (type) {
-                case P4::ResolutionType::Any:
-                    break;
-                case P4::ResolutionType::Type: {
-                    if (!decl->is<IR::Type>())
-                        continue;
-                    break;
-                }
-                case P4::ResolutionType::TypeVariable: {
-                    if (!decl->is<IR::Type_Var>())
-                        continue;
-                    break;
-                }
-            default:
-                BUG("Unexpected enumeration value %1%", static_cast<int>(type));
+const std::vector<const IR::IDeclaration*>*
+ResolutionContext::resolveIn(const IR::INamespace* current, IR::ID name,
+                             P4::ResolutionType type, bool forwardOK) const {
+    LOG2("Trying to resolve in " << current->toString());
+    const std::vector<const IR::IDeclaration*>* result = nullptr;
+    if (auto gen = current->to<IR::IGeneralNamespace>()) {
+        // Usually all the declarations of the name match, and the index
+        // entry itself is the result.
+        auto& decls = declsByName(gen, name);
+        bool all = true;
+        for (size_t i = 0; i < decls.size(); ++i) {
+            if (matches(decls[i], name, type, forwardOK)) {
+                if (!all)
+                    matching.push_back(decls[i]);
+            } else if (all) {
+                all = false;
+                matching.assign(decls.begin(), decls.begin() + i);
             }
+        }
+        auto& found = all ? decls : matching;
+        if (!found.empty())
+            result = &found;
+    } else {
+        auto simple = current->to<IR::ISimpleNamespace>();
+        auto decl = simple->getDeclByName(name);
+        if (decl != nullptr && matches(decl, name, type, forwardOK)) {
+            matching.assign(1, decl);
+            result = &matching;
+        }
+    }
+    if (result != nullptr)
+        LOG2("Resolved in " << dbp(current->getNode()));
+    return result;
+}
 
-            if (!forwardOK) {
-                Util::SourceInfo nsi = name.srcInfo;
-                Util::SourceInfo dsi = decl->getNode()->srcInfo;
-                bool before = dsi <= nsi;
-                LOG2("\tPosition test:" << dsi << "<=" << nsi << "=" << before);
-                if (!before)
-                    continue;
-            }
+const std::vector<const IR::IDeclaration*>*
+ResolutionContext::resolve(IR::ID name, P4::ResolutionType type, bool forwardOK) const {
+    static const std::vector<const IR::IDeclaration*> empty;
 
-            LOG2("Resolved in " << dbp(current->getNode()));
-            auto result = new std::vector<const IR::IDeclaration*>();
-            result->push_back(decl);
+    // Globals are searched before the stack, innermost namespace first.
+    for (auto it = globals.rbegin(); it != globals.rend(); ++it)
+        if (auto result = resolveIn(*it, name, type, forwardOK))
+            return result;
+    for (auto it = stack.rbegin(); it != stack.rend(); ++it)
+        if (auto result = resolveIn(*it, name, type, forwardOK))
             return result;
-        }
-    }
 
     return &empty;
 }
@@ -170,7 +165,8 @@ ResolveReferences::ResolveReferences(ReferenceMap* refMap,
         context(nullptr),
         rootNamespace(nullptr),
         anyOrder(false),
-        checkShadow(checkShadow) {
+        checkShadow(checkShadow),
+        topLevel(nullptr) {
     CHECK_NULL(refMap);
     setName("ResolveReferences");
     visitDagOnce = false;
@@ -210,7 +206,7 @@ void ResolveReferences::resolvePath(const IR::Path* path, bool isType) const {
         return;
     }
 
-    refMap->setDeclaration(path, decl);
+    refMap->setDeclaration(path, decl, topLevel);
 }
 
 void ResolveReferences::checkShadowing(const IR::INamespace* ns) const {
@@ -242,7 +238,8 @@ void ResolveReferences::checkShadowing(const IR::INamespace* ns) const {
 
 Visitor::profile_t ResolveReferences::init_apply(const IR::Node* node) {
     anyOrder = refMap->isV1();
-    if (!refMap->checkMap(node))
+    unchanged.clear();
+    if (!refMap->checkMap(node) && !refMap->retainUnchanged(node, unchanged))
         refMap->clear();
     return Inspector::init_apply(node);
 }
@@ -262,7 +259,21 @@ bool ResolveReferences::preorder(const IR::P4Program* program) {
     BUG_CHECK(rootNamespace == nullptr, "Root namespace already set");
     rootNamespace = program;
     context = new ResolutionContext(rootNamespace);
-    return true;
+
+    // Visit the declarations explicitly to know which one each path belongs to,
+    // and to skip the ones whose references are already resolved.
+    for (auto decl : program->declarations) {
+        if (unchanged.count(decl)) {
+            if (auto mk = decl->to<IR::Declaration_MatchKind>())
+                addToGlobals(mk);
+            continue;
+        }
+        topLevel = decl;
+        visit(decl);
+    }
+    topLevel = nullptr;
+    postorder(program);
+    return false;
 }
 
 void ResolveReferences::postorder(const IR::P4Program*) {
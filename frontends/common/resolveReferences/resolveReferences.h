@@ -17,6 +17,8 @@ limitations under the License.
 #ifndef _COMMON_RESOLVEREFERENCES_RESOLVEREFERENCES_H_
 #define _COMMON_RESOLVEREFERENCES_RESOLVEREFERENCES_H_
 
+#include <unordered_map>
+#include <vector>
 #include "ir/ir.h"
 #include "referenceMap.h"
 #include "lib/exceptions.h"
@@ -41,6 +43,26 @@ class ResolutionContext : public IHasDbPrint {
     /// @todo: what about errors?
     std::vector<const IR::INamespace*> globals;
 
+    typedef std::unordered_map<cstring, std::vector<const IR::IDeclaration*>> NameIndex;
+    /// Declarations of each general namespace searched so far, by name.
+    /// Built the first time a namespace is searched; the IR does not change
+    /// while a context is in use.
+    mutable std::unordered_map<const IR::IGeneralNamespace*, NameIndex> generalIndex;
+
+    /// The result of a lookup that is not a whole entry of the index, as in a
+    /// simple namespace; reused so that lookups do not allocate.
+    mutable std::vector<const IR::IDeclaration*> matching;
+
+    const std::vector<const IR::IDeclaration*>&
+    declsByName(const IR::IGeneralNamespace* ns, cstring name) const;
+    /// True if @p decl is of kind @p type and, unless @p forwardOK, precedes @p name.
+    bool matches(const IR::IDeclaration* decl, IR::ID name,
+                 ResolutionType type, bool forwardOK) const;
+    /// Declarations matching @p name in namespace @p ns alone, or nullptr if none.
+    /// The result is valid until the next lookup.
+    const std::vector<const IR::IDeclaration*>*
+    resolveIn(const IR::INamespace* ns, IR::ID name, ResolutionType type, bool forwardOK) const;
+
  public:
     explicit ResolutionContext(const IR::INamespace* rootNamespace) :
             rootNamespace(rootNamespace)
@@ -74,7 +96,8 @@ class ResolutionContext : public IHasDbPrint {
 
     /// Resolve references for @p name, restricted to @p type declarations.
     /// If @p forwardOK is `false`, the referenced location must precede the location of @p name.
-    std::vector<const IR::IDeclaration*>*
+    /// The result is valid until the next lookup.
+    const std::vector<const IR::IDeclaration*>*
     resolve(IR::ID name, ResolutionType type, bool forwardOK) const;
 
     /// Resolve reference for @p name, restricted to @p type declarations, and expect one result.
@@ -113,6 +136,13 @@ class ResolveReferences : public Inspector {
     /// If @true, then warn if one declaration shadows another.
     bool checkShadow;
 
+    /// Top-level declarations whose references are already resolved
+    /// in `refMap`; only populated when `refMap` is updated incrementally.
+    std::set<const IR::Node*> unchanged;
+
+    /// Top-level declaration of the program currently being visited.
+    const IR::Node* topLevel;
+
  private:
     /// Add namespace @p ns to `context`
     void addToContext(const IR::INamespace* ns);
@@ -14,6 +14,8 @@ See the License for the specific language governing permissions and
 limitations under the License.
 */
 
+#include <algorithm>
+#include <sstream>
 #include <boost/functional/hash.hpp>
 #include "def_use.h"
 #include "frontends/p4/methodInstance.h"
@@ -26,10 +28,12 @@ namespace P4 {
 // internal name for header valid bit; used only locally
 const cstring StorageFactory::validFieldName = "$valid";
 const cstring StorageFactory::indexFieldName = "$lastIndex";
+const cstring StorageFactory::unionValidFieldName = "$unionValid";
 const LocationSet* LocationSet::empty = new LocationSet();
 ProgramPoint ProgramPoint::beforeStart;
 
-StorageLocation* StorageFactory::create(const IR::Type* type, cstring name) const {
+StorageLocation* StorageFactory::create(const IR::Type* type, const StorageLocation* parent,
+                                        cstring name, unsigned index) {
     if (type->is<IR::Type_Bits>() ||
         type->is<IR::Type_Boolean>() ||
         type->is<IR::Type_Varbits>() ||
@@ -40,12 +44,15 @@ StorageLocation* StorageFactory::create(const IR::Type* type, cstring name) cons
         type->is<IR::Type_Var>() ||
         // Similarly for tuples.  This may need to be revisited if we
         // add tuple field accessors.
-        type->is<IR::Type_Tuple>())
-        return new BaseLocation(type, name);
+        type->is<IR::Type_Tuple>()) {
+        auto result = new BaseLocation(type, parent, name, index, this, baseLocations.size());
+        baseLocations.push_back(result);
+        return result;
+    }
     if (type->is<IR::Type_StructLike>()) {
         type = typeMap->getTypeType(type, true);  // get the canonical version
         auto st = type->to<IR::Type_StructLike>();
-        auto result = new StructLocation(type, name);
+        auto result = new StructLocation(type, parent, name, index, this);
 
         // For header unions we will model all of the valid fields
         // for all components as a single shared field.  The
@@ -53,18 +60,16 @@ StorageLocation* StorageFactory::create(const IR::Type* type, cstring name) cons
         // other ones.
         StorageLocation* globalValid = nullptr;
         if (type->is<IR::Type_HeaderUnion>())
-            globalValid = create(IR::Type_Boolean::get(), name + "." + validFieldName);
+            globalValid = create(IR::Type_Boolean::get(), result, validFieldName, 0);
 
         for (auto f : st->fields) {
-            cstring fieldName = name + "." + f->name;
-            auto sl = create(f->type, fieldName);
+            auto sl = create(f->type, result, f->name, 0);
             if (globalValid != nullptr)
-                dynamic_cast<StructLocation*>(sl)->replaceField(
-                    fieldName + "." + validFieldName, globalValid);
+                dynamic_cast<StructLocation*>(sl)->replaceField(unionValidFieldName, globalValid);
             result->addField(f->name, sl);
         }
         if (st->is<IR::Type_Header>()) {
-            auto valid = create(IR::Type_Boolean::get(), name + "." + validFieldName);
+            auto valid = create(IR::Type_Boolean::get(), result, validFieldName, 0);
             result->addField(validFieldName, valid);
         }
         return result;
@@ -72,17 +77,34 @@ StorageLocation* StorageFactory::create(const IR::Type* type, cstring name) cons
     if (type->is<IR::Type_Stack>()) {
         type = typeMap->getTypeType(type, true);  // get the canonical version
         auto st = type->to<IR::Type_Stack>();
-        auto result = new ArrayLocation(st, name);
+        auto result = new ArrayLocation(st, parent, name, index, this);
         for (unsigned i = 0; i < st->getSize(); i++) {
-            auto sl = create(st->elementType, name + "[" + Util::toString(i) + "]");
+            auto sl = create(st->elementType, result, nullptr, i);
             result->addElement(i, sl);
         }
-        result->setLastIndexField(create(IR::Type_Bits::get(32), name + "." + indexFieldName));
+        result->setLastIndexField(create(IR::Type_Bits::get(32), result, indexFieldName, 0));
         return result;
     }
     return nullptr;
 }
 
+void StorageLocation::printName(std::ostream& out) const {
+    if (parent != nullptr)
+        parent->printName(out);
+    if (name.isNullOrEmpty())
+        out << "[" << index << "]";
+    else if (parent != nullptr)
+        out << "." << name;
+    else
+        out << name;
+}
+
+cstring StorageLocation::toString() const {
+    std::stringstream str;
+    printName(str);
+    return str.str();
+}
+
 const LocationSet* StorageLocation::removeHeaders() const {
     auto result = new LocationSet();
     removeHeaders(result);
@@ -151,7 +173,7 @@ const LocationSet* LocationSet::join(const LocationSet* other) const {
         return other;
     if (other == LocationSet::empty)
         return this;
-    auto result = new LocationSet(locations);
+    auto result = new LocationSet(*this);
     for (auto e : other->locations)
         result->add(e);
     return result;
@@ -222,25 +244,9 @@ const LocationSet* LocationSet::canonicalize() const {
 }
 
 void LocationSet::addCanonical(const StorageLocation* location) {
-    if (location->is<BaseLocation>()) {
-        add(location);
-    } else if (location->is<StructLocation>()) {
-        for (auto f : location->to<StructLocation>()->fields())
-            addCanonical(f);
-    } else if (location->is<ArrayLocation>()) {
-        for (auto e : *location->to<ArrayLocation>())
-            addCanonical(e);
-    } else {
-        BUG("unexpected location");
-    }
-}
-
-bool LocationSet::overlaps(const LocationSet* other) const {
-    for (auto s : locations) {
-        if (other->locations.find(s) != other->locations.end())
-            return true;
-    }
-    return false;
+    // The bases of a location are already its canonical form.
+    for (unsigned id : location->getBases())
+        add(location->factory->getBase(id));
 }
 
 const ProgramPoints* ProgramPoints::merge(const ProgramPoints* with) const {
@@ -250,25 +256,43 @@ const ProgramPoints* ProgramPoints::merge(const ProgramPoints* with) const {
     return result;
 }
 
-ProgramPoint::ProgramPoint(const ProgramPoint &context, const IR::Node* node) {
-    for (auto e : context.stack)
-        stack.push_back(e);
-    stack.push_back(node);
+ProgramPoint::Frame::Frame(const Frame* caller, const IR::Node* node) :
+        caller(caller), node(node), hash(caller ? caller->hash : 0) {
+    boost::hash_combine(hash, node);
 }
 
 bool ProgramPoint::operator==(const ProgramPoint& other) const {
-    if (stack.size() != other.stack.size())
-        return false;
-    for (unsigned i=0; i < stack.size(); i++)
-        if (stack.at(i) != other.stack.at(i))
+    auto a = top, b = other.top;
+    // Points are mostly built from a shared context, so the walk usually
+    // ends at a common frame.
+    while (a != b) {
+        if (a == nullptr || b == nullptr || a->hash != b->hash || a->node != b->node)
             return false;
+        a = a->caller;
+        b = b->caller;
+    }
     return true;
 }
 
-std::size_t ProgramPoint::hash() const {
-    std::size_t result = 0;
-    boost::hash_range(result, stack.begin(), stack.end());
-    return result;
+void ProgramPoint::dbprint(std::ostream& out) const {
+    if (isBeforeStart()) {
+        out << "<BeforeStart>";
+        return;
+    }
+    std::vector<const IR::Node*> stack;
+    for (auto f = top; f != nullptr; f = f->caller)
+        stack.push_back(f->node);
+    bool first = true;
+    for (auto it = stack.rbegin(); it != stack.rend(); ++it) {
+        if (!first)
+            out << "//";
+        out << dbp(*it);
+        first = false;
+    }
+    auto l = last();
+    if (l->is<IR::AssignmentStatement>() ||
+        l->is<IR::MethodCallStatement>())
+        out << "[[" << l << "]]";
 }
 
 bool ProgramPoints::operator==(const ProgramPoints& other) const {
@@ -280,58 +304,139 @@ bool ProgramPoints::operator==(const ProgramPoints& other) const {
     return true;
 }
 
-Definitions* Definitions::join(const Definitions* other) const {
-    auto result = new Definitions();
-    for (auto d : other->definitions) {
-        auto loc = d.first;
-        auto defs = d.second;
-        auto current = ::get(definitions, loc);
-        if (current != nullptr) {
-            auto merged = current->merge(defs);
-            result->definitions.emplace(loc, merged);
+size_t Definitions::span(unsigned level) {
+    size_t result = fanout;
+    for (unsigned l = 0; l < level; l++)
+        result *= fanout;
+    return result;
+}
+
+const Definitions::Node* Definitions::raise(const Node* node, unsigned level, unsigned to) {
+    if (node == nullptr)
+        return nullptr;
+    for (; level < to; level++) {
+        auto parent = new Node();
+        parent->entries[0] = node;
+        node = parent;
+    }
+    return node;
+}
+
+void Definitions::grow(size_t size) {
+    unsigned to = depth;
+    while (span(to) < size)
+        to++;
+    root = raise(root, depth, to);
+    depth = to;
+}
+
+const ProgramPoints* Definitions::get(unsigned id) const {
+    if (id >= span(depth))
+        return nullptr;
+    auto node = root;
+    for (unsigned level = depth; node != nullptr && level > 0; level--)
+        node = static_cast<const Node*>(node->entries[id / span(level - 1) % fanout]);
+    return node ? static_cast<const ProgramPoints*>(node->entries[id % fanout]) : nullptr;
+}
+
+const Definitions::Node* Definitions::update(const Node* node, unsigned level, size_t first,
+                                             const bitvec& ids, const ProgramPoints* points) {
+    if (node == nullptr && points == nullptr)
+        return nullptr;  // nothing to remove
+    auto result = node ? new Node(*node) : new Node();
+    size_t childSpan = span(level) / fanout;
+    size_t end = first + span(level);
+    for (int id = ids.ffs(first); id >= 0 && static_cast<size_t>(id) < end; ) {
+        size_t i = (id - first) / childSpan;
+        if (level == 0) {
+            result->entries[i] = points;
+            id = ids.ffs(id + 1);
         } else {
-            result->definitions.emplace(loc, defs);
+            auto child = static_cast<const Node*>(result->entries[i]);
+            result->entries[i] = update(child, level - 1, first + i * childSpan, ids, points);
+            id = ids.ffs(first + (i + 1) * childSpan);
         }
     }
-    for (auto d : definitions) {
-        auto loc = d.first;
-        auto defs = d.second;
-        auto current = ::get(other->definitions, loc);
-        if (current == nullptr)
-            result->definitions.emplace(loc, defs);
-        // otherwise have have already done it in the loop above
+    return result;
+}
+
+void Definitions::update(const bitvec& ids, const ProgramPoints* points) {
+    if (points != nullptr)
+        grow(ids.max().index() + 1);
+    root = update(root, depth, 0, ids, points);
+}
+
+const Definitions::Node* Definitions::join(const Node* node, const Node* other, unsigned level) {
+    if (other == nullptr || node == other)
+        return node;
+    if (node == nullptr)
+        return other;
+    auto result = new Node(*node);
+    for (unsigned i = 0; i < fanout; i++) {
+        auto &entry = result->entries[i];
+        auto oentry = other->entries[i];
+        if (oentry == nullptr || entry == oentry)
+            continue;
+        if (entry == nullptr)
+            entry = oentry;
+        else if (level == 0)
+            entry = static_cast<const ProgramPoints*>(entry)->merge(
+                static_cast<const ProgramPoints*>(oentry));
+        else
+            entry = join(static_cast<const Node*>(entry), static_cast<const Node*>(oentry),
+                         level - 1);
     }
     return result;
 }
 
+Definitions* Definitions::join(const Definitions* other) const {
+    auto result = new Definitions(*this);
+    if (other->factory != nullptr)
+        result->setFactory(other->factory);
+    result->grow(span(other->depth));
+    auto oroot = raise(other->root, other->depth, result->depth);
+    result->root = join(result->root, oroot, result->depth);
+    return result;
+}
+
 void Definitions::set(const StorageLocation* location, const ProgramPoints* point) {
-    LocationSet locset;
-    locset.addCanonical(location);
-    for (auto sl : locset)
-        definitions[sl->to<BaseLocation>()] = point;
+    CHECK_NULL(point);
+    setFactory(location->factory);
+    update(location->getBases(), point);
 }
 
 void Definitions::set(const LocationSet* locations, const ProgramPoints* point) {
-    for (auto sl : *locations->canonicalize())
-        definitions[sl->to<BaseLocation>()] = point;
+    CHECK_NULL(point);
+    for (auto sl : *locations)
+        setFactory(sl->factory);
+    update(locations->getBases(), point);
 }
 
-void Definitions::remove(const StorageLocation* location) {
-    auto loc = new LocationSet();
-    loc->addCanonical(location);
-    for (auto sl : *loc) {
-        auto bl = sl->to<BaseLocation>();
-        auto it = definitions.find(bl);
-        if (it != definitions.end())
-            definitions.erase(it);
+void Definitions::remove(const StorageLocation* location)
+{ update(location->getBases(), nullptr); }
+
+bool Definitions::empty(const Node* node, unsigned level) {
+    if (node == nullptr)
+        return true;
+    for (auto entry : node->entries) {
+        if (entry == nullptr)
+            continue;
+        if (level == 0 || !empty(static_cast<const Node*>(entry), level - 1))
+            return false;
     }
+    return true;
 }
 
+bool Definitions::empty() const
+{ return empty(root, depth); }
+
 const ProgramPoints* Definitions::get(const LocationSet* locations) const {
-    const ProgramPoints* result = new ProgramPoints();
-    for (auto sl : *locations->canonicalize()) {
-        auto points = get(sl->to<BaseLocation>());
-        result = result->merge(points);
+    auto result = new ProgramPoints();
+    for (unsigned id : locations->getBases()) {
+        auto points = get(id);
+        BUG_CHECK(points != nullptr, "%1%: no definitions", locations);
+        for (auto p : *points)
+            result->add(p);
     }
     return result;
 }
@@ -340,25 +445,68 @@ Definitions* Definitions::writes(ProgramPoint point, const LocationSet* location
     auto result = new Definitions(*this);
     auto points = new ProgramPoints();
     points->add(point);
-    auto canon = locations->canonicalize();
-    for (auto l : *canon)
-        result->set(l->to<BaseLocation>(), points);
+    result->set(locations, points);
     return result;
 }
 
-bool Definitions::operator==(const Definitions& other) const {
-    if (definitions.size() != other.definitions.size())
-        return false;
-    for (auto d : definitions) {
-        auto od = ::get(other.definitions, d.first);
-        if (od == nullptr)
-            return false;
-        if (!d.second->operator==(*od))
+bool Definitions::equal(const Node* node, const Node* other, unsigned level) {
+    if (node == other)
+        return true;
+    if (node == nullptr)
+        return empty(other, level);
+    if (other == nullptr)
+        return empty(node, level);
+    for (unsigned i = 0; i < fanout; i++) {
+        auto entry = node->entries[i], oentry = other->entries[i];
+        if (entry == oentry)
+            continue;
+        if (level > 0) {
+            if (!equal(static_cast<const Node*>(entry), static_cast<const Node*>(oentry),
+                       level - 1))
+                return false;
+        } else if (entry == nullptr || oentry == nullptr ||
+                   !static_cast<const ProgramPoints*>(entry)->operator==(
+                       *static_cast<const ProgramPoints*>(oentry))) {
             return false;
+        }
     }
     return true;
 }
 
+bool Definitions::operator==(const Definitions& other) const {
+    auto level = std::max(depth, other.depth);
+    return equal(raise(root, depth, level), raise(other.root, other.depth, level), level);
+}
+
+void Definitions::print(std::ostream& out, const Node* node, unsigned level, size_t first,
+                        bool& firstOutput) const {
+    if (node == nullptr)
+        return;
+    size_t childSpan = span(level) / fanout;
+    for (unsigned i = 0; i < fanout; i++) {
+        auto entry = node->entries[i];
+        if (entry == nullptr)
+            continue;
+        if (level > 0) {
+            print(out, static_cast<const Node*>(entry), level - 1, first + i * childSpan,
+                  firstOutput);
+            continue;
+        }
+        if (!firstOutput)
+            out << std::endl;
+        out << "  " << *factory->getBase(first + i) << "=>"
+            << *static_cast<const ProgramPoints*>(entry);
+        firstOutput = false;
+    }
+}
+
+void Definitions::dbprint(std::ostream& out) const {
+    if (empty())
+        out << "  Empty definitions";
+    bool first = true;
+    print(out, root, depth, 0, first);
+}
+
 //////////////////////////////////////////////////////////////////////////////////////////////
 // ComputeWriteSet implementation
 
@@ -17,7 +17,9 @@ limitations under the License.
 #ifndef _FRONTENDS_P4_DEF_USE_H_
 #define _FRONTENDS_P4_DEF_USE_H_
 
+#include <array>
 #include "ir/ir.h"
+#include "lib/bitvec.h"
 #include "frontends/p4/typeChecking/typeChecker.h"
 
 namespace P4 {
@@ -27,12 +29,27 @@ class LocationSet;
 
 /// Abstraction for something that is has a left value (variable, parameter)
 class StorageLocation : public IHasDbPrint {
+ protected:
+    /// Ids of the BaseLocations this location consists of.
+    bitvec bases;
+
  public:
     virtual ~StorageLocation() {}
     const IR::Type* type;
+    /// The location this one is a field or element of; nullptr for a declaration.
+    const StorageLocation* parent;
+    /// Declaration or field name; nullptr for an array element.
     const cstring name;
-    StorageLocation(const IR::Type* type, cstring name) : type(type), name(name)
-    { CHECK_NULL(type); }
+    /// Index of an array element in its parent.
+    const unsigned index;
+    const StorageFactory* factory;  /// Which created this location.
+    StorageLocation(const IR::Type* type, const StorageLocation* parent, cstring name,
+                    unsigned index, const StorageFactory* factory) :
+            type(type), parent(parent), name(name), index(index), factory(factory)
+    { CHECK_NULL(type); CHECK_NULL(factory); }
+    /// The canonical representation of this location, as a set of
+    /// BaseLocation ids.
+    const bitvec& getBases() const { return bases; }
     template <class T>
     const T* to() const {
         auto result = dynamic_cast<const T*>(this);
@@ -44,10 +61,13 @@ class StorageLocation : public IHasDbPrint {
         auto result = dynamic_cast<const T*>(this);
         return result != nullptr;
     }
+    /// Prints the full name of this location, e.g. "h.s[2].f".
+    void printName(std::ostream& out) const;
     virtual void dbprint(std::ostream& out) const {
-        out << name;
+        printName(out);
     }
-    cstring toString() const { return name; }
+    /// Builds the full name; intended for diagnostics only.
+    cstring toString() const;
 
     /// @returns All locations inside that represent valid bits.
     const LocationSet* getValidBits() const;
@@ -64,11 +84,15 @@ class StorageLocation : public IHasDbPrint {
     It could be either a scalar variable, or a field of a struct, etc. */
 class BaseLocation : public StorageLocation {
  public:
+    /// Dense id, unique among the locations created by the same factory.
+    const unsigned id;
     // We can use this for tuples because tuples have no field accessors,
     // so we treat them as monolithic objects.
-    BaseLocation(const IR::Type* type, cstring name) :
-            StorageLocation(type, name)
-    { BUG_CHECK(type->is<IR::Type_Bits>() || type->is<IR::Type_Enum>() ||
+    BaseLocation(const IR::Type* type, const StorageLocation* parent, cstring name,
+                 unsigned index, const StorageFactory* factory, unsigned id) :
+            StorageLocation(type, parent, name, index, factory), id(id)
+    { bases.setbit(id);
+      BUG_CHECK(type->is<IR::Type_Bits>() || type->is<IR::Type_Enum>() ||
                 type->is<IR::Type_Boolean>() || type->is<IR::Type_Var>() ||
                 type->is<IR::Type_Tuple>() || type->is<IR::Type_Error>() ||
                 type->is<IR::Type_Varbits>(),
@@ -84,13 +108,17 @@ class StructLocation : public StorageLocation {
     friend class StorageFactory;
 
     void addField(cstring name, StorageLocation* field)
-    { fieldLocations.emplace(name, field); CHECK_NULL(field); }
-    void replaceField(cstring field, StorageLocation* replacement)
-    { fieldLocations[field] = replacement; }
+    { CHECK_NULL(field); fieldLocations.emplace(name, field); bases |= field->getBases(); }
+    void replaceField(cstring field, StorageLocation* replacement) {
+        fieldLocations[field] = replacement;
+        bases.clear();
+        for (auto f : fieldLocations)
+            bases |= f.second->getBases(); }
 
  public:
-    StructLocation(const IR::Type* type, cstring name) :
-            StorageLocation(type, name) {
+    StructLocation(const IR::Type* type, const StorageLocation* parent, cstring name,
+                   unsigned index, const StorageFactory* factory) :
+            StorageLocation(type, parent, name, index, factory) {
         BUG_CHECK(type->is<IR::Type_StructLike>(),
                   "%1%: unexpected type", type);
     }
@@ -115,11 +143,12 @@ class ArrayLocation : public StorageLocation {
     friend class StorageFactory;
 
     void addElement(unsigned index, StorageLocation* element)
-    { elements[index] = element; CHECK_NULL(element); }
+    { CHECK_NULL(element); elements[index] = element; bases |= element->getBases(); }
 
  public:
-    ArrayLocation(const IR::Type* type, cstring name) :
-            StorageLocation(type, name), lastIndexField(nullptr) {
+    ArrayLocation(const IR::Type* type, const StorageLocation* parent, cstring name,
+                  unsigned index, const StorageFactory* factory) :
+            StorageLocation(type, parent, name, index, factory), lastIndexField(nullptr) {
         BUG_CHECK(type->is<IR::Type_Stack>(), "%1%: unexpected type", type);
         auto stack = type->to<IR::Type_Stack>();
         elements.resize(stack->getSize());
@@ -144,24 +173,35 @@ class ArrayLocation : public StorageLocation {
 
 class StorageFactory {
     TypeMap* typeMap;
+    /// All base locations created, indexed by id.
+    std::vector<const BaseLocation*> baseLocations;
+    /// Locations only record their parent and their own field name or
+    /// index, so building them allocates no strings.
+    StorageLocation* create(const IR::Type* type, const StorageLocation* parent,
+                            cstring name, unsigned index);
  public:
     explicit StorageFactory(TypeMap* typeMap) : typeMap(typeMap)
     { CHECK_NULL(typeMap); }
-    StorageLocation* create(const IR::Type* type, cstring name) const;
+    StorageLocation* create(const IR::Type* type, cstring name)
+    { return create(type, nullptr, name, 0); }
+    const BaseLocation* getBase(unsigned id) const { return baseLocations.at(id); }
 
     static const cstring validFieldName;
     static const cstring indexFieldName;
+    /// Field of each header in a union holding the valid bit shared by the union.
+    static const cstring unionValidFieldName;
 };
 
 /// A set of locations that may be read or written by a computation.
 /// In general this is a conservative approximation of the actual location set.
 class LocationSet : public IHasDbPrint {
     std::set<const StorageLocation*> locations;
+    /// The union of the bases of all locations; the canonical form of this set.
+    bitvec bases;
 
  public:
     LocationSet() = default;
-    explicit LocationSet(const std::set<const StorageLocation*> &other) : locations(other) {}
-    explicit LocationSet(const StorageLocation* location) { locations.emplace(location); }
+    explicit LocationSet(const StorageLocation* location) { add(location); }
     static const LocationSet* empty;
 
     const LocationSet* getField(cstring field) const;
@@ -171,12 +211,14 @@ class LocationSet : public IHasDbPrint {
     const LocationSet* getArrayLastIndex() const;
 
     void add(const StorageLocation* location)
-    { locations.emplace(location); }
+    { locations.emplace(location); bases |= location->getBases(); }
     const LocationSet* join(const LocationSet* other) const;
     /// @returns this location set expressed only in terms of BaseLocation;
     /// e.g., a StructLocation is expanded in all its fields.
     const LocationSet* canonicalize() const;
     void addCanonical(const StorageLocation* location);
+    /// Ids of all BaseLocations in the canonical form of this set.
+    const bitvec& getBases() const { return bases; }
     std::set<const StorageLocation*>::const_iterator begin() const { return locations.cbegin(); }
     std::set<const StorageLocation*>::const_iterator end()   const { return locations.cend(); }
     virtual void dbprint(std::ostream& out) const {
@@ -187,8 +229,8 @@ class LocationSet : public IHasDbPrint {
             out << " ";
         }
     }
-    // only defined for canonical representations
-    bool overlaps(const LocationSet* other) const;
+    /// True if the canonical forms of the two sets intersect.
+    bool overlaps(const LocationSet* other) const { return bases.intersects(other->bases); }
     bool isEmpty() const { return locations.empty(); }
 };
 
@@ -229,38 +271,30 @@ class StorageMap {
 class ProgramPoint : public IHasDbPrint {
     /// The stack is for representing calls for context-sensitive analyses: i.e.,
     /// table.apply() -> table -> action.
-    /// The empty stack represents "beforeStart" (see below).
-    std::vector<const IR::Node*> stack;
+    /// It is a list linked from the innermost frame, so that all points in the
+    /// same context share it, and copying a point copies a single pointer.
+    struct Frame {
+        const Frame*    caller;
+        const IR::Node* node;
+        std::size_t     hash;
+        Frame(const Frame* caller, const IR::Node* node);
+    };
+    /// The empty stack (nullptr) represents "beforeStart" (see below).
+    const Frame* top = nullptr;
 
  public:
     ProgramPoint() = default;
-    ProgramPoint(const ProgramPoint& other) : stack(other.stack) {}
-    explicit ProgramPoint(const IR::Node* node) { stack.push_back(node); }
-    ProgramPoint(const ProgramPoint& context, const IR::Node* node);
+    explicit ProgramPoint(const IR::Node* node) : top(new Frame(nullptr, node)) {}
+    ProgramPoint(const ProgramPoint& context, const IR::Node* node)
+            : top(new Frame(context.top, node)) {}
     static ProgramPoint beforeStart;  /// A point logically before the program start.
     bool operator==(const ProgramPoint& other) const;
-    std::size_t hash() const;
-    void dbprint(std::ostream& out) const {
-        if (isBeforeStart()) {
-            out << "<BeforeStart>";
-        } else {
-            bool first = true;
-            for (auto n : stack) {
-                if (!first)
-                    out << "//";
-                out << dbp(n);
-                first = false;
-            }
-            auto l = stack.back();
-            if (l->is<IR::AssignmentStatement>() ||
-                l->is<IR::MethodCallStatement>())
-                out << "[[" << l << "]]";
-        }
-    }
+    std::size_t hash() const { return top ? top->hash : 0; }
+    void dbprint(std::ostream& out) const;
     const IR::Node* last() const
-    { return stack.empty() ? nullptr : stack.back(); }
+    { return top ? top->node : nullptr; }
     bool isBeforeStart() const
-    { return stack.empty(); }
+    { return top == nullptr; }
 };
 }  // namespace P4
 
@@ -302,41 +336,73 @@ class ProgramPoints : public IHasDbPrint {
 };
 
 /// List of definers for each base storage (at a specific program point).
+///
+/// A new Definitions is made for nearly every statement, and usually
+/// differs from the previous one only in the few locations the statement
+/// writes.  The table is therefore a persistent trie indexed by
+/// BaseLocation::id, whose nodes are never modified once built: a copy
+/// shares the root, an update copies only the nodes on the paths to the
+/// ids it changes, and join and comparison skip shared subtrees.
 class Definitions : public IHasDbPrint {
-    /// Set of program points that have written last to each location
-    /// (conservative approximation).
-    std::map<const BaseLocation*, const ProgramPoints*> definitions;
+    static constexpr unsigned fanout = 32;
+    /// In leaves the entries are the sets of program points that have
+    /// written last to each location (conservative approximation), indexed
+    /// by BaseLocation::id % fanout; in the other nodes they are the
+    /// children.  Entries without definitions are nullptr.
+    struct Node {
+        std::array<const void*, fanout> entries = {};
+    };
+    /// nullptr if there are no definitions.
+    const Node* root = nullptr;
+    /// Number of levels above the leaves; the trie holds the ids below
+    /// fanout ^ (depth + 1).
+    unsigned depth = 0;
+    /// Factory of the locations, to find them by id.
+    const StorageFactory* factory = nullptr;
+
+    const ProgramPoints* get(unsigned id) const;
+    /// Sets the entries of all ids to points, which may be nullptr.
+    void update(const bitvec& ids, const ProgramPoints* points);
+    /// Adds levels above the root until the trie holds the ids below @size.
+    void grow(size_t size);
+    /// Number of ids held by a node @level levels above the leaves.
+    static size_t span(unsigned level);
+    /// @returns @node, @level levels above the leaves, as the first child of
+    /// new nodes up to level @to.
+    static const Node* raise(const Node* node, unsigned level, unsigned to);
+    /// @returns a copy of @node, whose first id is @first, with the entries of
+    /// the ids in @ids set to @points.
+    static const Node* update(const Node* node, unsigned level, size_t first,
+                              const bitvec& ids, const ProgramPoints* points);
+    static const Node* join(const Node* node, const Node* other, unsigned level);
+    static bool equal(const Node* node, const Node* other, unsigned level);
+    static bool empty(const Node* node, unsigned level);
+    void print(std::ostream& out, const Node* node, unsigned level, size_t first,
+               bool& firstOutput) const;
+    void setFactory(const StorageFactory* f) {
+        BUG_CHECK(factory == nullptr || factory == f, "Locations from different factories");
+        factory = f; }
 
  public:
     Definitions() = default;
-    Definitions(const Definitions& other) : definitions(other.definitions) {}
+    Definitions(const Definitions& other) = default;
     Definitions* join(const Definitions* other) const;
     /// Point writes the specified LocationSet.
     Definitions* writes(ProgramPoint point, const LocationSet* locations) const;
     void set(const BaseLocation* loc, const ProgramPoints* point)
-    { CHECK_NULL(loc); CHECK_NULL(point); definitions[loc] = point; }
+    { CHECK_NULL(loc); CHECK_NULL(point); setFactory(loc->factory); update(loc->getBases(), point); }
     void set(const StorageLocation* loc, const ProgramPoints* point);
     void set(const LocationSet* loc, const ProgramPoints* point);
     const ProgramPoints* get(const BaseLocation* location) const {
-        auto r = ::get(definitions, location);
+        auto r = get(location->id);
         BUG_CHECK(r != nullptr, "%1%: no definitions", location);
         return r; }
     const ProgramPoints* get(const LocationSet* locations) const;
     bool operator==(const Definitions& other) const;
-    void dbprint(std::ostream& out) const {
-        if (definitions.empty())
-            out << "  Empty definitions";
-        bool first = true;
-        for (auto d : definitions) {
-            if (!first)
-                out << std::endl;
-            out << "  " << *d.first << "=>" << *d.second;
-            first = false;
-        }
-    }
+    void dbprint(std::ostream& out) const;
     Definitions* clone() const { return new Definitions(*this); }
     void remove(const StorageLocation* loc);
-    bool empty() const { return definitions.empty(); }
+    bool empty() const;
 };
 
 class AllDefinitions : public IHasDbPrint {
@@ -152,7 +152,9 @@ class Converter : public PassManager {
 
  public:
     Converter();
-    void loadModel() { structure.loadModel(); }
+    void loadModel(bool builtinPreprocessor = false) {
+        structure.builtinPreprocessor = builtinPreprocessor;
+        structure.loadModel(); }
     Visitor::profile_t init_apply(const IR::Node* node) override;
 };
 
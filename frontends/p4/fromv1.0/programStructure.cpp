@@ -494,6 +494,7 @@ void ProgramStructure::include(cstring filename, cstring ppoptions) {
         options.preprocessor_options += " ";
         options.preprocessor_options += ppoptions; }
     options.langVersion = CompilerOptions::FrontendVersion::P4_16;
+    options.builtinPreprocessor = builtinPreprocessor;
     options.file = path.toString();
     if (FILE* file = options.preprocess()) {
         if (!::errorCount()) {
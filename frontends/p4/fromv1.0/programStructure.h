@@ -250,6 +250,8 @@ class ProgramStructure {
     /// Represents 'latest' P4-14 construct.
     const IR::Expression* latest;
     const int defaultRegisterWidth = 32;
+    /// Preprocess included P4-16 files in the compiler instead of with cpp.
+    bool builtinPreprocessor = false;
 
     void loadModel();
     void createExterns();
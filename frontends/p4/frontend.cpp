@@ -14,14 +14,20 @@ See the License for the specific language governing permissions and
 limitations under the License.
 */
 
+#include <unistd.h>
+#include <cstdio>
 #include <iostream>
 #include <fstream>
+#include <sstream>
 
 #include "ir/ir.h"
+#include "ir/binary_generator.h"
+#include "ir/binary_loader.h"
 #include "../common/options.h"
 #include "lib/nullstream.h"
 #include "lib/path.h"
 #include "frontend.h"
+#include "frontends/common/parseInput.h"
 
 #include "frontends/p4/typeMap.h"
 #include "frontends/p4/typeChecking/bindVariables.h"
@@ -98,16 +104,43 @@ class FrontEndDump : public PassManager {
     FrontEndDump() { setName("FrontEndDump"); }
 };
 
+/// The snapshot is written under a temporary name and then renamed, so that
+/// compilations sharing a front end cache never read a partial file.
+/// Front end cache entries start with their key.
+static void writeSnapshot(cstring file, const IR::P4Program* program,
+                          const std::string* key = nullptr) {
+    cstring temp = file + ".tmp" + Util::toString(getpid());
+    std::ofstream out(temp, std::ios::binary);
+    BinaryGenerator gen(out);
+    if (key != nullptr)
+        gen.write_bytes(*key);
+    gen << *Util::InputSources::instance << program;
+    out.close();
+    if (!out || rename(temp, file) != 0) {
+        ::warning("%1%: cannot write IR snapshot", file);
+        unlink(temp);
+    }
+}
+
 // TODO: remove skipSideEffectOrdering flag
 const IR::P4Program *FrontEnd::run(const CompilerOptions &options, const IR::P4Program* program,
                                    bool skipSideEffectOrdering) {
     if (program == nullptr)
         return nullptr;
+    // A program loaded from a snapshot has already been through the front end.
+    if (options.loadBinaryFile)
+        return program;
 
     bool isv1 = options.isv1();
     ReferenceMap  refMap;
     TypeMap       typeMap;
     refMap.setIsV1(isv1);
+    refMap.setIncremental(options.incrementalMaps);
+    typeMap.setIncremental(options.incrementalMaps);
+    // Start from the references and types of the standard include files,
+    // when they were computed before the program was parsed.
+    if (options.incrementalMaps && seedIncludeMaps(program, refMap, typeMap))
+        LOG1("Front end maps seeded with the standard include files");
 
     PassManager passes = {
         new PrettyPrint(options),
@@ -126,6 +159,7 @@ const IR::P4Program *FrontEnd::run(const CompilerOptions &options, const IR::P4P
         // explicit casts where implicit casts exist.
         new ResolveReferences(&refMap),  // check shadowing
         new Deprecated(&refMap),
+        new ClearTypeMap(&typeMap),  // keeps the types seeded, if any
         new TypeInference(&refMap, &typeMap, false),  // insert casts
         new BindTypeVariables(&typeMap),
         // Another round of constant folding, using type information.
@@ -158,6 +192,25 @@ const IR::P4Program *FrontEnd::run(const CompilerOptions &options, const IR::P4P
     passes.setStopOnError(true);
     passes.addDebugHooks(hooks);
     const IR::P4Program* result = program->apply(passes);
+    if (result != nullptr && ::errorCount() == 0) {
+        if (options.dumpBinaryFile)
+            writeSnapshot(options.dumpBinaryFile, result);
+        // A cache hit would not report the warnings, so a program with
+        // warnings is not cached.
+        if (options.frontendCacheFile && !skipSideEffectOrdering &&
+            ErrorReporter::instance.getWarningCount() == 0)
+            writeSnapshot(options.frontendCacheFile, result, &options.frontendCacheKey);
+        if (auto *arena = Arena::current()) {
+            // Copy the program to fresh chunks; everything the passes left
+            // behind in the old ones is reclaimed once nothing refers to it.
+            std::stringstream snapshot;
+            BinaryGenerator(snapshot) << result;
+            LOG1("Compacting IR arena of " << arena->size() << " bytes");
+            arena->reset();
+            std::string data = snapshot.str();
+            BinaryLoader(data.data(), data.size()) >> result;
+        }
+    }
     return result;
 }
 
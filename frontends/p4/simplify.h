@@ -67,7 +67,8 @@ class SimplifyControlFlow : public PassRepeated {
  public:
     SimplifyControlFlow(ReferenceMap* refMap, TypeMap* typeMap) {
         passes.push_back(new TypeChecking(refMap, typeMap));
-        passes.push_back(new DoSimplifyControlFlow(refMap, typeMap));
+        passes.push_back(new ApplyToDeclarations([refMap, typeMap]() {
+            return new DoSimplifyControlFlow(refMap, typeMap); }));
         setName("SimplifyControlFlow");
     }
 };
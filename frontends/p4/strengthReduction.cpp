@@ -51,7 +51,7 @@ int StrengthReduction::isPowerOf2(const IR::Expression* expr) const {
     auto cst = expr->to<IR::Constant>();
     if (cst == nullptr)
         return -1;
-    mpz_class value = cst->value;
+    const mpz_class& value = cst->value;
     if (sgn(value) <= 0)
         return -1;
     auto bitcnt = mpz_popcount(value.get_mpz_t());
@@ -60,7 +60,8 @@ class StrengthReduction final : public Transform {
     int isPowerOf2(const IR::Expression* expr) const;
 
  public:
-    StrengthReduction() { visitDagOnce = true; setName("StrengthReduction"); }
+    StrengthReduction() {
+        visitDagOnce = true; cloneOnlyOnChange = true; setName("StrengthReduction"); }
 
     using Transform::postorder;
 
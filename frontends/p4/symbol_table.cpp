@@ -14,6 +14,7 @@ See the License for the specific language governing permissions and
 limitations under the License.
 */
 
+#include <algorithm>
 #include <sstream>
 
 #include "symbol_table.h"
@@ -103,6 +104,8 @@ class Namespace : public NamedSymbol {
     void clear() {
         contents.clear();
     }
+    const std::unordered_map<cstring, NamedSymbol*>& getContents() const { return contents; }
+    bool getAllowDuplicates() const { return allowDuplicates; }
 };
 
 class Object : public NamedSymbol {
@@ -236,6 +239,35 @@ void ProgramStructure::endParse() {
               "Namespace stack is not empty at the end of parsing");
 }
 
+std::vector<ProgramStructure::Symbol> ProgramStructure::topLevelSymbols() const {
+    std::vector<Symbol> result;
+    for (auto& entry : rootNamespace->getContents()) {
+        auto symbol = entry.second;
+        auto ct = dynamic_cast<ContainerType*>(symbol);
+        bool isObject = dynamic_cast<Object*>(symbol) != nullptr;
+        result.push_back({ symbol->getName(), symbol->getSourceInfo(),
+                           isObject ? SymbolKind::Identifier : SymbolKind::Type,
+                           ct != nullptr, ct != nullptr && ct->getAllowDuplicates() });
+    }
+    std::sort(result.begin(), result.end(),
+              [](const Symbol& a, const Symbol& b) { return a.name < b.name; });
+    return result;
+}
+
+void ProgramStructure::declareTopLevel(const std::vector<Symbol>& symbols) {
+    BUG_CHECK(currentNamespace == rootNamespace, "Declaring top level symbols in a namespace");
+    for (auto& s : symbols) {
+        if (s.container) {
+            push(new ContainerType(s.name, s.srcInfo, s.allowDuplicates));
+            pop();
+        } else if (s.kind == SymbolKind::Type) {
+            declareType(IR::ID(s.srcInfo, s.name));
+        } else {
+            declareObject(IR::ID(s.srcInfo, s.name));
+        }
+    }
+}
+
 cstring ProgramStructure::toString() const {
     std::stringstream res;
     rootNamespace->dump(res, 0);
@@ -58,6 +58,15 @@ class ProgramStructure final {
         Type
     };
 
+    /// A symbol declared at the top level; see topLevelSymbols.
+    struct Symbol {
+        cstring name;
+        SourceInfo srcInfo;
+        SymbolKind kind;
+        bool container;         // a type which is also a namespace
+        bool allowDuplicates;   // for containers
+    };
+
     ProgramStructure();
 
     void setDebug(bool debug) { this->debug = debug; }
@@ -77,6 +86,12 @@ class ProgramStructure final {
 
     void endParse();
 
+    /// The symbols declared at the top level so far, sorted by name.
+    std::vector<Symbol> topLevelSymbols() const;
+    /// Declare symbols returned by topLevelSymbols, as if their
+    /// declarations had been parsed; must be called at the top level.
+    void declareTopLevel(const std::vector<Symbol>& symbols);
+
     cstring toString() const;
     void clear();
 };
@@ -115,10 +115,19 @@ Visitor::profile_t TypeInference::init_apply(const IR::Node* node) {
         LOG2("TypeInference for " << dbp(node));
     }
     initialNode = node;
+    retained.clear();
     refMap->validateMap(node);
     return Transform::init_apply(node);
 }
 
+const IR::Node* TypeInference::apply_visitor(const IR::Node* node, const char* name) {
+    if (node != nullptr && retained.count(node)) {
+        LOG3("Visiting " << dbp(node) << " retained");
+        return node;
+    }
+    return Transform::apply_visitor(node, name);
+}
+
 void TypeInference::end_apply(const IR::Node* node) {
     if (readOnly && !(*node == *initialNode)) {
         ToP4 top4(&std::cout, true, nullptr);
@@ -553,6 +562,11 @@ const IR::Node* TypeInference::preorder(IR::P4Program* program) {
     if (typeMap->checkMap(getOriginal()) && readOnly) {
         LOG2("No need to typecheck");
         prune();
+        return program;
+    }
+    for (auto decl : program->declarations) {
+        if (typeMap->isRetained(getOriginal(), decl))
+            retained.emplace(decl);
     }
     return program;
 }
@@ -957,8 +971,18 @@ TypeInference::containerInstantiation(
     return std::pair<const IR::Type*, const IR::Vector<IR::Expression>*>(returnType, newArgs);
 }
 
+const IR::Node* TypeInference::preorder(IR::P4Action* action) {
+    if (typeMap->isIncremental())
+        return pruneIfDone(action);
+    return action;
+}
+
 const IR::Node* TypeInference::preorder(IR::Function* function) {
-    if (done()) return function;
+    if (done()) {
+        if (typeMap->isIncremental())
+            prune();
+        return function;
+    }
     visit(function->type);
     auto type = getTypeType(function->type);
     if (type == nullptr)
@@ -39,8 +39,9 @@ class ClearTypeMap : public Inspector {
             typeMap(typeMap) { CHECK_NULL(typeMap); setName("ClearTypeMap"); }
     bool preorder(const IR::P4Program* program) override {
         // Clear map only if program has not changed from last time
-        // otherwise we can reuse it
-        if (!typeMap->checkMap(program))
+        // otherwise we can reuse it; in incremental mode keep the
+        // entries for the declarations that have not changed.
+        if (!typeMap->checkMap(program) && !typeMap->retainUnchanged(program))
             typeMap->clear();
         return false;  // prune()
     }
@@ -74,6 +75,9 @@ class TypeInference : public Transform {
     // They are used in type resolution.
     std::vector<int> methodArguments;
     const IR::Node* initialNode;
+    // Top-level declarations whose types are already in the typeMap;
+    // only populated when the typeMap is updated incrementally.
+    std::set<const IR::Node*> retained;
 
  public:
     // If readOnly=true it will assert that it behaves like
@@ -172,6 +176,8 @@ class TypeInference : public Transform {
     // before the returns
     const IR::Node* preorder(IR::Function* function) override;
     const IR::Node* preorder(IR::P4Program* program) override;
+    // In incremental mode actions that were already type-checked are skipped.
+    const IR::Node* preorder(IR::P4Action* action) override;
     const IR::Node* preorder(IR::Declaration_Instance* decl) override;
     // check invariants for entire list before checking the entries
     const IR::Node* preorder(IR::EntriesList* el) override;
@@ -261,6 +267,7 @@ class TypeInference : public Transform {
 
     Visitor::profile_t init_apply(const IR::Node* node) override;
     void end_apply(const IR::Node* Node) override;
+    const IR::Node* apply_visitor(const IR::Node* node, const char* name = 0) override;
 };
 
 // Copy types from the typeMap to expressions.  Updates the typeMap with newly created nodes
@@ -15,19 +15,79 @@ limitations under the License.
 */
 
 #include "typeMap.h"
+
+#include <algorithm>
+#include <typeinfo>
+
 #include "lib/map.h"
 
 namespace P4 {
 
+namespace {
+// The maps are unordered; print them sorted by node id,
+// so that the output does not depend on addresses.
+bool byId(const IR::Node* left, const IR::Node* right)
+{ return left->id < right->id; }
+
+std::vector<const IR::Expression*>
+sorted(const std::unordered_set<const IR::Expression*>& expressions) {
+    std::vector<const IR::Expression*> result(expressions.begin(), expressions.end());
+    std::sort(result.begin(), result.end(), byId);
+    return result;
+}
+
+size_t combine(size_t seed, size_t value)
+{ return seed ^ (value + 0x9e3779b9 + (seed << 6) + (seed >> 2)); }
+
+// Collects all nodes reachable from the visited ones; the types
+// of the collected nodes are queued to be visited as well.
+// Does not descend into replaced declarations or their replacements.
+class CollectNodes : public Inspector {
+    const std::unordered_map<const IR::Node*, const IR::Type*>& types;
+    const std::map<const IR::Node*, const IR::Node*>& replaced;
+    const std::set<const IR::Node*>& replacements;
+    std::unordered_set<const IR::Node*>& nodes;
+    std::vector<const IR::Node*>& work;
+
+ public:
+    // Set if a replaced declaration is reachable.
+    bool stale = false;
+
+    CollectNodes(const std::unordered_map<const IR::Node*, const IR::Type*>& types,
+                 const std::map<const IR::Node*, const IR::Node*>& replaced,
+                 const std::set<const IR::Node*>& replacements,
+                 std::unordered_set<const IR::Node*>& nodes,
+                 std::vector<const IR::Node*>& work) :
+            types(types), replaced(replaced), replacements(replacements),
+            nodes(nodes), work(work) { setName("CollectNodes"); }
+    bool preorder(const IR::Node* node) override {
+        if (replaced.count(node)) {
+            stale = true;
+            return false;
+        }
+        if (replacements.count(node) || !nodes.insert(node).second)
+            return false;
+        auto it = types.find(node);
+        if (it != types.end() && !nodes.count(it->second))
+            work.push_back(it->second);
+        return true;
+    }
+};
+}  // namespace
+
 void TypeMap::dbprint(std::ostream& out) const {
     out << "TypeMap for " << dbp(program) << std::endl;
+    std::vector<const IR::Node*> nodes;
     for (auto it : typeMap)
-        out << "\t" << dbp(it.first) << "->" << dbp(it.second) << std::endl;
+        nodes.push_back(it.first);
+    std::sort(nodes.begin(), nodes.end(), byId);
+    for (auto it : nodes)
+        out << "\t" << dbp(it) << "->" << dbp(typeMap.at(it)) << std::endl;
     out << "Left values" << std::endl;
-    for (auto it : leftValues)
+    for (auto it : sorted(leftValues))
         out << "\t" << dbp(it) << std::endl;
     out << "Constants" << std::endl;
-    for (auto it : constants)
+    for (auto it : sorted(constants))
         out << "\t" << dbp(it) << std::endl;
     out << "--------------" << std::endl;
 }
@@ -51,9 +111,79 @@ bool TypeMap::isCompileTimeConstant(const IR::Expression* expression) const {
 void TypeMap::clear() {
     LOG3("Clearing typeMap");
     typeMap.clear(); leftValues.clear(); constants.clear(); allTypeVariables.clear();
+    retained.clear();
+    retainedFor = nullptr;
     program = nullptr;
 }
 
+bool TypeMap::retainUnchanged(const IR::Node* node) {
+    std::set<const IR::Node*> unchanged;
+    std::map<const IR::Node*, const IR::Node*> replaced;
+    retained.clear();
+    retainedFor = nullptr;
+    if (!diffDeclarations(node, unchanged, replaced))
+        return false;
+
+    // Controls and parsers are their own types: make the types that
+    // refer to a replaced declaration refer to its replacement.
+    std::set<const IR::Node*> replacements;
+    std::map<const IR::Node*, const IR::Type*> typeTypes;
+    for (auto r : replaced)
+        replacements.emplace(r.second);
+    // In the order of the nodes, as the new Type_Type nodes get ids.
+    std::vector<const IR::Node*> nodes;
+    for (auto& e : typeMap)
+        nodes.push_back(e.first);
+    std::sort(nodes.begin(), nodes.end(), byId);
+    for (auto n : nodes) {
+        auto& t = typeMap.at(n);
+        auto it = replaced.find(t);
+        if (it != replaced.end()) {
+            t = it->second->to<IR::Type>();
+            continue;
+        }
+        auto tt = t->to<IR::Type_Type>();
+        if (tt == nullptr || !replaced.count(tt->type))
+            continue;
+        auto& type = typeTypes[tt->type];
+        if (type == nullptr)
+            type = new IR::Type_Type(replaced.at(tt->type)->to<IR::Type>());
+        t = type;
+    }
+
+    // Nodes may be shared between declarations, and types computed
+    // for one declaration may be used by others, so keep everything
+    // reachable from the unchanged declarations or from their types.
+    // The replaced declarations are recomputed from scratch.
+    std::unordered_set<const IR::Node*> reachable;
+    std::vector<const IR::Node*> work(unchanged.begin(), unchanged.end());
+    CollectNodes collect(typeMap, replaced, replacements, reachable, work);
+    while (!work.empty()) {
+        auto n = work.back();
+        work.pop_back();
+        if (!reachable.count(n))
+            n->apply(collect);
+    }
+    if (collect.stale)
+        return false;
+
+    for (auto it = typeMap.begin(); it != typeMap.end(); ) {
+        if (reachable.count(it->first)) {
+            ++it;
+            continue;
+        }
+        if (auto expr = it->first->to<IR::Expression>()) {
+            leftValues.erase(expr);
+            constants.erase(expr);
+        }
+        it = typeMap.erase(it);
+    }
+    LOG2("TypeMap retained " << typeMap.size() << " entries");
+    retained.swap(unchanged);
+    retainedFor = node;
+    return true;
+}
+
 void TypeMap::checkPrecondition(const IR::Node* element, const IR::Type* type) const {
     CHECK_NULL(element); CHECK_NULL(type);
     if (type->is<IR::Type_Name>())
@@ -65,7 +195,7 @@ void TypeMap::setType(const IR::Node* element, const IR::Type* type) {
     auto it = typeMap.find(element);
     if (it != typeMap.end()) {
         const IR::Type* existingType = it->second;
-        if (!TypeMap::equivalent(existingType, type))
+        if (existingType != type && !TypeMap::equivalent(existingType, type))
             BUG("Changing type of %1% in type map from %2% to %3%",
                 dbp(element), dbp(existingType), dbp(type));
         return;
@@ -256,24 +386,55 @@ bool TypeMap::equivalent(const IR::Type* left, const IR::Type* right) {
     // Type_Dontcare, Type_Unknown, Type_Name, Type_Specialized, Type_Typedef
 }
 
+// Consistent with equivalent(): it only looks at the properties which
+// equivalent() compares, and not always at all of them.
+size_t TypeMap::hash(const IR::Type* type) {
+    if (type == nullptr)
+        return 0;
+    size_t result = typeid(*type).hash_code();
+    if (auto tb = type->to<IR::Type_Bits>())
+        return combine(combine(result, tb->size), tb->isSigned);
+    if (auto tt = type->to<IR::Type_Type>())
+        return combine(result, hash(tt->type));
+    if (auto tv = type->to<IR::ITypeVar>())
+        return combine(combine(result, tv->getVarName().hash()), tv->getDeclId());
+    if (auto ts = type->to<IR::Type_Stack>())
+        // Not the size: it may not be known, and stacks with
+        // an unknown size must still be compared to report it.
+        return combine(result, hash(ts->elementType));
+    if (auto te = type->to<IR::Type_Enum>())
+        return combine(result, te->name.name.hash());
+    if (auto te = type->to<IR::Type_Extern>())
+        return combine(result, te->name.name.hash());
+    if (auto st = type->to<IR::Type_StructLike>()) {
+        // Field types are not hashed, as structs may be large and nested.
+        for (auto f : st->fields)
+            result = combine(result, f->name.name.hash());
+        return result;
+    }
+    if (auto tt = type->to<IR::Type_Tuple>()) {
+        for (auto c : tt->components)
+            result = combine(result, hash(c));
+        return result;
+    }
+    if (auto ts = type->to<IR::Type_Set>())
+        return combine(result, hash(ts->elementType));
+    return result;
+}
+
 // Used for tuples and stacks only
 const IR::Type* TypeMap::getCanonical(const IR::Type* type) {
-    // Currently a linear search; hopefully this won't be too expensive in practice
-    std::vector<const IR::Type*>* searchIn;
-    if (type->is<IR::Type_Stack>())
-        searchIn = &canonicalStacks;
-    else if (type->is<IR::Type_Tuple>())
-        searchIn = &canonicalTuples;
-    else
+    if (!type->is<IR::Type_Stack>() && !type->is<IR::Type_Tuple>())
         BUG("%1%: unexpected type", type);
 
-    for (auto t : *searchIn) {
-        if (TypeMap::equivalent(type, t))
-            return t;
+    size_t key = hash(type);
+    auto range = canonicalTypes.equal_range(key);
+    for (auto it = range.first; it != range.second; ++it) {
+        if (it->second == type || TypeMap::equivalent(type, it->second))
+            return it->second;
     }
-    searchIn->push_back(type);
+    canonicalTypes.emplace(key, type);
     return type;
 }
 
-
 }  // namespace P4
@@ -17,6 +17,10 @@ limitations under the License.
 #ifndef _FRONTENDS_P4_TYPEMAP_H_
 #define _FRONTENDS_P4_TYPEMAP_H_
 
+#include <set>
+#include <unordered_map>
+#include <unordered_set>
+
 #include "ir/ir.h"
 #include "frontends/common/programMap.h"
 #include "frontends/p4/substitution.h"
@@ -41,20 +45,25 @@ class TypeMap final : public ProgramMap {
  protected:
     // We want to have the same canonical type for two
     // different tuples or stacks with the same signature.
-    std::vector<const IR::Type*> canonicalTuples;
-    std::vector<const IR::Type*> canonicalStacks;
+    // Indexed by structural hash, so only the types in the
+    // same bucket are compared for equivalence.
+    std::unordered_multimap<size_t, const IR::Type*> canonicalTypes;
 
     // Map each node to its canonical type
-    std::map<const IR::Node*, const IR::Type*> typeMap;
+    std::unordered_map<const IR::Node*, const IR::Type*> typeMap;
     // All left-values in the program.
-    std::set<const IR::Expression*> leftValues;
+    std::unordered_set<const IR::Expression*> leftValues;
     // All compile-time constants.  A compile-time constant
     // is not necessarily a constant - it could be a directionless
     // parameter as well.
-    std::set<const IR::Expression*> constants;
+    std::unordered_set<const IR::Expression*> constants;
     // For each type variable in the program the actual
     // type that is substituted for it.
     TypeVariableSubstitution allTypeVariables;
+    // In incremental mode, the top-level declarations of `retainedFor`
+    // whose types are all still in the map.
+    std::set<const IR::Node*> retained;
+    const IR::Node* retainedFor = nullptr;
 
     // checks some preconditions before setting the type
     void checkPrecondition(const IR::Node* element, const IR::Type* type) const;
@@ -69,6 +78,15 @@ class TypeMap final : public ProgramMap {
     const IR::Type* getTypeType(const IR::Node* element, bool notNull) const;
     void dbprint(std::ostream& out) const;
     void clear();
+    // Prepare the map to be updated incrementally for @p node.  Keeps the
+    // types of all nodes reachable from the top-level declarations shared
+    // with the previous program, and drops the ones that only belong to
+    // replaced declarations.  Returns false if the whole map has to be
+    // recomputed.
+    bool retainUnchanged(const IR::Node* node);
+    // True if @p declaration of @p program was retained by retainUnchanged.
+    bool isRetained(const IR::Node* program, const IR::Node* declaration) const
+    { return program == retainedFor && retained.count(declaration) != 0; }
     bool isLeftValue(const IR::Expression* expression) const
     { return leftValues.count(expression) > 0; }
     bool isCompileTimeConstant(const IR::Expression* expression) const;
@@ -83,6 +101,8 @@ class TypeMap final : public ProgramMap {
 
     /// Check deep structural equivalence; defined between canonical types only.
     static bool equivalent(const IR::Type* left, const IR::Type* right);
+    /// Hash of a canonical type; equivalent types have the same hash.
+    static size_t hash(const IR::Type* type);
 
     // Used for tuples and stacks only
     const IR::Type* getCanonical(const IR::Type* type);
@@ -112,28 +112,58 @@ P4ParserDriver::P4ParserDriver()
   , declarations(new IR::IndexedVector<IR::Node>())
 { }
 
-/* static */ const IR::P4Program*
-P4ParserDriver::parse(const char* name, std::istream& in) {
+bool P4ParserDriver::run(const char* name, std::istream& in) {
     if (Log::verbose())
         std::cout << "Parsing P4-16 program " << name << std::endl;
 
     // Create and configure the parser and lexer.
-    P4ParserDriver driver;
     P4Lexer lexer(in);
-    P4Parser parser(driver, lexer);
+    P4Parser parser(*this, lexer);
 
 #ifdef YYDEBUG
     if (const char *p = getenv("YYDEBUG"))
         parser.set_debug_level(atoi(p));
-    driver.structure->setDebug(parser.debug_level() != 0);
+    structure->setDebug(parser.debug_level() != 0);
 #endif
 
     // Parse.
-    if (parser.parse() != 0) return nullptr;
-    driver.structure->endParse();
+    if (parser.parse() != 0) return false;
+    structure->endParse();
+    return true;
+}
+
+void P4ParserDriver::startAfter(const ParsedDeclarations& prefix) {
+    structure->declareTopLevel(prefix.symbols);
+    for (auto decl : *prefix.declarations) {
+        if (auto error = decl->to<IR::Type_Error>()) {
+            // Later error declarations are merged into this one, which is
+            // shared with other parses.
+            allErrors = error->clone();
+            decl = allErrors;
+        }
+        declarations->push_back(decl);
+    }
+}
+
+/* static */ const IR::P4Program*
+P4ParserDriver::parse(const char* name, std::istream& in, const ParsedDeclarations* prefix) {
+    P4ParserDriver driver;
+    if (prefix != nullptr)
+        driver.startAfter(*prefix);
+    if (!driver.run(name, in)) return nullptr;
     return new IR::P4Program(driver.declarations->srcInfo, *driver.declarations);
 }
 
+/* static */ const ParsedDeclarations*
+P4ParserDriver::parseDeclarations(const char* name, std::istream& in) {
+    P4ParserDriver driver;
+    if (!driver.run(name, in)) return nullptr;
+    auto result = new ParsedDeclarations;
+    result->declarations = driver.declarations;
+    result->symbols = driver.structure->topLevelSymbols();
+    return result;
+}
+
 /* static */ const IR::P4Program*
 P4ParserDriver::parse(const char* name, FILE* in) {
     AutoStdioInputStream inputStream(in);
@@ -20,6 +20,7 @@ limitations under the License.
 #include <cstdio>
 #include <iostream>
 #include <string>
+#include <vector>
 
 #include "frontends/p4/symbol_table.h"
 #include "ir/ir.h"
@@ -78,6 +79,13 @@ class AbstractParserDriver {
     cstring lastIdentifier;
 };
 
+/// What parsing a sequence of complete top level P4-16 declarations
+/// produced: enough to parse the declarations that follow them separately.
+struct ParsedDeclarations {
+    const IR::IndexedVector<IR::Node>* declarations = nullptr;
+    std::vector<Util::ProgramStructure::Symbol> symbols;
+};
+
 /// A ParserDriver that can parse P4-16 programs.
 class P4ParserDriver final : public AbstractParserDriver {
  public:
@@ -87,11 +95,19 @@ class P4ParserDriver final : public AbstractParserDriver {
      * @param name  The name of the program; usually the source filename. This
      *              is only used for logging.
      * @param in    The input source to read the program from.
+     * @param prefix  If not null, the declarations at the start of the
+     *                program, which @in continues.
      * @returns a P4Program object if parsing was successful, or null otherwise.
      */
-    static const IR::P4Program* parse(const char* name, std::istream& in);
+    static const IR::P4Program* parse(const char* name, std::istream& in,
+                                      const ParsedDeclarations* prefix = nullptr);
     static const IR::P4Program* parse(const char* name, FILE* in);
 
+    /// Parse the declarations at the start of a P4-16 program, so that the
+    /// rest of it can be parsed later by passing them to parse.
+    /// @returns null if parsing failed.
+    static const ParsedDeclarations* parseDeclarations(const char* name, std::istream& in);
+
  protected:
     friend class P4::P4Lexer;
     friend class P4::P4Parser;
@@ -131,6 +147,11 @@ class P4ParserDriver final : public AbstractParserDriver {
  private:
     P4ParserDriver();
 
+    /// Continue the program after the declarations in @prefix.
+    void startAfter(const ParsedDeclarations& prefix);
+    /// Parse the input into @declarations; @returns false on failure.
+    bool run(const char* name, std::istream& in);
+
     /// All P4 `error` declarations are merged together in the node, which is
     /// lazily created the first time we see an `error` declaration. (This node
     /// is present in @declarations as well.)
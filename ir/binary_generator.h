@@ -0,0 +1,231 @@
+/*
+Copyright 2013-present Barefoot Networks, Inc.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#ifndef _IR_BINARY_GENERATOR_H_
+#define _IR_BINARY_GENERATOR_H_
+
+#include <boost/optional.hpp>
+#include <gmpxx.h>
+#include <map>
+#include <sstream>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include "lib/cstring.h"
+#include "lib/ltbitmatrix.h"
+#include "lib/match.h"
+#include "lib/ordered_map.h"
+#include "lib/safe_vector.h"
+
+#include "ir.h"
+
+/**
+ * Writes IR trees in a compact binary format which can be read back with
+ * BinaryLoader.  Unlike JSON there are no field names: every class writes its
+ * fields in declaration order, and reads them back in the same order.
+ *
+ * Integers are written as LEB128 varints (signed ones zigzag-encoded).
+ * Strings and nodes are written in full the first time they are seen and are
+ * afterwards referred to by index, so each distinct string (including node
+ * type names) is stored once, and nodes shared in the DAG stay shared.
+ */
+class BinaryGenerator {
+ public:
+    /// First bytes of every snapshot; the last byte is the format version.
+    static const char *magic() { return "P4IRBIN\003"; }
+    static constexpr size_t magic_size = 8;
+
+    /// Reference tags for strings and nodes.  Any other value v refers to
+    /// the (v - FIRST_INDEX)th string or node seen so far.
+    enum ref_tag_t { NULL_REF = 0, NEW_REF = 1, FIRST_INDEX = 2 };
+
+ private:
+    std::ostream &out;
+    std::unordered_map<cstring, uintmax_t> strings;
+    std::unordered_map<const IR::Node *, uintmax_t> node_refs;
+
+    template<typename T>
+    class has_toBinary {
+        typedef char small;
+        typedef struct { char c[2]; } big;
+
+        template<typename C> static small test(decltype(&C::toBinary));
+        template<typename C> static big test(...);
+     public:
+        static const bool value = sizeof(test<T>(0)) == sizeof(char);
+    };
+
+ public:
+    explicit BinaryGenerator(std::ostream &out) : out(out) {
+        out.write(magic(), magic_size); }
+
+    void write_uint(uintmax_t v) {
+        while (v >= 0x80) {
+            out.put(static_cast<char>(v | 0x80));
+            v >>= 7; }
+        out.put(static_cast<char>(v)); }
+    void write_int(intmax_t v) {
+        uintmax_t sign = v < 0 ? ~uintmax_t(0) : 0;
+        write_uint((static_cast<uintmax_t>(v) << 1) ^ sign); }
+    /// Bytes which are not interned like strings; read back with
+    /// BinaryLoader::match_bytes.
+    void write_bytes(const std::string &v) {
+        write_uint(v.size());
+        out.write(v.data(), v.size()); }
+
+    template<typename T>
+    void generate(const safe_vector<T> &v) {
+        write_uint(v.size());
+        for (auto &el : v) generate(el); }
+
+    template<typename T>
+    void generate(const std::vector<T> &v) {
+        write_uint(v.size());
+        for (auto &el : v) generate(el); }
+
+    template<typename T, typename U>
+    void generate(const std::pair<T, U> &v) {
+        generate(v.first);
+        generate(v.second); }
+
+    template<typename T>
+    void generate(const boost::optional<T> &v) {
+        generate(static_cast<bool>(v));
+        if (v) generate(*v); }
+
+    template<typename K, typename V, typename COMP, typename ALLOC>
+    void generate(const ordered_map<K, V, COMP, ALLOC> &v) {
+        write_uint(v.size());
+        for (auto &el : v) generate(el); }
+    template<typename K, typename V, typename COMP, typename ALLOC>
+    void generate(const std::map<K, V, COMP, ALLOC> &v) {
+        write_uint(v.size());
+        for (auto &el : v) generate(el); }
+    template<typename K, typename V, typename COMP, typename ALLOC>
+    void generate(const std::multimap<K, V, COMP, ALLOC> &v) {
+        write_uint(v.size());
+        for (auto &el : v) generate(el); }
+
+    void generate(bool v) { out.put(v ? 1 : 0); }
+    template<typename T>
+    typename std::enable_if<std::is_integral<T>::value && std::is_signed<T>::value>::type
+    generate(T v) { write_int(v); }
+    template<typename T>
+    typename std::enable_if<std::is_integral<T>::value && !std::is_signed<T>::value>::type
+    generate(T v) { write_uint(v); }
+    void generate(double v) { out.write(reinterpret_cast<const char *>(&v), sizeof(v)); }
+    void generate(const mpz_class &v) {
+        // magnitude as big-endian bytes, sign in the low bit of the length
+        size_t count = 0;
+        void *bytes = mpz_export(nullptr, &count, 1, 1, 1, 0, v.get_mpz_t());
+        write_uint(count << 1 | (sgn(v) < 0));
+        out.write(static_cast<const char *>(bytes), count);
+        void (*freefn)(void *, size_t);
+        mp_get_memory_functions(nullptr, nullptr, &freefn);
+        if (bytes) freefn(bytes, count); }
+
+    void generate(cstring v) {
+        if (!v) {
+            write_uint(NULL_REF);
+            return; }
+        auto it = strings.find(v);
+        if (it != strings.end()) {
+            write_uint(it->second + FIRST_INDEX);
+            return; }
+        strings.emplace(v, strings.size());
+        write_uint(NEW_REF);
+        write_uint(v.size());
+        out.write(v.c_str(), v.size()); }
+    void generate(const IR::ID &v) {
+        generate(v.srcInfo);
+        generate(v.name);
+        generate(v.originalName); }
+    void generate(const Util::SourceInfo &v) {
+        write_uint(v.getStart().getLineNumber());
+        if (!v.isValid()) return;
+        write_uint(v.getStart().getColumnNumber());
+        write_uint(v.getEnd().getLineNumber());
+        write_uint(v.getEnd().getColumnNumber()); }
+    /// Positions in SourceInfo refer to the InputSources, so a snapshot that
+    /// is to produce the same messages as the original includes them.
+    void generate(const Util::InputSources &v) {
+        // the line index is rebuilt from the newlines when loading
+        write_uint(v.contents.size());
+        out.write(v.contents.data(), v.contents.size());
+        write_uint(v.line_file_map.size());
+        for (auto &l : v.line_file_map) {
+            write_uint(l.first);
+            generate(l.second.fileName);
+            write_uint(l.second.sourceLine); } }
+
+    template<typename T>
+    typename std::enable_if<std::is_enum<T>::value>::type
+    generate(T v) { write_int(static_cast<intmax_t>(v)); }
+    void generate(const LTBitMatrix &v) {
+        std::stringstream tmp;
+        tmp << v;
+        generate(cstring(tmp)); }
+    void generate(const match_t &v) {
+        write_uint(v.word0);
+        write_uint(v.word1); }
+
+    template<typename T>
+    typename std::enable_if<
+                    has_toBinary<T>::value &&
+                    !std::is_base_of<IR::INode, T>::value>::type
+    generate(const T &v) { v.toBinary(*this); }
+
+    template<typename T>
+    typename std::enable_if<
+                    std::is_base_of<IR::INode, T>::value &&
+                    !std::is_base_of<IR::Node, T>::value>::type
+    generate(const T &v) { generate(*v.getNode()); }
+
+    void generate(const IR::Node &v) {
+        auto it = node_refs.find(&v);
+        if (it != node_refs.end()) {
+            write_uint(it->second + FIRST_INDEX);
+            return; }
+        write_uint(NEW_REF);
+        generate(v.node_type_name());
+        v.toBinary(*this);
+        // Numbered once complete, which is also when the loader has the
+        // pointer; the IR is acyclic, so no reference can come earlier.
+        node_refs.emplace(&v, node_refs.size()); }
+
+    template<typename T>
+    typename std::enable_if<
+                    std::is_pointer<T>::value &&
+                    has_toBinary<typename std::remove_pointer<T>::type>::value>::type
+    generate(T v) {
+        if (!v) {
+            write_uint(NULL_REF);
+        } else {
+            // nodes write their own reference tag
+            if (!std::is_base_of<IR::INode, typename std::remove_pointer<T>::type>::value)
+                write_uint(NEW_REF);
+            generate(*v); } }
+
+    template<typename T, size_t N>
+    void generate(const T (&v)[N]) {
+        for (size_t i = 0; i < N; i++)
+            generate(v[i]); }
+
+    template<typename T> BinaryGenerator &operator<<(const T &v) { generate(v); return *this; }
+};
+
+#endif /* _IR_BINARY_GENERATOR_H_ */
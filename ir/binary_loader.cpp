@@ -0,0 +1,159 @@
+/*
+Copyright 2013-present Barefoot Networks, Inc.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include "binary_loader.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+BinaryLoader::BinaryLoader(const char *data, size_t size)
+: source("(memory)"), pos(reinterpret_cast<const unsigned char *>(data)), end(pos + size) {
+    start();
+}
+
+BinaryLoader::BinaryLoader(cstring file) : source(file), pos(nullptr), end(nullptr) {
+    int fd = open(file, O_RDONLY);
+    if (fd < 0)
+        throw Util::CompilationError("%1%: cannot open IR snapshot", file);
+    struct stat st;
+    if (fstat(fd, &st) == 0 && st.st_size > 0) {
+        mapping_size = st.st_size;
+        mapping = mmap(nullptr, mapping_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (mapping == MAP_FAILED)
+            mapping = nullptr;
+        else
+            madvise(mapping, mapping_size, MADV_SEQUENTIAL); }
+    close(fd);
+    if (!mapping)
+        throw Util::CompilationError("%1%: cannot read IR snapshot", file);
+    pos = static_cast<const unsigned char *>(mapping);
+    end = pos + mapping_size;
+    start();
+}
+
+BinaryLoader::~BinaryLoader() {
+    // Everything loaded was copied out (strings interned, nodes allocated),
+    // so the mapping is no longer needed.
+    if (mapping)
+        munmap(mapping, mapping_size);
+}
+
+void BinaryLoader::start() {
+    need(BinaryGenerator::magic_size);
+    if (memcmp(pos, BinaryGenerator::magic(), BinaryGenerator::magic_size) != 0)
+        throw Util::CompilationError("%1%: not an IR snapshot, or written by an "
+                                     "incompatible compiler", source);
+    pos += BinaryGenerator::magic_size;
+}
+
+void BinaryLoader::corrupt() const {
+    throw Util::CompilationError("%1%: IR snapshot is corrupt or truncated", source);
+}
+
+uintmax_t BinaryLoader::read_uint() {
+    uintmax_t v = 0;
+    for (unsigned shift = 0; shift < sizeof(v) * 8; shift += 7) {
+        need(1);
+        unsigned char byte = *pos++;
+        v |= uintmax_t(byte & 0x7f) << shift;
+        if (!(byte & 0x80))
+            return v; }
+    corrupt();
+}
+
+size_t BinaryLoader::read_string_index() {
+    auto tag = read_tag();
+    if (tag == BinaryGenerator::NULL_REF)
+        return NO_STRING;
+    if (tag == BinaryGenerator::NEW_REF) {
+        auto length = read_uint();
+        need(length);
+        strings.emplace_back(reinterpret_cast<const char *>(pos), length);
+        factories.push_back(nullptr);
+        pos += length;
+        return strings.size() - 1; }
+    tag -= BinaryGenerator::FIRST_INDEX;
+    if (tag >= strings.size())
+        corrupt();
+    return tag;
+}
+
+const IR::Node *BinaryLoader::get_node(BinaryNodeFactoryFn fallback) {
+    auto tag = read_tag();
+    if (tag == BinaryGenerator::NULL_REF)
+        return nullptr;
+    if (tag != BinaryGenerator::NEW_REF) {
+        tag -= BinaryGenerator::FIRST_INDEX;
+        if (tag >= nodes.size())
+            corrupt();
+        return nodes[tag]; }
+    // The type name is nearly always a back-reference, so after the first
+    // node of each type this is a vector index rather than a map lookup.
+    auto type = read_string_index();
+    if (type == NO_STRING)
+        corrupt();
+    auto factory = factories[type];
+    if (!factory) {
+        auto it = IR::binary_unpacker_table.find(strings[type]);
+        factory = it != IR::binary_unpacker_table.end() ? it->second : fallback;
+        if (!factory)
+            throw Util::CompilationError("%1%: unknown IR node type %2% in snapshot",
+                                         source, strings[type]);
+        factories[type] = factory; }
+    auto *node = factory(*this);
+    nodes.push_back(node);
+    return node;
+}
+
+void BinaryLoader::unpack(Util::SourceInfo &v) {
+    unsigned line = read_uint();
+    if (line == 0) {
+        v = Util::SourceInfo();
+        return; }
+    unsigned column = read_uint();
+    unsigned endLine = read_uint();
+    unsigned endColumn = read_uint();
+    v = Util::SourceInfo(Util::SourcePosition(line, column),
+                         Util::SourcePosition(endLine, endColumn));
+}
+
+void BinaryLoader::unpack(Util::InputSources &v) {
+    auto length = read_count();
+    v.contents.assign(reinterpret_cast<const char *>(pos), length);
+    pos += length;
+    v.lineStarts.assign(1, 0);
+    for (size_t i = 0; i < length; ++i)
+        if (v.contents[i] == '\n')
+            v.lineStarts.push_back(i + 1);
+    v.line_file_map.clear();
+    for (auto count = read_count(); count > 0; --count) {
+        unsigned line = read_uint();
+        cstring file = read_string();
+        unsigned sourceLine = read_uint();
+        v.line_file_map.emplace(line, Util::SourceFileLine(file, sourceLine)); }
+}
+
+void BinaryLoader::unpack(mpz_class &v) {
+    auto header = read_uint();
+    size_t count = header >> 1;
+    need(count);
+    mpz_import(v.get_mpz_t(), count, 1, 1, 1, 0, pos);
+    if (header & 1)
+        v = -v;
+    pos += count;
+}
@@ -0,0 +1,261 @@
+/*
+Copyright 2013-present Barefoot Networks, Inc.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#ifndef _IR_BINARY_LOADER_H_
+#define _IR_BINARY_LOADER_H_
+
+#include <boost/optional.hpp>
+#include <gmpxx.h>
+#include <string.h>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+#include "lib/cstring.h"
+#include "lib/exceptions.h"
+#include "lib/ltbitmatrix.h"
+#include "lib/match.h"
+#include "lib/ordered_map.h"
+#include "lib/safe_vector.h"
+#include "ir.h"
+#include "binary_generator.h"
+
+/// Factory for node types that are not in IR::binary_unpacker_table.
+template<class T> IR::Node *binaryNodeFactory(BinaryLoader &bin) { return T::fromBinary(bin); }
+
+/**
+ * Reads IR written by BinaryGenerator.  The input is decoded directly from
+ * memory -- normally an mmap'd snapshot file -- without building any
+ * intermediate tree; strings are interned once each, the first time they
+ * occur.  A malformed or truncated input throws a CompilationError.
+ */
+class BinaryLoader {
+    template<typename T> class has_fromBinary {
+        typedef char small;
+        typedef struct { char c[2]; } big;
+
+        template<typename C> static small test(decltype(&C::fromBinary));
+        template<typename C> static big test(...);
+     public:
+        static const bool value = sizeof(test<T>(0)) == sizeof(char);
+    };
+
+    cstring                             source;
+    const unsigned char                 *pos, *end;
+    void                                *mapping = nullptr;
+    size_t                              mapping_size = 0;
+    std::vector<cstring>                strings;
+    std::vector<BinaryNodeFactoryFn>    factories;   // per string, when used as a type
+    std::vector<const IR::Node *>       nodes;
+
+    static constexpr size_t NO_STRING = ~size_t(0);
+    /// @return the index in strings of the next string, or NO_STRING for null
+    size_t read_string_index();
+    void start();
+    [[noreturn]] void corrupt() const;
+    void need(uintmax_t bytes) const { if (bytes > uintmax_t(end - pos)) corrupt(); }
+    uintmax_t read_tag() { return read_uint(); }
+    const IR::Node *get_node(BinaryNodeFactoryFn fallback = nullptr);
+    template<typename T> const T *get_node_as(BinaryNodeFactoryFn fallback = nullptr) {
+        auto *n = get_node(fallback);
+        if (!n) return nullptr;
+        if (auto *rv = n->to<T>()) return rv;
+        corrupt(); }
+    /// For nodes stored by value, which are never null.
+    template<typename T> const T &get_inline(BinaryNodeFactoryFn fallback = nullptr) {
+        if (auto *n = get_node_as<T>(fallback)) return *n;
+        corrupt(); }
+
+    template<typename T>
+    void unpack(safe_vector<T> &v) {
+        v.resize(read_count());
+        for (auto &el : v) unpack(el); }
+    template<typename T>
+    void unpack(std::vector<T> &v) {
+        v.resize(read_count());
+        for (auto &el : v) unpack(el); }
+
+    template<typename T> void unpack(IR::Vector<T> &v) {
+        v = get_inline<IR::Vector<T>>(binaryNodeFactory<IR::Vector<T>>); }
+    template<typename T> void unpack(const IR::Vector<T> *&v) {
+        v = get_node_as<IR::Vector<T>>(binaryNodeFactory<IR::Vector<T>>); }
+    template<typename T> void unpack(IR::IndexedVector<T> &v) {
+        v = get_inline<IR::IndexedVector<T>>(binaryNodeFactory<IR::IndexedVector<T>>); }
+    template<typename T> void unpack(const IR::IndexedVector<T> *&v) {
+        v = get_node_as<IR::IndexedVector<T>>(binaryNodeFactory<IR::IndexedVector<T>>); }
+    template<class T, template<class K, class V, class COMP, class ALLOC> class MAP,
+             class COMP, class ALLOC>
+    void unpack(IR::NameMap<T, MAP, COMP, ALLOC> &m) {
+        typedef IR::NameMap<T, MAP, COMP, ALLOC> map_t;
+        m = get_inline<map_t>(binaryNodeFactory<map_t>); }
+    template<class T, template<class K, class V, class COMP, class ALLOC> class MAP,
+             class COMP, class ALLOC>
+    void unpack(const IR::NameMap<T, MAP, COMP, ALLOC> *&m) {
+        typedef IR::NameMap<T, MAP, COMP, ALLOC> map_t;
+        m = get_node_as<map_t>(binaryNodeFactory<map_t>); }
+
+    template<typename MAP> void unpack_map(MAP &v) {
+        std::pair<typename MAP::key_type, typename MAP::mapped_type> temp;
+        for (auto count = read_count(); count > 0; --count) {
+            unpack(temp);
+            v.insert(temp); } }
+    template<typename K, typename V, typename COMP, typename ALLOC>
+    void unpack(std::map<K, V, COMP, ALLOC> &v) { unpack_map(v); }
+    template<typename K, typename V, typename COMP, typename ALLOC>
+    void unpack(ordered_map<K, V, COMP, ALLOC> &v) { unpack_map(v); }
+    template<typename K, typename V, typename COMP, typename ALLOC>
+    void unpack(std::multimap<K, V, COMP, ALLOC> &v) { unpack_map(v); }
+
+    template<typename T, typename U>
+    void unpack(std::pair<T, U> &v) {
+        unpack(v.first);
+        unpack(v.second); }
+
+    template<typename T>
+    void unpack(boost::optional<T> &v) {
+        bool isValid = false;
+        unpack(isValid);
+        if (!isValid) {
+            v = boost::none;
+            return; }
+        T value;
+        unpack(value);
+        v = std::move(value); }
+
+    void unpack(bool &v) { need(1); v = *pos++ != 0; }
+    template<typename T>
+    typename std::enable_if<std::is_integral<T>::value && std::is_signed<T>::value>::type
+    unpack(T &v) { v = read_int(); }
+    template<typename T>
+    typename std::enable_if<std::is_integral<T>::value && !std::is_signed<T>::value>::type
+    unpack(T &v) { v = read_uint(); }
+    void unpack(double &v) { need(sizeof(v)); memcpy(&v, pos, sizeof(v)); pos += sizeof(v); }
+    void unpack(mpz_class &v);
+    void unpack(cstring &v) { v = read_string(); }
+    void unpack(IR::ID &v) {
+        unpack(v.srcInfo);
+        v.name = read_string();
+        v.originalName = read_string(); }
+    void unpack(Util::SourceInfo &v);
+    void unpack(Util::InputSources &v);
+
+    void unpack(LTBitMatrix &m) {
+        if (auto s = read_string())
+            s.c_str() >> m; }
+
+    template<typename T> typename std::enable_if<std::is_enum<T>::value>::type
+    unpack(T &v) { v = static_cast<T>(read_int()); }
+
+    void unpack(match_t &v) {
+        v.word0 = read_uint();
+        v.word1 = read_uint(); }
+
+    template<typename T>
+    typename std::enable_if<
+        has_fromBinary<T>::value &&
+        !std::is_base_of<IR::Node, T>::value &&
+        std::is_pointer<decltype(T::fromBinary(std::declval<BinaryLoader&>()))>::value
+    >::type
+    unpack(T *&v) {
+        switch (read_tag()) {
+        case BinaryGenerator::NULL_REF: v = nullptr; break;
+        case BinaryGenerator::NEW_REF: v = T::fromBinary(*this); break;
+        default: corrupt(); } }
+
+    template<typename T>
+    typename std::enable_if<
+        has_fromBinary<T>::value &&
+        !std::is_base_of<IR::Node, T>::value &&
+        std::is_pointer<decltype(T::fromBinary(std::declval<BinaryLoader&>()))>::value
+    >::type
+    unpack(T &v) { v = *(T::fromBinary(*this)); }
+
+    template<typename T> typename std::enable_if<std::is_base_of<IR::INode, T>::value>::type
+    unpack(T &v) { v = get_inline<T>(); }
+    template<typename T> typename std::enable_if<std::is_base_of<IR::INode, T>::value>::type
+    unpack(const T *&v) { v = get_node_as<T>(); }
+
+    template<typename T, size_t N>
+    void unpack(T (&v)[N]) {
+        for (size_t i = 0; i < N; ++i)
+            unpack(v[i]); }
+
+ public:
+    /// Decode the size bytes at data, which must outlive the loader.
+    BinaryLoader(const char *data, size_t size);
+    /// Map the snapshot in file and decode it from there.
+    explicit BinaryLoader(cstring file);
+    BinaryLoader(const BinaryLoader &) = delete;
+    ~BinaryLoader();
+
+    uintmax_t read_uint();
+    intmax_t read_int() {
+        uintmax_t v = read_uint();
+        return static_cast<intmax_t>(v >> 1) ^ -static_cast<intmax_t>(v & 1); }
+    size_t read_count() {
+        // every element takes at least one byte, which bounds the count
+        uintmax_t count = read_uint();
+        need(count);
+        return count; }
+    cstring read_string() {
+        auto index = read_string_index();
+        return index == NO_STRING ? cstring() : strings[index]; }
+    /// Read bytes written by BinaryGenerator::write_bytes.
+    /// @returns true if they are the same as expected.
+    bool match_bytes(const std::string &expected) {
+        size_t length = read_count();
+        bool match = length == expected.size() && memcmp(pos, expected.data(), length) == 0;
+        pos += length;
+        return match; }
+    /// True when the whole input has been read.
+    bool done() const { return pos == end; }
+
+    template<typename T> BinaryLoader& operator>>(T &v) {
+        unpack(v);
+        return *this; }
+};
+
+template<class T>
+IR::Vector<T>::Vector(BinaryLoader &bin) : VectorBase(bin) {
+    bin >> vec;
+}
+template<class T>
+IR::Vector<T>* IR::Vector<T>::fromBinary(BinaryLoader &bin) {
+    return new Vector<T>(bin);
+}
+template<class T>
+IR::IndexedVector<T>::IndexedVector(BinaryLoader &bin) : Vector<T>(bin) {
+    // Only the elements are written; the name index is rebuilt from them.
+    for (auto el : *this) insertInMap(el);
+}
+template<class T>
+IR::IndexedVector<T>* IR::IndexedVector<T>::fromBinary(BinaryLoader &bin) {
+    return new IndexedVector<T>(bin);
+}
+template<class T, template<class K, class V, class COMP, class ALLOC> class MAP /*= std::map */,
+         class COMP /*= std::less<cstring>*/,
+         class ALLOC /*= std::allocator<std::pair<cstring, const T*>>*/>
+IR::NameMap<T, MAP, COMP, ALLOC>::NameMap(BinaryLoader &bin) : Node(bin) {
+    bin >> symbols;
+}
+template<class T, template<class K, class V, class COMP, class ALLOC> class MAP /*= std::map */,
+         class COMP /*= std::less<cstring>*/,
+         class ALLOC /*= std::allocator<std::pair<cstring, const T*>>*/>
+IR::NameMap<T, MAP, COMP, ALLOC> *IR::NameMap<T, MAP, COMP, ALLOC>::fromBinary(BinaryLoader &bin) {
+    return new IR::NameMap<T, MAP, COMP, ALLOC>(bin);
+}
+
+#endif /* _IR_BINARY_LOADER_H_ */
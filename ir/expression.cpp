@@ -14,6 +14,7 @@ See the License for the specific language governing permissions and
 limitations under the License.
 */
 
+#include <climits>
 #include "ir.h"
 #include "dbprint.h"
 #include "lib/gmputil.h"
@@ -53,6 +54,19 @@ IR::Constant::handleOverflow(bool noWarning) {
     }
 
     int width = tb->size;
+    // Fast path for the common case of a small value which fits.
+    if (width > 0 && width < static_cast<int>(sizeof(long) * CHAR_BIT) - 1 &&
+        value.fits_slong_p()) {
+        long v = value.get_si();
+        if (tb->isSigned) {
+            long max = (1L << (width - 1)) - 1;
+            if (v >= -max - 1 && v <= max)
+                return;
+        } else if (v >= 0 && (v >> width) == 0) {
+            return;
+        }
+    }
+
     mpz_class one = 1;
     mpz_class mask = Util::mask(width);
 
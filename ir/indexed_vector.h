@@ -27,6 +27,7 @@ limitations under the License.
 #include "id.h"
 
 class JSONLoader;
+class BinaryLoader;
 
 namespace IR {
 
@@ -103,6 +104,7 @@ class IndexedVector : public Vector<T> {
     explicit IndexedVector(const Vector<T> &a) {
         insert(typename Vector<T>::end(), a.begin(), a.end()); }
     explicit IndexedVector(JSONLoader &json);
+    explicit IndexedVector(BinaryLoader &bin);
 
     void clear() { IR::Vector<T>::clear(); declarations.clear(); }
     // Although this is not a const_iterator, it should NOT
@@ -171,6 +173,7 @@ class IndexedVector : public Vector<T> {
 
     void toJSON(JSONGenerator &json) const override;
     static IndexedVector<T>* fromJSON(JSONLoader &json);
+    static IndexedVector<T>* fromBinary(BinaryLoader &bin);
     void check_valid() const {
         for (auto el : *this) {
             auto it = declarations.find(el->getName());
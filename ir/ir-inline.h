@@ -46,22 +46,22 @@ template<class T> void IR::Vector<T>::visit_children(Visitor &v) {
             i = erase(i);
         } else if (n == *i) {
             i++;
-        } else if (auto l = dynamic_cast<const Vector *>(n)) {
+        } else if (auto l = n->to<Vector>()) {
             i = erase(i);
             i = insert(i, l->vec.begin(), l->vec.end());
             i += l->vec.size();
-        } else if (auto v = dynamic_cast<const VectorBase *>(n)) {
+        } else if (auto v = n->to<VectorBase>()) {
             if (v->empty()) {
                 i = erase(i);
             } else {
                 i = insert(i, v->size() - 1, nullptr);
                 for (auto el : *v) {
-                    if (auto e = dynamic_cast<const T *>(el))
+                    if (auto e = el->to<T>())
                         *i++ = e;
                     else
                         BUG("visitor returned invalid type %s for Vector<%s>",
                             e->node_type_name(), T::static_type_name()); } }
-        } else if (auto e = dynamic_cast<const T *>(n)) {
+        } else if (auto e = n->to<T>()) {
             *i++ = e;
         } else {
             BUG("visitor returned invalid type %s for Vector<%s>",
@@ -81,22 +81,22 @@ template<class T> void IR::Vector<T>::parallel_visit_children(Visitor &v) {
             i = erase(i);
         } else if (n == *i) {
             i++;
-        } else if (auto l = dynamic_cast<const Vector *>(n)) {
+        } else if (auto l = n->to<Vector>()) {
             i = erase(i);
             i = insert(i, l->vec.begin(), l->vec.end());
             i += l->vec.size();
-        } else if (auto v = dynamic_cast<const VectorBase *>(n)) {
+        } else if (auto v = n->to<VectorBase>()) {
             if (v->empty()) {
                 i = erase(i);
             } else {
                 i = insert(i, v->size() - 1, nullptr);
                 for (auto el : *v) {
-                    if (auto e = dynamic_cast<const T *>(el))
+                    if (auto e = el->to<T>())
                         *i++ = e;
                     else
                         BUG("visitor returned invalid type %s for Vector<%s>",
                             e->node_type_name(), T::static_type_name()); } }
-        } else if (auto e = dynamic_cast<const T *>(n)) {
+        } else if (auto e = n->to<T>()) {
             *i++ = e;
         } else {
             BUG("visitor returned invalid type %s for Vector<%s>",
@@ -124,6 +124,10 @@ template<class T> void IR::Vector<T>::toJSON(JSONGenerator &json) const {
     if (*sep) json << std::endl << json.indent;
     json << "]";
 }
+template<class T> void IR::Vector<T>::toBinary(BinaryGenerator &bin) const {
+    Node::toBinary(bin);
+    bin << vec;
+}
 
 std::ostream &operator<<(std::ostream &out, const IR::Vector<IR::Expression> &v);
 
@@ -134,11 +138,11 @@ template<class T> void IR::IndexedVector<T>::visit_children(Visitor &v) {
             i = erase(i);
         } else if (n == *i) {
             i++;
-        } else if (auto l = dynamic_cast<const Vector<T> *>(n)) {
+        } else if (auto l = n->to<Vector<T>>()) {
             i = erase(i);
             i = insert(i, l->begin(), l->end());
             i += l->Vector<T>::size();
-        } else if (auto e = dynamic_cast<const T *>(n)) {
+        } else if (auto e = n->to<T>()) {
             i = replace(i, e);
         } else {
             BUG("visitor returned invalid type %s for IndexedVector<%s>",
@@ -202,7 +206,7 @@ void IR::NameMap<T, MAP, COMP, ALLOC>::visit_children(Visitor &v) {
         } else if (auto m = dynamic_cast<const NameMap *>(n)) {
             namemap_insert_helper(i, m->symbols.begin(), m->symbols.end(), symbols, new_symbols);
             i = symbols.erase(i);
-        } else if (auto s = dynamic_cast<const T *>(n)) {
+        } else if (auto s = n->to<T>()) {
             if (match_name(i->first, s)) {
                 i->second = s;
                 i++;
@@ -233,6 +237,13 @@ void IR::NameMap<T, MAP, COMP, ALLOC>::toJSON(JSONGenerator &json) const {
     if (*sep) json << std::endl << json.indent;
     json << "}";
 }
+template<class T, template<class K, class V, class COMP, class ALLOC> class MAP /*= std::map */,
+         class COMP /*= std::less<cstring>*/,
+         class ALLOC /*= std::allocator<std::pair<cstring, const T*>>*/>
+void IR::NameMap<T, MAP, COMP, ALLOC>::toBinary(BinaryGenerator &bin) const {
+    Node::toBinary(bin);
+    bin << symbols;
+}
 
 template<class KEY, class VALUE,
          template<class K, class V, class COMP, class ALLOC> class MAP /*= std::map */,
@@ -49,6 +49,7 @@ limitations under the License.
 
 class JSONLoader;
 #include "json_generator.h"
+#include "binary_generator.h"
 
 #include "pass_manager.h"
 #include "ir-inline.h"
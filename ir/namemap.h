@@ -18,6 +18,7 @@ limitations under the License.
 #define _IR_NAMEMAP_H_
 
 class JSONLoader;
+class BinaryLoader;
 
 namespace IR {
 
@@ -39,6 +40,7 @@ class NameMap : public Node {
     NameMap(const NameMap &) = default;
     NameMap(NameMap &&) = default;
     explicit NameMap(JSONLoader &);
+    explicit NameMap(BinaryLoader &);
     NameMap &operator=(const NameMap &) = default;
     NameMap &operator=(NameMap &&) = default;
     typedef typename map_t::value_type          value_type;
@@ -82,7 +84,7 @@ class NameMap : public Node {
     const_iterator find(cstring name) const { return symbols.find(name); }
     template<class U> const U *get(cstring name) const {
         for (auto it = symbols.find(name); it != symbols.end() && it->first == name; it++)
-            if (auto rv = dynamic_cast<const U *>(it->second))
+            if (auto rv = it->second->template to<U>())
                 return rv;
         return nullptr; }
     void add(cstring name, const T *n) {
@@ -121,6 +123,8 @@ class NameMap : public Node {
     void visit_children(Visitor &v) const override;
     void toJSON(JSONGenerator &json) const override;
     static NameMap<T, MAP, COMP, ALLOC> *fromJSON(JSONLoader &json);
+    void toBinary(BinaryGenerator &bin) const override;
+    static NameMap<T, MAP, COMP, ALLOC> *fromBinary(BinaryLoader &bin);
 
     Util::Enumerator<const T*>* valueEnumerator() const {
         return Util::Enumerator<const T*>::createEnumerator(Values(symbols).begin(),
@@ -16,13 +16,18 @@ limitations under the License.
 
 #include "ir.h"
 #include "ir/json_loader.h"
+#include "ir/binary_loader.h"
 
 void IR::Node::traceVisit(const char* visitor) const
 { LOG3("Visiting " << visitor << " " << id << ":" << node_type_name()); }
 
 void IR::Node::traceCreation() const { LOG5("Created node " << id); }
 
+#ifdef MULTITHREAD
+std::atomic<int> IR::Node::currentId(0);
+#else
 int IR::Node::currentId = 0;
+#endif  // MULTITHREAD
 
 void IR::Node::toJSON(JSONGenerator &json) const {
     json << json.indent << "\"Node_ID\" : " << id << "," << std::endl
@@ -37,6 +42,18 @@ IR::Node::Node(JSONLoader &json) : id(-1) {
         currentId = id+1;
 }
 
+void IR::Node::toBinary(BinaryGenerator &bin) const {
+    bin << id << srcInfo;
+}
+
+IR::Node::Node(BinaryLoader &bin) : id(-1) {
+    bin >> id >> srcInfo;
+    if (id < 0)
+        id = currentId++;
+    else if (id >= currentId)
+        currentId = id+1;
+}
+
 // Abbreviated debug print
 cstring IR::dbp(const IR::INode* node) {
     std::stringstream str;
@@ -18,6 +18,11 @@ limitations under the License.
 #define _IR_NODE_H_
 
 #include <memory>
+#include <type_traits>
+#ifdef MULTITHREAD
+#include <atomic>
+#endif  // MULTITHREAD
+#include "lib/arena.h"
 #include "lib/cstring.h"
 #include "lib/stringify.h"
 #include "lib/indent.h"
@@ -32,11 +37,14 @@ class Modifier;
 class Transform;
 class JSONGenerator;
 class JSONLoader;
+class BinaryGenerator;
+class BinaryLoader;
 
 namespace IR {
 
 class Node;
 class Annotation;
+class VectorBase;
 
 template<class T> class Vector;
 template<class T> class IndexedVector;
@@ -49,6 +57,7 @@ class INode : public Util::IHasSourceInfo, public IHasDbPrint {
     virtual void dbprint(std::ostream &out) const = 0;  // for debugging
     virtual cstring toString() const = 0;  // for user consumption
     virtual void toJSON(JSONGenerator &) const = 0;
+    virtual void toBinary(BinaryGenerator &) const = 0;
     virtual cstring node_type_name() const = 0;
     virtual void validate() const {}
     virtual const Annotation *getAnnotation(cstring) const { return nullptr; }
@@ -70,7 +79,11 @@ class Node : public virtual INode {
     virtual void apply_visitor_revisit(Transform &v, const Node *n) const;
 
  protected:
+#ifdef MULTITHREAD
+    static std::atomic<int> currentId;
+#else
     static int currentId;
+#endif  // MULTITHREAD
     void traceVisit(const char* visitor) const;
     virtual void visit_children(Visitor &) { }
     virtual void visit_children(Visitor &) const { }
@@ -90,6 +103,9 @@ class Node : public virtual INode {
     explicit Node(Util::SourceInfo si) : srcInfo(si), id(currentId++) { traceCreation(); }
     Node(const Node& other) : srcInfo(other.srcInfo), id(currentId++) { traceCreation(); }
     virtual ~Node() {}
+    /// Nodes are allocated in the current Arena, if there is one.
+    static void *operator new(size_t size) { return Arena::alloc(size); }
+    static void operator delete(void *p) { Arena::release(p); }
     const Node *apply(Visitor &v) const;
     const Node *apply(Visitor &&v) const { return apply(v); }
     virtual Node *clone() const = 0;
@@ -100,13 +116,17 @@ class Node : public virtual INode {
     Util::SourceInfo getSourceInfo() const override { return srcInfo; }
     cstring node_type_name() const override { return "Node"; }
     static cstring static_type_name() { return "Node"; }
+    /// ID of the dynamic type of this node (see NodeTypeId); 0 if it has none.
+    virtual TypeId typeId() const { return 0; }
     virtual int num_children() { return 0; }
     template<typename T> bool is() const { return to<T>() != nullptr; }
-    template<typename T> const T *to() const { return dynamic_cast<const T*>(this); }
+    template<typename T> const T *to() const;
     template<typename T> const T &as() const { return dynamic_cast<const T&>(*this); }
     explicit Node(JSONLoader &json);
+    explicit Node(BinaryLoader &bin);
     cstring toString() const override { return node_type_name(); }
     void toJSON(JSONGenerator &json) const override;
+    void toBinary(BinaryGenerator &bin) const override;
     void sourceInfoToJSON(JSONGenerator &json) const;
     Util::JsonObject* sourceInfoJsonObj() const;
     virtual bool operator==(const Node &a) const { return typeid(*this) == typeid(a); }
@@ -118,6 +138,29 @@ class Node : public virtual INode {
     bool operator!=(const Node &n) const { return !operator==(n); }
 };
 
+/* Every class generated from the .def files has a type ID, NodeTypeId<T>::value,
+ * and typeIsA tells from a table built by the ir-generator whether one class
+ * derives from another, so when both the node and T have an ID, to<T> needs no
+ * dynamic_cast.  Other classes -- Node itself and the Vector and map templates --
+ * have ID 0 and are tested with dynamic_cast.  For this to be right, classes
+ * written by hand must not derive from generated ones. */
+namespace detail {
+template<typename T, bool = std::is_base_of<Node, T>::value> struct NodeCast {
+    static const T *cast(const Node *n) { return static_cast<const T *>(n); } };
+// interfaces are not bases of Node, so reaching them is a cross cast
+template<typename T> struct NodeCast<T, false> {
+    static const T *cast(const Node *n) { return dynamic_cast<const T *>(n); } };
+}  // namespace detail
+
+template<typename T> const T *Node::to() const {
+    TypeId id = typeId();
+    if (id != 0 && NodeTypeId<T>::value != 0)
+        return typeIsA(id, NodeTypeId<T>::value) ? detail::NodeCast<T>::cast(this) : nullptr;
+    if (id != 0 && std::is_base_of<VectorBase, T>::value)
+        return nullptr;  // generated classes are never vectors
+    return dynamic_cast<const T *>(this);
+}
+
 // simple version of dbprint
 cstring dbp(const INode* node);
 
@@ -143,6 +186,7 @@ inline bool equal(const INode *a, const INode *b) {
 #define IRNODE_COMMON_SUBCLASS(T)                                           \
  public:                                                                    \
     using Node::operator==;                                                 \
+    TypeId typeId() const override { return NodeTypeId<T>::value; }        \
     bool apply_visitor_preorder(Modifier &v) override;                      \
     void apply_visitor_postorder(Modifier &v) override;                     \
     void apply_visitor_revisit(Modifier &v, const Node *n) const override;  \
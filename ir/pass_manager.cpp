@@ -14,6 +14,12 @@ See the License for the specific language governing permissions and
 limitations under the License.
 */
 
+#include <algorithm>
+#include <exception>
+#ifdef MULTITHREAD
+#include <atomic>
+#include <thread>
+#endif  // MULTITHREAD
 #include "ir.h"
 #include "lib/gc.h"
 #include "lib/n4.h"
@@ -107,6 +113,7 @@ const IR::Node *PassRepeated::apply_visitor(const IR::Node *program, const char
             done = true;
         program = newprogram;
     }
+    addProfileCounter("iterations", iterations);
     return program;
 }
 
@@ -117,3 +124,66 @@ const IR::Node *PassRepeatUntil::apply_visitor(const IR::Node *program, const ch
     } while (!done());
     return program;
 }
+
+unsigned ApplyToDeclarations::jobs = 1;
+
+const IR::Node *ApplyToDeclarations::apply_visitor(const IR::Node *node, const char *) {
+    auto program = node->to<IR::P4Program>();
+    if (program == nullptr)
+        return node->apply(*makePass());
+
+    // All declarations are visited: besides parsers, controls, actions and
+    // functions, instances may contain the bodies of abstract methods.
+    std::vector<const IR::Node *> work(program->declarations.begin(),
+                                       program->declarations.end());
+    std::vector<const IR::Node *> results(work.size());
+    std::vector<std::exception_ptr> failures(work.size());
+
+#ifdef MULTITHREAD
+    std::atomic<size_t> next(0);
+#else
+    size_t next = 0;
+#endif  // MULTITHREAD
+    // Each thread takes the next declaration not yet processed
+    auto run = [&]() {
+        for (size_t i; (i = next++) < work.size(); ) {
+            try {
+                results[i] = work[i]->apply(*makePass());
+            } catch (...) {
+                failures[i] = std::current_exception(); } } };
+#ifdef MULTITHREAD
+    std::vector<std::thread> threads;
+    if (jobs > 1 && work.size() > 1) {
+        gc_allow_threads();
+        for (size_t t = 1; t < std::min<size_t>(jobs, work.size()); t++)
+            threads.emplace_back([&run]() {
+                gc_register_thread();
+                run();
+                gc_unregister_thread(); }); }
+    run();
+    for (auto &t : threads)
+        t.join();
+#else
+    run();
+#endif  // MULTITHREAD
+    // Report the failure of the first declaration, as a sequential run would
+    for (auto &f : failures)
+        if (f) std::rethrow_exception(f);
+
+    bool changed = false;
+    for (size_t i = 0; i < work.size(); i++)
+        changed |= results[i] != work[i];
+    if (!changed)
+        return program;
+
+    IR::IndexedVector<IR::Node> declarations;
+    for (auto decl : results) {
+        if (decl == nullptr)
+            continue;
+        if (auto vec = decl->to<IR::VectorBase>()) {
+            for (auto el : *vec)
+                declarations.push_back(el);
+            continue; }
+        declarations.push_back(decl); }
+    return new IR::P4Program(program->srcInfo, declarations);
+}
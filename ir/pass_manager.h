@@ -86,6 +86,23 @@ class VisitFunctor : virtual public Visitor {
     : fn([f](const IR::Node *n)->const IR::Node *{ f(); return n; }) { setName("VisitFunctor"); }
 };
 
+/** Applies a pass separately to each top-level declaration of a P4 program,
+ * and puts the results back in the program, in the original order.  A new
+ * instance of the pass is created by @p makePass for each declaration, so
+ * that in builds with MULTITHREAD the declarations can be processed by up to
+ * `jobs` threads.
+ * Such passes must therefore not modify any state shared between
+ * declarations, e.g. the reference and type maps.
+ */
+class ApplyToDeclarations : virtual public Visitor {
+    std::function<Visitor *()>  makePass;
+    const IR::Node *apply_visitor(const IR::Node *, const char * = 0) override;
+ public:
+    static unsigned jobs;  // maximum number of threads to use
+    explicit ApplyToDeclarations(std::function<Visitor *()> makePass) : makePass(makePass)
+    { setName("ApplyToDeclarations"); }
+};
+
 class DynamicVisitor : virtual public Visitor {
     Visitor     *visitor;
     profile_t init_apply(const IR::Node *root) override {
@@ -23,6 +23,7 @@ limitations under the License.
 #include "lib/safe_vector.h"
 
 class JSONLoader;
+class BinaryLoader;
 
 namespace IR {
 
@@ -46,6 +47,7 @@ class VectorBase : public Node {
     VectorBase &operator=(VectorBase &&) = default;
  protected:
     explicit VectorBase(JSONLoader &json) : Node(json) {}
+    explicit VectorBase(BinaryLoader &bin) : Node(bin) {}
 };
 
 // This class should only be used in the IR.
@@ -60,6 +62,7 @@ class Vector : public VectorBase {
     Vector(const Vector &) = default;
     Vector(Vector &&) = default;
     explicit Vector(JSONLoader &json);
+    explicit Vector(BinaryLoader &bin);
     Vector &operator=(const Vector &) = default;
     Vector &operator=(Vector &&) = default;
     explicit Vector(const T *a) {
@@ -68,6 +71,7 @@ class Vector : public VectorBase {
         vec.insert(vec.end(), a.begin(), a.end()); }
     Vector(const std::initializer_list<const T *> &a) : vec(a) {}
     static Vector<T>* fromJSON(JSONLoader &json);
+    static Vector<T>* fromBinary(BinaryLoader &bin);
     typedef typename safe_vector<const T *>::iterator        iterator;
     typedef typename safe_vector<const T *>::const_iterator  const_iterator;
     iterator begin() { return vec.begin(); }
@@ -162,6 +166,7 @@ class Vector : public VectorBase {
     virtual void parallel_visit_children(Visitor &v);
     virtual void parallel_visit_children(Visitor &v) const;
     void toJSON(JSONGenerator &json) const override;
+    void toBinary(BinaryGenerator &bin) const override;
     Util::Enumerator<const T*>* getEnumerator() const {
         return Util::Enumerator<const T*>::createEnumerator(vec); }
     template <typename S>
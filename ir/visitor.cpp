@@ -14,8 +14,15 @@ See the License for the specific language governing permissions and
 limitations under the License.
 */
 
+#include <stdlib.h>
 #include <time.h>
+#include <fstream>
+#ifdef MULTITHREAD
+#include <atomic>
+#include <mutex>
+#endif  // MULTITHREAD
 #include "ir.h"
+#include "lib/gc.h"
 #include "lib/log.h"
 
 /** @class Visitor::ChangeTracker
@@ -151,6 +158,86 @@ void Visitor::end_apply() {}
 void Visitor::end_apply(const IR::Node*) {}
 
 static indent_t profile_indent;
+
+namespace {
+struct profile_event_t {
+    cstring             name;
+    uint64_t            start, duration, cpu;
+    size_t              allocated;
+    int                 nodes_created;
+    uint64_t            nodes_cloned, nodes_changed;
+    int                 thread;
+    std::vector<std::pair<cstring, uint64_t>>   counters;
+};
+
+cstring profile_file;
+std::vector<profile_event_t> profile_events;
+// events of the visitors running on this thread, innermost last
+thread_local std::vector<int> profile_stack;
+#ifdef MULTITHREAD
+std::mutex profile_lock;
+std::atomic<int> profile_threads;
+std::atomic<uint64_t> nodes_cloned, nodes_changed;
+#define PROFILE_LOCK std::lock_guard<std::mutex> acquire(profile_lock);
+#else
+int profile_threads;
+uint64_t nodes_cloned, nodes_changed;
+#define PROFILE_LOCK
+#endif  // MULTITHREAD
+thread_local int profile_thread = ++profile_threads;
+
+uint64_t cpu_time_ns() {
+#ifdef CLOCK_PROCESS_CPUTIME_ID
+    struct timespec ts;
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+    return ts.tv_sec*1000000000UL + ts.tv_nsec;
+#else
+    return 0;
+#endif
+}
+
+void write_profile_report() {
+    std::ofstream out(profile_file);
+    if (!out) {
+        ::error("%1%: cannot write profile report", profile_file);
+        return; }
+    // Chrome trace event format, one complete event per visitor run
+    uint64_t base = 0;
+    for (auto &e : profile_events)
+        if (e.start && (!base || e.start < base))
+            base = e.start;
+    const char *sep = "";
+    out << "{ \"displayTimeUnit\": \"ms\", \"traceEvents\": [";
+    for (auto &e : profile_events) {
+        if (!e.start) continue;  // still running when the program exited
+        out << sep << std::endl << "  { \"name\": \"" << e.name.escapeJson()
+            << "\", \"cat\": \"pass\", \"ph\": \"X\", \"pid\": 1, \"tid\": " << e.thread
+            << ", \"ts\": " << (e.start - base) / 1000.0 << ", \"dur\": " << e.duration / 1000.0
+            << ", \"args\": { \"cpu_usec\": " << e.cpu / 1000.0
+            << ", \"bytes_allocated\": " << e.allocated
+            << ", \"nodes_created\": " << e.nodes_created
+            << ", \"nodes_cloned\": " << e.nodes_cloned
+            << ", \"nodes_changed\": " << e.nodes_changed;
+        for (auto &c : e.counters)
+            out << ", \"" << c.first.escapeJson() << "\": " << c.second;
+        out << " } }";
+        sep = ","; }
+    out << std::endl << "] }" << std::endl;
+}
+}  // namespace
+
+void Visitor::enableProfileReport(cstring file) {
+    if (!profile_file)
+        atexit(write_profile_report);
+    profile_file = file;
+}
+
+void Visitor::addProfileCounter(cstring name, uint64_t value) {
+    if (!profile_file || profile_stack.empty()) return;
+    PROFILE_LOCK
+    profile_events.at(profile_stack.back()).counters.emplace_back(name, value);
+}
+
 Visitor::profile_t::profile_t(Visitor &v_) : v(v_) {
     struct timespec ts;
 #ifdef CLOCK_MONOTONIC
@@ -162,8 +249,23 @@ Visitor::profile_t::profile_t(Visitor &v_) : v(v_) {
     start = ts.tv_sec*1000000000UL + ts.tv_nsec + 1;
     assert(start);
     ++profile_indent;
+    if (profile_file) {
+        {
+            PROFILE_LOCK
+            event = profile_events.size();
+            profile_events.emplace_back();
+            profile_events.back().name = v.name();
+            profile_events.back().thread = profile_thread;
+            nodes_start = IR::Node::currentId;
+            cloned_start = nodes_cloned;
+            changed_start = nodes_changed; }
+        profile_stack.push_back(event);
+        cpu_start = cpu_time_ns();
+        alloc_start = gc_total_bytes(); }
 }
-Visitor::profile_t::profile_t(profile_t &&a) : v(a.v), start(a.start) {
+Visitor::profile_t::profile_t(profile_t &&a)
+: v(a.v), start(a.start), event(a.event), cpu_start(a.cpu_start), alloc_start(a.alloc_start),
+  nodes_start(a.nodes_start), cloned_start(a.cloned_start), changed_start(a.changed_start) {
     a.start = 0;
 }
 Visitor::profile_t::~profile_t() {
@@ -178,7 +280,20 @@ Visitor::profile_t::~profile_t() {
         ts.tv_sec = ts.tv_nsec = 0;
 #endif
         uint64_t end = ts.tv_sec*1000000000UL + ts.tv_nsec + 1;
-        LOG1(profile_indent << v.name() << ' ' << (end-start)/1000.0 << " usec"); }
+        LOG1(profile_indent << v.name() << ' ' << (end-start)/1000.0 << " usec");
+        if (event >= 0) {
+            uint64_t cpu = cpu_time_ns() - cpu_start;
+            size_t allocated = gc_total_bytes() - alloc_start;
+            profile_stack.pop_back();
+            PROFILE_LOCK
+            auto &e = profile_events.at(event);
+            e.start = start;
+            e.duration = end - start;
+            e.cpu = cpu;
+            e.allocated = allocated;
+            e.nodes_created = IR::Node::currentId - nodes_start;
+            e.nodes_cloned = nodes_cloned - cloned_start;
+            e.nodes_changed = nodes_changed - changed_start; } }
 }
 
 void Visitor::print_context() const {
@@ -202,6 +317,9 @@ void Modifier::visitor_const_error() {
     BUG("Modifier called const visit function -- missing template "
                             "instantiation in gen-tree-macro.h?"); }
 void Transform::visitor_const_error() {
+    // children of nodes that are not cloned are visited as const;
+    // their new values are recorded in child_results instead
+    if (child_results) return;
     BUG("Transform called const visit function -- missing template "
                             "instantiation in gen-tree-macro.h?"); }
 
@@ -228,6 +346,19 @@ class ForwardChildren : public Visitor {
  public:
     explicit ForwardChildren(const ChangeTracker &v) : visited(v) {}
 };
+
+/// Replaces the children of a node with the results of a previous
+/// visit of the children of the same node, in the same order.
+class ReplayChildren : public Visitor {
+    std::vector<std::pair<const IR::Node *, const IR::Node *>>::const_iterator next, end;
+    const IR::Node *apply_visitor(const IR::Node *n, const char * = 0) {
+        BUG_CHECK(next != end && next->first == n, "children visited in a different order");
+        return (next++)->second; }
+ public:
+    explicit ReplayChildren(const std::vector<std::pair<const IR::Node *,
+                                                        const IR::Node *>> &results)
+    : next(results.begin()), end(results.end()) {}
+};
 }    // namespace
 
 const IR::Node *Modifier::apply_visitor(const IR::Node *n, const char *name) {
@@ -240,6 +371,7 @@ const IR::Node *Modifier::apply_visitor(const IR::Node *n, const char *name) {
         } else {
             visited->start(n, visitDagOnce);
             IR::Node *copy = n->clone();
+            ++nodes_cloned;
             local.current.node = copy;
             if (!dontForwardChildrenBeforePreorder) {
                 ForwardChildren forward_children(*visited);
@@ -249,8 +381,9 @@ const IR::Node *Modifier::apply_visitor(const IR::Node *n, const char *name) {
                 copy->visit_children(*this);
                 visitCurrentOnce = visited->refVisitOnce(n);
                 copy->apply_visitor_postorder(*this); }
-            if (visited->finish(n, copy))
-                (n = copy)->validate(); } }
+            if (visited->finish(n, copy)) {
+                ++nodes_changed;
+                (n = copy)->validate(); } } }
     if (ctxt)
         ctxt->child_index++;
     else
@@ -284,16 +417,45 @@ const IR::Node *Inspector::apply_visitor(const IR::Node *n, const char *name) {
     return n;
 }
 
+bool Transform::hasDefaultVisit(const IR::Node *n) const {
+    auto it = default_visit_types.find(typeid(*n));
+    return it != default_visit_types.end() && it->second;
+}
+
 const IR::Node *Transform::apply_visitor(const IR::Node *n, const char *name) {
     if (ctxt) ctxt->child_name = name;
+    auto *orig = n;
+    auto *parent_results = child_results;
+    child_results = nullptr;
     if (n) {
         PushContext local(ctxt, n);
         if (visited->done(n)) {
             n->apply_visitor_revisit(*this, visited->result(n));
             n = visited->result(n);
+        } else if (cloneOnlyOnChange && hasDefaultVisit(n)) {
+            // preorder and postorder would return the node unchanged, so
+            // only clone it if some children change
+            visited->start(n, visitDagOnce);
+            child_results_t results;
+            child_results = &results;
+            n->visit_children(*this);
+            child_results = nullptr;
+            const IR::Node *final_result = n;
+            for (auto &r : results) {
+                if (r.first != r.second) {
+                    auto copy = n->clone();
+                    ++nodes_cloned;
+                    ReplayChildren replay(results);
+                    copy->visit_children(replay);
+                    final_result = copy;
+                    break; } }
+            if (visited->finish(n, final_result)) {
+                ++nodes_changed;
+                (n = final_result)->validate(); }
         } else {
             visited->start(n, visitDagOnce);
             auto copy = n->clone();
+            ++nodes_cloned;
             local.current.node = copy;
             if (!dontForwardChildrenBeforePreorder) {
                 ForwardChildren forward_children(*visited);
@@ -301,7 +463,9 @@ const IR::Node *Transform::apply_visitor(const IR::Node *n, const char *name) {
             prune_flag = false;
             visitCurrentOnce = visited->refVisitOnce(n);
             bool extra_clone = false;
+            default_visit = false;
             const IR::Node *preorder_result = copy->apply_visitor_preorder(*this);
+            bool default_preorder = default_visit;
             assert(preorder_result != n);  // should never happen
             const IR::Node *final_result = preorder_result;
             if (preorder_result != copy) {
@@ -316,19 +480,28 @@ const IR::Node *Transform::apply_visitor(const IR::Node *n, const char *name) {
                 } else {
                     extra_clone = true;
                     visited->start(preorder_result, *visitCurrentOnce);
-                    local.current.node = copy = preorder_result->clone(); } }
+                    local.current.node = copy = preorder_result->clone();
+                    ++nodes_cloned; } }
             if (!prune_flag) {
                 copy->visit_children(*this);
                 visitCurrentOnce = visited->refVisitOnce(n);
-                final_result = copy->apply_visitor_postorder(*this); }
+                default_visit = false;
+                final_result = copy->apply_visitor_postorder(*this);
+                if (cloneOnlyOnChange)
+                    default_visit_types.emplace(typeid(*n), default_preorder && default_visit); }
             if (final_result
                 && final_result != preorder_result
                 && *final_result == *preorder_result)
                 final_result = preorder_result;
-            if (visited->finish(n, final_result) && (n = final_result))
-                final_result->validate();
+            if (visited->finish(n, final_result)) {
+                ++nodes_changed;
+                if ((n = final_result))
+                    final_result->validate(); }
             if (extra_clone)
                 visited->finish(preorder_result, final_result); } }
+    child_results = parent_results;
+    if (child_results)
+        child_results->emplace_back(orig, n);
     if (ctxt)
         ctxt->child_index++;
     else
@@ -18,6 +18,7 @@ limitations under the License.
 #define _IR_VISITOR_H_
 
 #include <stdexcept>
+#include <typeindex>
 #include <unordered_map>
 #include "lib/cstring.h"
 #include "ir/ir.h"
@@ -41,6 +42,12 @@ class Visitor {
         // starts and destroyed when it ends.  Moveable but not copyable.
         Visitor         &v;
         uint64_t        start;
+        // only used for the profile report, see enableProfileReport
+        int             event = -1;
+        uint64_t        cpu_start = 0;
+        size_t          alloc_start = 0;
+        int             nodes_start = 0;
+        uint64_t        cloned_start = 0, changed_start = 0;
         explicit profile_t(Visitor &);
         profile_t() = delete;
         profile_t(const profile_t &) = delete;
@@ -53,6 +60,13 @@ class Visitor {
     };
     virtual ~Visitor() = default;
 
+    // Record the wall and cpu time, the memory allocated, and the number of IR
+    // nodes created, cloned and changed by every visitor, and write them to
+    // @p file in the Chrome trace event format when the program exits.
+    static void enableProfileReport(cstring file);
+    // Add a counter to the profile report for the innermost visitor running
+    static void addProfileCounter(cstring name, uint64_t value);
+
     const char* internalName = nullptr;
 
     // init_apply is called (once) when apply is called on an IR tree
@@ -280,16 +294,24 @@ class Inspector : public virtual Visitor {
 };
 
 class Transform : public virtual Visitor {
+    typedef std::vector<std::pair<const IR::Node *, const IR::Node *>> child_results_t;
     ChangeTracker       *visited = nullptr;
     bool prune_flag = false;
+    // set by the default preorder/postorder, to find node types this
+    // Transform does not visit (see cloneOnlyOnChange)
+    bool default_visit = false;
+    std::unordered_map<std::type_index, bool> default_visit_types;
+    // results of visiting the children of a node that was not cloned
+    child_results_t     *child_results = nullptr;
     void visitor_const_error() override;
     bool check_clone(const Visitor *) override;
+    bool hasDefaultVisit(const IR::Node *n) const;
 
  public:
     profile_t init_apply(const IR::Node *root) override;
     const IR::Node *apply_visitor(const IR::Node *, const char *name = 0) override;
-    virtual const IR::Node *preorder(IR::Node *n) {return n;}
-    virtual const IR::Node *postorder(IR::Node *n) {return n;}
+    virtual const IR::Node *preorder(IR::Node *n) { default_visit = true; return n; }
+    virtual const IR::Node *postorder(IR::Node *n) { default_visit = true; return n; }
     virtual void revisit(const IR::Node *, const IR::Node *) {}
 #define DECLARE_VISIT_FUNCTIONS(CLASS, BASE)                            \
     virtual const IR::Node *preorder(IR::CLASS *);                      \
@@ -306,6 +328,12 @@ class Transform : public virtual Visitor {
         auto *rv = apply_visitor(child);
         prune_flag = true;
         return rv; }
+    // if cloneOnlyOnChange is set to 'true' (usually in the derived Transform
+    // class constructor), nodes for which the Transform has neither a preorder
+    // nor a postorder function are not cloned, unless one of their children
+    // changes.  The Transform must not override preorder/postorder functions
+    // and then call the Transform:: versions for some of the nodes.
+    bool cloneOnlyOnChange = false;
 };
 
 class ControlFlowVisitor : public virtual Visitor {
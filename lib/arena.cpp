@@ -0,0 +1,61 @@
+/*
+Copyright 2013-present Barefoot Networks, Inc.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include "config.h"
+#if HAVE_LIBGC
+#include <gc/gc.h>
+#endif  /* HAVE_LIBGC */
+#include "arena.h"
+
+thread_local Arena *Arena::current_ = nullptr;
+
+void *Arena::new_chunk(size_t size) {
+    if (size > max_object)
+        return ::operator new(size);
+    // The first bytes of a chunk are never handed out, so that release()
+    // can tell a chunk from an object allocated on its own.
+    next = static_cast<char *>(::operator new(chunk_size)) + align;
+    end = next - align + chunk_size;
+    chunks.push_back(next - align);
+    void *rv = next;
+    next += size;
+    used += size;
+    return rv;
+}
+
+void Arena::reset() {
+    chunks.clear();
+    chunks.shrink_to_fit();
+    next = end = nullptr;
+    used = 0;
+}
+
+void Arena::release(void *p) {
+#if HAVE_LIBGC
+    if (GC_base(p) != p)
+        return;  // inside an arena chunk
+#endif  /* HAVE_LIBGC */
+    ::operator delete(p);
+}
+
+Arena::Scope::Scope(Arena *arena) : saved(current_) {
+#if HAVE_LIBGC
+    current_ = arena;
+#else
+    (void)arena;
+    current_ = nullptr;
+#endif  /* HAVE_LIBGC */
+}
@@ -0,0 +1,96 @@
+/*
+Copyright 2013-present Barefoot Networks, Inc.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#ifndef P4C_LIB_ARENA_H_
+#define P4C_LIB_ARENA_H_
+
+#include <cstddef>
+#include <new>
+#include <vector>
+
+/**
+ * A bump-pointer allocator for objects that live for a whole compilation,
+ * such as IR nodes.  Memory comes from the garbage-collected heap in large
+ * chunks which the arena keeps alive; objects in them are never freed one by
+ * one, and the collector has no per-object work to do for them.
+ *
+ * Lifetime rules:
+ *  - allocation goes to the arena made current for the calling thread by an
+ *    Arena::Scope; other threads, and code outside any scope, use operator new;
+ *  - when the arena is reset or destroyed, its chunks are not released but
+ *    merely forgotten: the collector reclaims each one as a whole once nothing
+ *    points into it, so objects that are still referenced stay valid;
+ *  - compacting (see reset()) therefore means copying the live data after the
+ *    reset, and dropping all references to the old copy.
+ *
+ * This relies on the collector recognizing interior pointers, which is its
+ * default.  Without the collector memory is never reclaimed anyway, and an
+ * arena is never made current.
+ */
+class Arena {
+    static const size_t chunk_size = 1 << 20;
+    static const size_t align = alignof(std::max_align_t);
+    /// larger objects get their own allocation
+    static const size_t max_object = chunk_size / 16;
+
+    static thread_local Arena *current_;
+
+    std::vector<void *> chunks;
+    char        *next = nullptr, *end = nullptr;
+    size_t      used = 0;
+
+    void *new_chunk(size_t size);
+
+ public:
+    Arena() = default;
+    Arena(const Arena &) = delete;
+    Arena &operator=(const Arena &) = delete;
+    ~Arena() { reset(); }
+
+    void *allocate(size_t size) {
+        size = (size + align - 1) & ~(align - 1);
+        if (size > size_t(end - next))
+            return new_chunk(size);
+        void *rv = next;
+        next += size;
+        used += size;
+        return rv; }
+    /// Forget all chunks; allocation continues in new ones.
+    void reset();
+    /// Bytes allocated since the last reset.
+    size_t size() const { return used; }
+
+    static Arena *current() { return current_; }
+    /// Allocate @p size bytes in the current arena, or with operator new if there is none.
+    static void *alloc(size_t size) {
+        if (auto *arena = current_)
+            return arena->allocate(size);
+        return ::operator new(size); }
+    /// Free memory obtained from alloc; a no-op for memory in an arena.
+    static void release(void *p);
+
+    /// Makes an arena current for this thread while it exists.  A null
+    /// arena makes none current.
+    class Scope {
+        Arena *saved;
+     public:
+        explicit Scope(Arena *arena);
+        Scope(const Scope &) = delete;
+        ~Scope() { current_ = saved; }
+    };
+};
+
+#endif /* P4C_LIB_ARENA_H_ */
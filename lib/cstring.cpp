@@ -15,35 +15,155 @@ limitations under the License.
 */
 
 #include "cstring.h"
+#include <stdint.h>
+#include <stdlib.h>
+#include <atomic>
 #include <string>
-#include <unordered_set>
 
-static std::unordered_set<std::string> *cache = nullptr;
+/* The intern table is a hash trie indexed by the bits of the string hashes.
+ * Each slot is either empty, points to a list of records of strings with
+ * the same hash, or (if the low bit is set) points to the next level of
+ * the trie.  Slots only change from empty to a record, from a record to a
+ * longer list of records, or from a record to a trie node, so insertion
+ * needs a single compare-and-swap and lookups need no synchronization.
+ *
+ * Records are never freed; they are allocated from per-thread arenas
+ * using malloc, since they contain no pointers the garbage collector
+ * needs to know about. */
+
+namespace {
+
+struct record_t {
+    const record_t      *next;  // next record with the same hash
+    size_t              length;
+    size_t              hash;
+    // followed by length + 1 characters
+    const char *data() const { return reinterpret_cast<const char *>(this + 1); }
+    char *data() { return reinterpret_cast<char *>(this + 1); }
+};
+
+static const int root_bits = 12;
+static const int node_bits = 6;
+
+struct node_t {
+    std::atomic<uintptr_t>      slot[1 << node_bits];
+};
+
+std::atomic<uintptr_t>  root[1 << root_bits];  // zero-initialized before any constructor runs
+std::atomic<size_t>     interned_count, interned_bytes;
+
+bool is_node(uintptr_t slot) { return slot & 1; }
+node_t *to_node(uintptr_t slot) { return reinterpret_cast<node_t *>(slot & ~uintptr_t(1)); }
+const record_t *to_record(uintptr_t slot) { return reinterpret_cast<const record_t *>(slot); }
+
+/// Per-thread bump allocator for records.
+struct arena_t {
+    char        *next, *end;
+    record_t    *last;
+    static const size_t chunk_size = 64*1024;
+
+    static size_t alloc_size(size_t length) {
+        return (sizeof(record_t) + length + 1 + alignof(record_t) - 1)
+               & ~(alignof(record_t) - 1); }
+    record_t *alloc(size_t length) {
+        size_t size = alloc_size(length);
+        if (size > chunk_size / 4)
+            return static_cast<record_t *>(malloc(size));
+        if (size > size_t(end - next)) {
+            next = static_cast<char *>(malloc(chunk_size));
+            end = next + chunk_size; }
+        last = reinterpret_cast<record_t *>(next);
+        next += size;
+        return last; }
+    // Give back a record that was not needed after all
+    void release(record_t *rec, size_t length) {
+        if (alloc_size(length) > chunk_size / 4) {
+            free(rec);
+        } else if (rec == last) {
+            next = reinterpret_cast<char *>(rec);
+            last = nullptr; } }
+};
+
+thread_local arena_t arena;
+
+const record_t *find_record(const record_t *rec, const char *s, size_t length) {
+    for (; rec; rec = rec->next)
+        if (rec->length == length && memcmp(rec->data(), s, length) == 0)
+            return rec;
+    return nullptr;
+}
+
+}  // namespace
+
+size_t cstring::hash(const char *s, size_t length) {
+    // 64-bit FNV-1a, followed by a finalizer that spreads the bits, since
+    // the trie uses the low bits first
+    uint64_t h = 0xcbf29ce484222325ULL;
+    for (size_t i = 0; i < length; ++i) {
+        h ^= static_cast<unsigned char>(s[i]);
+        h *= 0x100000001b3ULL; }
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    return static_cast<size_t>(h);
+}
+
+const char *cstring::intern(const char *s, size_t length) {
+    static_assert(sizeof(record_t) == sizeof(void *) + sizeof(header_t),
+                  "cstring::header_t must be at the end of record_t");
+    size_t h = hash(s, length);
+    record_t *rec = nullptr;
+    std::atomic<uintptr_t> *slots = root;
+    unsigned shift = 0, bits = root_bits;
+    while (true) {
+        auto &slot = slots[(h >> shift) & ((size_t(1) << bits) - 1)];
+        uintptr_t current = slot.load(std::memory_order_acquire);
+        if (is_node(current)) {
+            slots = to_node(current)->slot;
+            shift += bits;
+            bits = node_bits;
+            continue; }
+        auto *list = to_record(current);
+        if (list && list->hash != h) {
+            // Strings with different hashes; move the existing ones one level
+            // down.  They differ in some bit above this level, so this ends.
+            auto *node = static_cast<node_t *>(calloc(1, sizeof(node_t)));
+            node->slot[(list->hash >> (shift + bits)) & ((1 << node_bits) - 1)].store(
+                current, std::memory_order_relaxed);
+            if (!slot.compare_exchange_strong(current, reinterpret_cast<uintptr_t>(node) | 1,
+                                              std::memory_order_release))
+                free(node);
+            continue; }
+        if (auto *found = find_record(list, s, length)) {
+            if (rec) arena.release(rec, length);
+            return found->data(); }
+        if (!rec) {
+            rec = arena.alloc(length);
+            rec->length = length;
+            rec->hash = h;
+            memcpy(rec->data(), s, length);
+            rec->data()[length] = 0; }
+        rec->next = list;
+        if (slot.compare_exchange_strong(current, reinterpret_cast<uintptr_t>(rec),
+                                         std::memory_order_release)) {
+            interned_count.fetch_add(1, std::memory_order_relaxed);
+            interned_bytes.fetch_add(arena_t::alloc_size(length), std::memory_order_relaxed);
+            return rec->data(); } }
+}
 
 cstring &cstring::operator=(const char *p) {
-    if (cache == nullptr)
-        cache = new std::unordered_set<std::string>();
-    str = p ? cache->emplace(p).first->c_str() : 0;
+    str = p ? intern(p, strlen(p)) : 0;
     return *this;
 }
 
 cstring& cstring::operator=(const std::string& s) {
-    if (cache == nullptr)
-        cache = new std::unordered_set<std::string>();
-    str = cache->insert(s).first->c_str();
+    str = intern(s.data(), s.size());
     return *this;
 }
 
 size_t cstring::cache_size(size_t &count) {
-    size_t rv = 0;
-    if (cache) {
-        count = cache->size();
-        for (auto &s : *cache)
-            rv += sizeof(s) + s.size();
-    } else {
-        count = 0;
-    }
-    return rv;
+    count = interned_count.load(std::memory_order_relaxed);
+    return interned_bytes.load(std::memory_order_relaxed);
 }
 
 cstring cstring::newline = cstring("\n");
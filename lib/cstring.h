@@ -44,14 +44,14 @@ limitations under the License.
  *   - Because cstring deals with immutable strings, any modification requires
  *     that the complete string be copied.
  *   - Interning has an initial cost: converting a const char*, a
- *     std::string, or a std::stringstream to a cstring requires copying it.
- *     Currently, this happens every time you perform the conversion, whether
- *     the string is already interned or not, unless the source is an
- *     std::string.
+ *     std::string, or a std::stringstream to a cstring requires hashing it,
+ *     and copying it if it is not already interned.
  *   - Interned strings can never be freed, so they'll stick around for the
  *     lifetime of the program.
- *   - The string interning cstring performs is currently not threadsafe, so you
- *     can't safely use cstrings off the main thread.
+ *
+ * The intern table is lock-free, so cstrings can be created on any thread.
+ * Each interned string is stored together with its length and hash, so
+ * size() and hashing a cstring are constant-time operations.
  *
  * Given these tradeoffs, the general rule of thumb to follow is that you should
  * try to convert strings to cstrings early and keep them in that form. That
@@ -71,6 +71,14 @@ limitations under the License.
 class cstring {
     const char *str;
 
+    // Every interned string is immediately preceded by this header.
+    struct header_t {
+        size_t  length;
+        size_t  hash;
+    };
+    const header_t *header() const { return reinterpret_cast<const header_t *>(str) - 1; }
+    static const char *intern(const char *s, size_t length);
+
  public:
     cstring() : str(0) {}
 
@@ -93,6 +101,10 @@ class cstring {
     /// the enclosing quotes).
     cstring escapeJson() const;
 
+    // Interns the first length characters of s, which need not be
+    // zero-terminated.
+    cstring(const char *s, size_t length) : str(intern(s, length)) {}
+
     template <typename Iter> cstring(Iter begin, Iter end) {
         *this = std::string(begin, end);
     }
@@ -101,8 +113,8 @@ class cstring {
     const char *c_str() const { return str; }
     operator const char *() const { return str; }
 
-    // Size tests. Constant time except for size(), which is linear time.
-    size_t size() const { return str ? strlen(str) : 0; }
+    // Size tests. Constant time.
+    size_t size() const { return str ? header()->length : 0; }
     bool isNull() const { return str == nullptr; }
     bool isNullOrEmpty() const { return str == nullptr ? true : str[0] == 0; }
 
@@ -114,6 +126,11 @@ class cstring {
     bool operator==(const cstring &a) const { return str == a.str; }
     bool operator!=(const cstring &a) const { return str != a.str; }
 
+    // Hash of the string contents, computed when the string is interned.
+    // Constant time, and the same in every run of the program.
+    size_t hash() const { return str ? header()->hash : 0; }
+    static size_t hash(const char *s, size_t length);
+
     // Other comparisons and tests. Linear time.
     bool operator==(const char *a) const { return str ? a && !strcmp(str, a) : !a; }
     bool operator!=(const char *a) const { return str ? !a || !!strcmp(str, a) : !!a; }
@@ -216,8 +233,8 @@ inline std::ostream &operator<<(std::ostream &out, cstring s) {
 namespace std {
 template<> struct hash<cstring> {
     std::size_t operator()(const cstring& c) const {
-        // This implementation is good for cstring, since the strings are internalized
-        return hash<const void *>()(c.c_str());
+        // The hash is computed once, when the string is interned
+        return c.hash();
     }
 };
 }  // namespace std
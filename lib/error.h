@@ -22,6 +22,10 @@ limitations under the License.
 #include <stdarg.h>
 #include <boost/format.hpp>
 #include <type_traits>
+#ifdef MULTITHREAD
+#include <atomic>
+#include <mutex>
+#endif  // MULTITHREAD
 
 #include "lib/source_file.h"
 #include "lib/stringify.h"
@@ -369,6 +373,9 @@ class ErrorReporter final {
 
  private:
     void emit_message(cstring message) {
+#ifdef MULTITHREAD
+        std::lock_guard<std::mutex> acquire(lock);
+#endif  // MULTITHREAD
         *outputstream << message;
         outputstream->flush();
     }
@@ -477,8 +484,14 @@ class ErrorReporter final {
     }
 
  private:
+#ifdef MULTITHREAD
+    std::atomic<unsigned> errorCount;
+    std::atomic<unsigned> warningCount;
+    std::mutex lock;  // serializes messages from different threads
+#else
     unsigned errorCount;
     unsigned warningCount;
+#endif  // MULTITHREAD
 };
 
 // Errors (and warnings) are specified using boost::format format strings, i.e.,
@@ -16,10 +16,16 @@ limitations under the License.
 
 #include "config.h"
 #if HAVE_LIBGC
+#ifdef MULTITHREAD
+#define GC_THREADS
+#endif  // MULTITHREAD
 #include <gc/gc_cpp.h>
 #include <gc/gc_mark.h>
 #endif  /* HAVE_LIBGC */
 #include <new>
+#ifdef MULTITHREAD
+#include <mutex>
+#endif  // MULTITHREAD
 #include "log.h"
 #include "gc.h"
 #include "cstring.h"
@@ -95,3 +101,34 @@ size_t gc_mem_inuse(size_t *max) {
     return 0;
 #endif
 }
+
+size_t gc_total_bytes() {
+#if HAVE_LIBGC
+    return GC_get_total_bytes();
+#else
+    return 0;
+#endif
+}
+
+#ifdef MULTITHREAD
+void gc_allow_threads() {
+#if HAVE_LIBGC
+    static std::once_flag allow;
+    std::call_once(allow, GC_allow_register_threads);
+#endif  /* HAVE_LIBGC */
+}
+
+void gc_register_thread() {
+#if HAVE_LIBGC
+    struct GC_stack_base sb;
+    GC_get_stack_base(&sb);
+    GC_register_my_thread(&sb);
+#endif  /* HAVE_LIBGC */
+}
+
+void gc_unregister_thread() {
+#if HAVE_LIBGC
+    GC_unregister_my_thread();
+#endif  /* HAVE_LIBGC */
+}
+#endif  // MULTITHREAD
@@ -21,5 +21,15 @@ limitations under the License.
 
 void setup_gc_logging();
 size_t gc_mem_inuse(size_t *max = 0);  // trigger GC, return inuse after
+size_t gc_total_bytes();  // total bytes allocated since the program started
+
+#ifdef MULTITHREAD
+// Threads other than the main thread that allocate memory must call
+// gc_register_thread when they start and gc_unregister_thread before exiting.
+// gc_allow_threads must be called by the main thread before starting them.
+void gc_allow_threads();
+void gc_register_thread();
+void gc_unregister_thread();
+#endif  // MULTITHREAD
 
 #endif /* LIB_GC_H_ */
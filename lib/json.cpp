@@ -14,6 +14,7 @@ See the License for the specific language governing permissions and
 limitations under the License.
 */
 
+#include <stdio.h>
 #include <stdexcept>
 #include <sstream>
 #include "json.h"
@@ -21,6 +22,137 @@ limitations under the License.
 
 namespace Util {
 
+void JsonWriter::newline(size_t depth) {
+    if (compact)
+        return;
+    buffer += '\n';
+    buffer.append(depth * indent_t::tabsz, ' ');
+}
+
+void JsonWriter::beforeValue() {
+    if (scopes.empty())
+        return;
+    auto &scope = scopes.back();
+    if (scope.object) {
+        if (!afterKey)
+            throw std::logic_error("Json object member without a label");
+        afterKey = false;
+        return;
+    }
+    if (!scope.empty) {
+        buffer += ',';
+        if (scope.inlined && !compact)
+            buffer += ' ';
+    }
+    if (!scope.inlined)
+        newline(scopes.size());
+    scope.empty = false;
+}
+
+JsonWriter& JsonWriter::scalar(const char* text, size_t length) {
+    beforeValue();
+    buffer.append(text, length);
+    if (buffer.size() >= flushThreshold)
+        flush();
+    return *this;
+}
+
+JsonWriter& JsonWriter::beginObject() {
+    beforeValue();
+    buffer += '{';
+    scopes.push_back({true, false, true});
+    return *this;
+}
+
+JsonWriter& JsonWriter::endObject() {
+    if (scopes.empty() || !scopes.back().object || afterKey)
+        throw std::logic_error("Unbalanced json object");
+    scopes.pop_back();
+    newline(scopes.size());
+    buffer += '}';
+    if (buffer.size() >= flushThreshold)
+        flush();
+    return *this;
+}
+
+JsonWriter& JsonWriter::beginArray(bool inlined) {
+    beforeValue();
+    buffer += '[';
+    scopes.push_back({false, inlined, true});
+    return *this;
+}
+
+JsonWriter& JsonWriter::endArray() {
+    if (scopes.empty() || scopes.back().object)
+        throw std::logic_error("Unbalanced json array");
+    auto scope = scopes.back();
+    scopes.pop_back();
+    if (!scope.inlined && !scope.empty)
+        newline(scopes.size());
+    buffer += ']';
+    if (buffer.size() >= flushThreshold)
+        flush();
+    return *this;
+}
+
+JsonWriter& JsonWriter::key(cstring label) {
+    if (scopes.empty() || !scopes.back().object || afterKey)
+        throw std::logic_error("Json label outside of an object");
+    auto &scope = scopes.back();
+    if (!scope.empty)
+        buffer += ',';
+    scope.empty = false;
+    newline(scopes.size());
+    buffer += '"';
+    buffer.append(label.c_str(), label.size());
+    buffer += compact ? "\":" : "\" : ";
+    afterKey = true;
+    return *this;
+}
+
+JsonWriter& JsonWriter::value(long v) {
+    char text[24];
+    int length = snprintf(text, sizeof(text), "%ld", v);
+    return scalar(text, length);
+}
+
+JsonWriter& JsonWriter::value(unsigned long v) {
+    char text[24];
+    int length = snprintf(text, sizeof(text), "%lu", v);
+    return scalar(text, length);
+}
+
+JsonWriter& JsonWriter::value(const mpz_class& v) {
+    if (v.fits_slong_p())
+        return value(v.get_si());
+    return scalar(v.get_str().c_str());
+}
+
+JsonWriter& JsonWriter::value(cstring s) {
+    beforeValue();
+    buffer += '"';
+    if (s)
+        buffer.append(s.c_str(), s.size());
+    else
+        buffer += "<null>";  // as printed by cstring's operator<<
+    buffer += '"';
+    if (buffer.size() >= flushThreshold)
+        flush();
+    return *this;
+}
+
+void JsonWriter::flush() {
+    if (buffer.empty())
+        return;
+    out.write(buffer.data(), buffer.size());
+    buffer.clear();
+}
+
+void IJson::serialize(std::ostream& out, bool compact) const {
+    JsonWriter writer(out, compact);
+    serialize(writer);
+}
+
 cstring IJson::toString() const {
     std::stringstream str;
     serialize(str);
@@ -29,22 +161,22 @@ cstring IJson::toString() const {
 
 JsonValue* JsonValue::null = new JsonValue();
 
-void JsonValue::serialize(std::ostream& out) const {
+void JsonValue::serialize(JsonWriter& writer) const {
     switch (tag) {
         case Kind::String:
-            out << "\"" << str << "\"";
+            writer.value(str);
             break;
         case Kind::Number:
-            out << value;
+            writer.value(value);
             break;
         case Kind::True:
-            out << "true";
+            writer.value(true);
             break;
         case Kind::False:
-            out << "false";
+            writer.value(false);
             break;
         case Kind::Null:
-            out << "null";
+            writer.null();
             break;
     }
 }
@@ -87,33 +219,22 @@ bool JsonValue::operator==(const JsonValue& other) const {
     }
 }
 
-void JsonArray::serialize(std::ostream& out) const {
+void JsonArray::serialize(JsonWriter& writer) const {
     bool isSmall = true;
     for (auto v : *this) {
-        if (!v->is<JsonValue>())
+        if (v == nullptr || !v->is<JsonValue>()) {
             isSmall = false;
+            break;
+        }
     }
-    out << "[";
-    if (!isSmall)
-        out << IndentCtl::indent;
-    bool first = true;
+    writer.beginArray(isSmall);
     for (auto v : *this) {
-        if (!first) {
-            out << ",";
-            if (isSmall)
-                out << " ";
-        }
-        if (!isSmall)
-            out << IndentCtl::endl;
         if (v == nullptr)
-            out << "null";
+            writer.null();
         else
-            v->serialize(out);
-        first = false;
+            v->serialize(writer);
     }
-    if (!isSmall)
-        out << IndentCtl::unindent << IndentCtl::endl;
-    out << "]";
+    writer.endArray();
 }
 
 bool JsonValue::getBool() const {
@@ -146,21 +267,16 @@ JsonArray* JsonArray::append(IJson* value) {
     return this;
 }
 
-void JsonObject::serialize(std::ostream& out) const {
-    out << "{" << IndentCtl::indent;
-    bool first = true;
+void JsonObject::serialize(JsonWriter& writer) const {
+    writer.beginObject();
     for (auto &it : *this) {
-        if (!first)
-            out << ",";
-        first = false;
-        out << IndentCtl::endl;
-        out << "\"" << it.first << "\"" << " : ";
+        writer.key(it.first);
         if (it.second == nullptr)
-            out << "null";
+            writer.null();
         else
-            it.second->serialize(out);
+            it.second->serialize(writer);
     }
-    out << IndentCtl::unindent << IndentCtl::endl << "}";
+    writer.endObject();
 }
 
 JsonObject* JsonObject::emplace(cstring label, IJson* value) {
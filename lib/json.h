@@ -17,7 +17,9 @@ limitations under the License.
 #ifndef _LIB_JSON_H_
 #define _LIB_JSON_H_
 
+#include <string.h>
 #include <iostream>
+#include <string>
 #include <vector>
 #include <stdexcept>
 
@@ -30,10 +32,67 @@ namespace Test { class TestJson; }
 
 namespace Util {
 
+/**
+ * Streaming JSON output.  Text is produced as the begin/end and scalar calls
+ * are made, into a buffer that is written to the stream in large blocks, so
+ * no tree needs to exist for the part of the document already written.
+ * The default layout is the one IJson::serialize has always produced; in
+ * compact mode no whitespace is written at all.
+ * Calls that would produce malformed JSON (a value in an object without a
+ * key, unbalanced end calls) throw std::logic_error.
+ */
+class JsonWriter {
+    struct Scope {
+        bool object;
+        bool inlined;
+        bool empty;
+    };
+
+    std::ostream& out;
+    const bool compact;
+    std::string buffer;
+    std::vector<Scope> scopes;
+    bool afterKey = false;
+
+    static constexpr size_t flushThreshold = 1 << 16;
+    void beforeValue();
+    void newline(size_t depth);
+    JsonWriter& scalar(const char* text, size_t length);
+    JsonWriter& scalar(const char* text) { return scalar(text, strlen(text)); }
+
+ public:
+    explicit JsonWriter(std::ostream& out, bool compact = false)
+            : out(out), compact(compact) {}
+    ~JsonWriter() { flush(); }
+
+    JsonWriter& beginObject();
+    JsonWriter& endObject();
+    /// The elements of an inlined array are all written on one line;
+    /// IJson uses this for arrays that contain only scalars.
+    JsonWriter& beginArray(bool inlined = false);
+    JsonWriter& endArray();
+    /// Starts the next member of the current object.
+    JsonWriter& key(cstring label);
+
+    JsonWriter& null() { return scalar("null", 4); }
+    JsonWriter& value(bool b) { return b ? scalar("true", 4) : scalar("false", 5); }
+    JsonWriter& value(int v) { return value(static_cast<long>(v)); }
+    JsonWriter& value(unsigned v) { return value(static_cast<unsigned long>(v)); }
+    JsonWriter& value(long v);
+    JsonWriter& value(unsigned long v);
+    JsonWriter& value(const mpz_class& v);
+    JsonWriter& value(cstring s);
+    JsonWriter& value(const char* s) { return value(cstring(s)); }
+
+    /// Writes out all buffered text.
+    void flush();
+};
+
 class IJson {
  public:
     virtual ~IJson() {}
-    virtual void serialize(std::ostream& out) const = 0;
+    virtual void serialize(JsonWriter& writer) const = 0;
+    void serialize(std::ostream& out, bool compact = false) const;
     cstring toString() const;
     template<typename T> bool is() const { return to<T>() != nullptr; }
     template<typename T> T* to() { return dynamic_cast<T*>(this); }
@@ -63,7 +122,8 @@ class JsonValue final : public IJson {
     JsonValue(cstring s) : tag(Kind::String), str(s) {}       // NOLINT
     JsonValue(std::string s) : tag(Kind::String), str(s) {}   // NOLINT
     JsonValue(const char* s) : tag(Kind::String), str(s) {}   // NOLINT
-    void serialize(std::ostream& out) const;
+    using IJson::serialize;
+    void serialize(JsonWriter& writer) const override;
 
     bool operator==(const bool& b) const;
     bool operator==(const mpz_class& v) const;
@@ -104,7 +164,8 @@ class JsonValue final : public IJson {
 class JsonArray final : public IJson, public std::vector<IJson*> {
     friend class Test::TestJson;
  public:
-    void serialize(std::ostream& out) const;
+    using IJson::serialize;
+    void serialize(JsonWriter& writer) const override;
     JsonArray* append(IJson* value);
     JsonArray* append(bool b) { append(new JsonValue(b)); return this; }
     JsonArray* append(mpz_class v) { append(new JsonValue(v)); return this; }
@@ -126,7 +187,8 @@ class JsonObject final : public IJson, public ordered_map<cstring, IJson*> {
 
  public:
     JsonObject() = default;
-    void serialize(std::ostream& out) const;
+    using IJson::serialize;
+    void serialize(JsonWriter& writer) const override;
     JsonObject* emplace(cstring label, IJson* value);
     JsonObject* emplace_non_null(cstring label, IJson* value);
     JsonObject* emplace(cstring label, bool b)
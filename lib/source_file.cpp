@@ -14,6 +14,7 @@ See the License for the specific language governing permissions and
 limitations under the License.
 */
 
+#include <string.h>
 #include <sstream>
 
 #include <algorithm>
@@ -59,7 +60,7 @@ InputSources* InputSources::instance = new InputSources();
 InputSources::InputSources() :
         sealed(false) {
     mapLine(nullptr, 1);  // the first line read will be line 1 of stdin
-    contents.push_back("");
+    lineStarts.push_back(0);
 }
 
 /* static */ void InputSources::reset() {
@@ -75,8 +76,8 @@ void InputSources::seal() {
 }
 
 unsigned InputSources::lineCount() const {
-    int size = contents.size();
-    if (contents.back().isNullOrEmpty()) {
+    int size = lineStarts.size();
+    if (lineStarts.back() == contents.size()) {
         // do not count the last line if it is empty.
         size -= 1;
         if (size < 0)
@@ -90,20 +91,17 @@ void InputSources::appendToLastLine(StringRef text) {
     if (sealed)
         BUG("Appending to sealed InputSources");
     // Text should not contain any newline characters
-    for (size_t i = 0; i < text.len; i++) {
-        char c = text[i];
-        if (c == '\n')
-            BUG("Text contains newlines");
-    }
-    contents.back() += text.toString();
+    if (memchr(text.p, '\n', text.len) != nullptr)
+        BUG("Text contains newlines");
+    contents.append(text.p, text.len);
 }
 
 // Append a newline and start a new line
 void InputSources::appendNewline(StringRef newline) {
     if (sealed)
         BUG("Appending to sealed InputSources");
-    contents.back() += newline.toString();
-    contents.push_back("");  // start a new line
+    contents.append(newline.p, newline.len);
+    lineStarts.push_back(contents.size());  // start a new line
 }
 
 void InputSources::appendText(const char* text) {
@@ -146,7 +144,9 @@ cstring InputSources::getLine(unsigned lineNumber) const {
         // don't throw: this code may be called by exceptions
         // reporting on elements that have no source position
     }
-    return contents.at(lineNumber - 1);
+    size_t start = lineStarts.at(lineNumber - 1);
+    size_t end = lineNumber < lineStarts.size() ? lineStarts[lineNumber] : contents.size();
+    return cstring(contents.data() + start, end - start);
 }
 
 void InputSources::mapLine(cstring file, unsigned originalSourceLineNo) {
@@ -177,12 +177,12 @@ SourceFileLine InputSources::getSourceLine(unsigned line) const {
 }
 
 unsigned InputSources::getCurrentLineNumber() const {
-    return contents.size();
+    return lineStarts.size();
 }
 
 SourcePosition InputSources::getCurrentPosition() const {
     unsigned line = getCurrentLineNumber();
-    unsigned column = contents.back().size();
+    unsigned column = contents.size() - lineStarts.back();
     return SourcePosition(line, column);
 }
 
@@ -255,8 +255,7 @@ cstring InputSources::getBriefSourceFragment(const SourceInfo &position) const {
 
 cstring InputSources::toDebugString() const {
     std::stringstream builder;
-    for (auto line : contents)
-        builder << line;
+    builder << contents;
     builder << "---------------" << std::endl;
     for (auto lf : line_file_map)
         builder << lf.first << ": " << lf.second.toString() << std::endl;
@@ -21,6 +21,7 @@ limitations under the License.
 #ifndef P4C_LIB_SOURCE_FILE_H_
 #define P4C_LIB_SOURCE_FILE_H_
 
+#include <string>
 #include <vector>
 
 #include "gtest/gtest_prod.h"
@@ -29,6 +30,8 @@ limitations under the License.
 #include "map.h"
 
 namespace Test { class UtilSourceFile; }
+class BinaryGenerator;
+class BinaryLoader;
 
 class IHasDbPrint {
  public:
@@ -250,6 +253,9 @@ struct SourceFileLine {
 */
 class InputSources final {
     FRIEND_TEST(UtilSourceFile, InputSources);
+    // IR snapshots save and restore the whole input.
+    friend class ::BinaryGenerator;
+    friend class ::BinaryLoader;
 
  public:
     cstring getLine(unsigned lineNumber) const;
@@ -299,8 +305,13 @@ class InputSources final {
     bool sealed;
 
     std::map<unsigned, SourceFileLine> line_file_map;
-    /// Each line also stores the end-of-line character(s)
-    std::vector<cstring> contents;
+    /// All the text read so far, including the end-of-line character(s).
+    /// Lines are appended a token at a time, so they are only turned into
+    /// cstrings when asked for.
+    std::string contents;
+    /// Offset in contents where each line starts; line n is
+    /// [lineStarts[n-1], lineStarts[n]).  Never empty.
+    std::vector<size_t> lineStarts;
 };
 
 }  // namespace Util
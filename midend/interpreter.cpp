@@ -1,4 +1,5 @@
 #include "interpreter.h"
+#include <boost/functional/hash.hpp>
 #include "frontends/common/constantFolding.h"
 #include "frontends/p4/methodInstance.h"
 #include "frontends/p4/coreLibrary.h"
@@ -7,8 +8,27 @@ namespace P4 {
 
 unsigned SymbolicValue::crtid = 0;
 
+size_t ValueMap::hash() const {
+    // The maps compared have the same keys, in the same order.
+    size_t result = 0;
+    for (auto v : map)
+        boost::hash_combine(result, v.second->hash());
+    return result;
+}
+
+// Type nodes are mapped to their Type_Type by type inference; types
+// synthesized when canonicalizing may not be in the map at all.
+static const IR::Type* canonicalType(const TypeMap* typeMap, const IR::Type* type) {
+    auto result = typeMap->getType(type);
+    if (result == nullptr)
+        return type;
+    if (result->is<IR::Type_Type>())
+        return result->to<IR::Type_Type>()->type;
+    return result;
+}
+
 SymbolicValue* SymbolicValueFactory::create(const IR::Type* type, bool uninitialized) const {
-    type = typeMap->getType(type, true);
+    type = canonicalType(typeMap, type);
     if (type->is<IR::Type_Bits>())
         return new SymbolicInteger(ScalarValue::init(uninitialized), type->to<IR::Type_Bits>());
     if (type->is<IR::Type_Boolean>())
@@ -53,7 +73,7 @@ SymbolicValue* SymbolicValueFactory::create(const IR::Type* type, bool uninitial
 }
 
 bool SymbolicValueFactory::isFixedWidth(const IR::Type* type) const {
-    type = typeMap->getType(type, true);
+    type = canonicalType(typeMap, type);
     if (type->is<IR::Type_Varbits>())
         return false;
     if (type->is<IR::Type_Extern>())
@@ -79,7 +99,7 @@ bool SymbolicValueFactory::isFixedWidth(const IR::Type* type) const {
 }
 
 unsigned SymbolicValueFactory::getWidth(const IR::Type* type) const {
-    type = typeMap->getType(type, true);
+    type = canonicalType(typeMap, type);
     if (type->is<IR::Type_Bits>())
         return type->to<IR::Type_Bits>()->size;
     if (type->is<IR::Type_Boolean>())
@@ -153,6 +173,13 @@ bool SymbolicBool::equals(const SymbolicValue* other) const {
     return true;
 }
 
+size_t SymbolicBool::hash() const {
+    size_t result = static_cast<size_t>(state);
+    if (isKnown())
+        boost::hash_combine(result, value);
+    return result;
+}
+
 bool SymbolicInteger::merge(const SymbolicValue* other) {
     BUG_CHECK(other->is<SymbolicInteger>(), "%1%: expected an integer", other);
     auto io = other->to<SymbolicInteger>();
@@ -184,6 +211,13 @@ bool SymbolicInteger::equals(const SymbolicValue* other) const {
     return true;
 }
 
+size_t SymbolicInteger::hash() const {
+    size_t result = static_cast<size_t>(state);
+    if (isKnown())
+        boost::hash_combine(result, mpz_get_ui(constant->value.get_mpz_t()));
+    return result;
+}
+
 bool SymbolicVarbit::merge(const SymbolicValue* other) {
     BUG_CHECK(other->is<SymbolicVarbit>(), "%1%: expected a varbit", other);
     auto vo = other->to<SymbolicVarbit>();
@@ -206,6 +240,9 @@ bool SymbolicVarbit::equals(const SymbolicValue* other) const {
     return state == ab->state;
 }
 
+size_t SymbolicVarbit::hash() const
+{ return static_cast<size_t>(state); }
+
 void SymbolicEnum::assign(const SymbolicValue* other) {
     BUG_CHECK(other->is<SymbolicEnum>(), "%1%: expected an enum", other);
     auto bo = other->to<SymbolicEnum>();
@@ -233,6 +270,13 @@ bool SymbolicEnum::equals(const SymbolicValue* other) const {
     return true;
 }
 
+size_t SymbolicEnum::hash() const {
+    size_t result = static_cast<size_t>(state);
+    if (isKnown())
+        boost::hash_combine(result, value.name.hash());
+    return result;
+}
+
 //////////////////////////////////////////////////////////////////////////////////
 
 SymbolicStruct::SymbolicStruct(const IR::Type_StructLike* type, bool uninitialized,
@@ -246,8 +290,10 @@ SymbolicStruct::SymbolicStruct(const IR::Type_StructLike* type, bool uninitializ
 
 SymbolicValue* SymbolicStruct::clone() const {
     auto result = new SymbolicStruct(type->to<IR::Type_StructLike>());
-    for (auto f : fieldValue)
-        result->fieldValue[f.first] = f.second->clone();
+    for (auto f : fieldValue) {
+        f.second->share();
+        result->fieldValue[f.first] = f.second;
+    }
     return result;
 }
 
@@ -256,7 +302,7 @@ void SymbolicStruct::assign(const SymbolicValue* other) {
     BUG_CHECK(other->is<SymbolicStruct>(), "%1%: expected a struct", other);
     auto sv = other->to<SymbolicStruct>();
     for (auto f : sv->fieldValue)
-        fieldValue[f.first]->assign(f.second);
+        unshare(fieldValue[f.first])->assign(f.second);
 }
 
 bool SymbolicStruct::merge(const SymbolicValue* other) {
@@ -264,25 +310,34 @@ bool SymbolicStruct::merge(const SymbolicValue* other) {
     auto sv = other->to<SymbolicStruct>();
     bool changes = false;
     for (auto f : sv->fieldValue)
-        changes = changes || fieldValue[f.first]->merge(f.second);
+        changes = changes || unshare(fieldValue[f.first])->merge(f.second);
     return changes;
 }
 
 void SymbolicStruct::setAllUnknown() {
     for (auto f : type->to<IR::Type_StructLike>()->fields)
-        fieldValue[f->name.name]->setAllUnknown();
+        unshare(fieldValue[f->name.name])->setAllUnknown();
 }
 
 bool SymbolicStruct::equals(const SymbolicValue* other) const {
     if (!other->is<SymbolicStruct>())
         return false;
     auto sv = other->to<SymbolicStruct>();
-    for (auto f : sv->fieldValue)
-        if (!get(nullptr, f.first)->equals(f.second))
+    for (auto f : sv->fieldValue) {
+        auto v = get(nullptr, f.first);
+        if (v != f.second && !v->equals(f.second))
             return false;
+    }
     return true;
 }
 
+size_t SymbolicStruct::hash() const {
+    size_t result = 0;
+    for (auto f : fieldValue)
+        boost::hash_combine(result, f.second->hash());
+    return result;
+}
+
 bool SymbolicStruct::hasUninitializedParts() const {
     for (auto f : fieldValue)
         if (f.second->hasUninitializedParts())
@@ -324,16 +379,25 @@ SymbolicValue* SymbolicHeader::get(const IR::Node* node, cstring field) const {
     return SymbolicStruct::get(node, field);
 }
 
+SymbolicValue* SymbolicHeader::getWritable(const IR::Node* node, cstring field) {
+    if (valid->isKnown() && !valid->value)
+        return new SymbolicStaticError(node, "Reading field from invalid header");
+    return SymbolicStruct::getWritable(node, field);
+}
+
 void SymbolicHeader::setAllUnknown() {
     SymbolicStruct::setAllUnknown();
-    valid->setAllUnknown();
+    unshare(valid)->setAllUnknown();
 }
 
 SymbolicValue* SymbolicHeader::clone() const {
     auto result = new SymbolicHeader(type->to<IR::Type_Header>());
-    for (auto f : fieldValue)
-        result->fieldValue[f.first] = f.second->clone();
-    result->valid = valid->clone()->to<SymbolicBool>();
+    for (auto f : fieldValue) {
+        f.second->share();
+        result->fieldValue[f.first] = f.second;
+    }
+    valid->share();
+    result->valid = valid;
     return result;
 }
 
@@ -342,8 +406,8 @@ void SymbolicHeader::assign(const SymbolicValue* other) {
     BUG_CHECK(other->is<SymbolicHeader>(), "%1%: expected a header", other);
     auto hv = other->to<SymbolicHeader>();
     for (auto f : hv->fieldValue)
-        fieldValue[f.first]->assign(f.second);
-    valid->assign(hv->valid);
+        unshare(fieldValue[f.first])->assign(f.second);
+    unshare(valid)->assign(hv->valid);
 }
 
 bool SymbolicHeader::merge(const SymbolicValue* other) {
@@ -351,8 +415,8 @@ bool SymbolicHeader::merge(const SymbolicValue* other) {
     auto hv = other->to<SymbolicHeader>();
     bool changes = false;
     for (auto f : hv->fieldValue)
-        changes = changes || fieldValue[f.first]->merge(f.second);
-    changes = changes || valid->merge(hv->valid);
+        changes = changes || unshare(fieldValue[f.first])->merge(f.second);
+    changes = changes || unshare(valid)->merge(hv->valid);
     return changes;
 }
 
@@ -368,6 +432,14 @@ bool SymbolicHeader::equals(const SymbolicValue* other) const {
     return SymbolicStruct::equals(other);
 }
 
+size_t SymbolicHeader::hash() const {
+    size_t result = valid->hash();
+    if (valid->isKnown() && !valid->value)
+        return result;
+    boost::hash_combine(result, SymbolicStruct::hash());
+    return result;
+}
+
 void SymbolicHeader::dbprint(std::ostream& out) const {
     out << "{ ";
     out << "valid=>";
@@ -393,51 +465,59 @@ SymbolicArray::SymbolicArray(const IR::Type_Stack* type, bool uninitialized,
 }
 
 void SymbolicArray::shift(int amount) {
+    // Vacated elements may still be referenced from their new position,
+    // so they are replaced rather than modified.
     if (amount < 0) {
         for (unsigned i = 0; i < values.size() + amount; i++)
             values[i] = values[i - amount];
-        for (unsigned i = values.size() + amount; i < values.size(); i++)
+        for (unsigned i = values.size() + amount; i < values.size(); i++) {
+            values[i] = values[i]->clone()->to<SymbolicHeader>();
             values[i]->setValid(false);
+        }
     } else if (amount > 0) {
         for (unsigned i = 0; i < values.size() - amount; i++)
             values[values.size() - i - 1] = values[values.size() - i - amount - 1];
-        for (unsigned i = 0; i < (unsigned)amount; i++)
+        for (unsigned i = 0; i < (unsigned)amount; i++) {
+            values[i] = values[i]->clone()->to<SymbolicHeader>();
             values[i]->setValid(false);
+        }
     }
 }
 
-SymbolicValue* SymbolicArray::next(const IR::Node* node) {
+SymbolicValue* SymbolicArray::next(const IR::Node* node, bool writable) {
     for (unsigned i = 0; i < values.size(); i++) {
         auto v = values.at(i);
         if (v->valid->isUnknown() || v->valid->isUninitialized())
             return new AnyElement(this);
         if (!v->valid->value)
-            return v;
+            return writable ? unshare(values.at(i)) : v;
     }
     return new SymbolicException(node, P4::StandardExceptions::StackOutOfBounds);
 }
 
-SymbolicValue* SymbolicArray::last(const IR::Node* node) {
+SymbolicValue* SymbolicArray::last(const IR::Node* node, bool writable) {
     for (unsigned i = 0; i < values.size(); i++) {
         unsigned index = values.size() - i - 1;
         auto v = values.at(index);
         if (v->valid->isUnknown() || v->valid->isUninitialized())
             return new AnyElement(this);
         if (v->valid->value)
-            return v;
+            return writable ? unshare(values.at(index)) : v;
     }
     return new SymbolicException(node, P4::StandardExceptions::StackOutOfBounds);
 }
 
 void SymbolicArray::setAllUnknown() {
     for (unsigned i = 0; i < values.size(); i++)
-        values.at(i)->setAllUnknown();
+        unshare(values.at(i))->setAllUnknown();
 }
 
 SymbolicValue* SymbolicArray::clone() const {
     auto result = new SymbolicArray(type->to<IR::Type_Stack>());
-    for (unsigned i=0; i < values.size(); i++)
-        result->values.push_back(get(nullptr, i)->clone()->to<SymbolicHeader>());
+    for (auto v : values) {
+        v->share();
+        result->values.push_back(v);
+    }
     return result;
 }
 
@@ -445,14 +525,15 @@ void SymbolicArray::assign(const SymbolicValue* other) {
     if (other->is<SymbolicError>()) return;
     BUG_CHECK(other->is<SymbolicArray>(), "%1%: expected an array", other);
     for (unsigned i=0; i < values.size(); i++)
-        values.at(i)->assign(other->to<SymbolicArray>()->get(nullptr, i));
+        unshare(values.at(i))->assign(other->to<SymbolicArray>()->get(nullptr, i));
 }
 
 bool SymbolicArray::merge(const SymbolicValue* other) {
     BUG_CHECK(other->is<SymbolicArray>(), "%1%: expected an array", other);
     bool changes = false;
     for (unsigned i=0; i < values.size(); i++)
-        changes = changes || values.at(i)->merge(other->to<SymbolicArray>()->get(nullptr, i));
+        changes = changes ||
+                unshare(values.at(i))->merge(other->to<SymbolicArray>()->get(nullptr, i));
     return changes;
 }
 
@@ -461,12 +542,20 @@ bool SymbolicArray::equals(const SymbolicValue* other) const {
         return false;
     auto sa = other->to<SymbolicArray>();
     for (unsigned i=0; i < values.size(); i++) {
-        if (!values.at(i)->equals(sa->get(nullptr, i)))
+        auto v = sa->get(nullptr, i);
+        if (values.at(i) != v && !values.at(i)->equals(v))
             return false;
     }
     return true;
 }
 
+size_t SymbolicArray::hash() const {
+    size_t result = 0;
+    for (auto v : values)
+        boost::hash_combine(result, v->hash());
+    return result;
+}
+
 bool SymbolicArray::hasUninitializedParts() const {
     for (unsigned i=0; i < values.size(); i++)
         if (values.at(i)->hasUninitializedParts())
@@ -499,6 +588,11 @@ bool AnyElement::equals(const SymbolicValue*) const {
     return true;
 }
 
+size_t AnyElement::hash() const {
+    BUG("Hash should not be called on AnyElement");
+    return 0;
+}
+
 SymbolicValue* AnyElement::collapse() const {
     auto result = parent->get(nullptr, 0)->clone();
     for (size_t i = 1; i < parent->values.size(); i++)
@@ -517,13 +611,15 @@ SymbolicTuple::SymbolicTuple(const IR::Type_Tuple* type, bool uninitialized,
 
 void SymbolicTuple::setAllUnknown() {
     for (unsigned i = 0; i < values.size(); i++)
-        values.at(i)->setAllUnknown();
+        unshare(values.at(i))->setAllUnknown();
 }
 
 SymbolicValue* SymbolicTuple::clone() const {
     auto result = new SymbolicTuple(type->to<IR::Type_Tuple>());
-    for (unsigned i=0; i < values.size(); i++)
-        result->values.push_back(get(i)->clone());
+    for (auto v : values) {
+        v->share();
+        result->values.push_back(v);
+    }
     return result;
 }
 
@@ -533,7 +629,7 @@ bool SymbolicTuple::merge(const SymbolicValue* other) {
     BUG_CHECK(values.size() == tpl->values.size(), "merging tuples with different sizes");
     bool changes = false;
     for (unsigned i=0; i < values.size(); i++)
-        changes = changes || values.at(i)->merge(tpl->get(i));
+        changes = changes || unshare(values.at(i))->merge(tpl->get(i));
     return changes;
 }
 
@@ -547,6 +643,13 @@ bool SymbolicTuple::equals(const SymbolicValue* other) const {
     return true;
 }
 
+size_t SymbolicTuple::hash() const {
+    size_t result = 0;
+    for (auto v : values)
+        boost::hash_combine(result, v->hash());
+    return result;
+}
+
 bool SymbolicTuple::hasUninitializedParts() const {
     for (unsigned i=0; i < values.size(); i++)
         if (values.at(i)->hasUninitializedParts())
@@ -560,6 +663,9 @@ bool SymbolicExtern::equals(const SymbolicValue* other) const {
     return true;
 }
 
+size_t SymbolicExtern::hash() const
+{ return 0; }
+
 bool SymbolicPacketIn::merge(const SymbolicValue* other) {
     BUG_CHECK(other->is<SymbolicPacketIn>(), "%1%: merging with non-packet", other);
     auto pv = other->to<SymbolicPacketIn>();
@@ -581,10 +687,38 @@ bool SymbolicPacketIn::equals(const SymbolicValue* other) const {
     return minimumStreamOffset == sp->minimumStreamOffset;
 }
 
+size_t SymbolicPacketIn::hash() const
+{ return minimumStreamOffset; }
+
 SymbolicVoid* SymbolicVoid::instance = new SymbolicVoid();
 
 /*****************************************************************************************/
 
+const MethodCallDescription*
+EvaluationCache::getCall(const IR::MethodCallExpression* expression) {
+    auto it = calls.find(expression);
+    if (it != calls.end())
+        return it->second;
+    auto result = new MethodCallDescription(expression, refMap, typeMap);
+    calls.emplace(expression, result);
+    return result;
+}
+
+const IR::Node* EvaluationCache::fold(const IR::Operation* operation,
+                                      const IR::Operation* withConstants,
+                                      const mpz_class& left, const mpz_class& right) {
+    auto key = std::make_tuple(operation, left, right);
+    auto it = folded.find(key);
+    if (it != folded.end())
+        return it->second;
+    DoConstantFolding cf(refMap, typeMap);
+    auto result = withConstants->apply(cf);
+    folded.emplace(key, result);
+    return result;
+}
+
+/*****************************************************************************************/
+
 void ExpressionEvaluator::postorder(const IR::Operation_Binary* expression) {
     auto l = get(expression->left);
     if (l->is<SymbolicError>()) {
@@ -612,8 +746,7 @@ void ExpressionEvaluator::postorder(const IR::Operation_Binary* expression) {
     } else if (!li->isUnknown() && !ri->isUnknown()) {
         clone->left = li->constant;
         clone->right = ri->constant;
-        DoConstantFolding cf(refMap, typeMap);
-        auto result = clone->apply(cf);
+        auto result = cache->fold(expression, clone, li->constant->value, ri->constant->value);
         BUG_CHECK(result->is<IR::Constant>(), "%1%: expected a constant", result);
         set(expression, new SymbolicInteger(result->to<IR::Constant>()));
         return;
@@ -645,16 +778,14 @@ void ExpressionEvaluator::postorder(const IR::Operation_Unary* expression) {
     if (l->is<SymbolicInteger>()) {
         auto li = l->to<SymbolicInteger>();
         clone->expr = li->constant;
-        DoConstantFolding cf(refMap, typeMap);
-        auto result = expression->apply(cf);
+        auto result = cache->fold(expression, clone, li->constant->value, 0);
         BUG_CHECK(result->is<IR::Constant>(), "%1%: expected a constant", result);
         set(expression, new SymbolicInteger(result->to<IR::Constant>()));
         return;
     } else if (l->is<SymbolicBool>()) {
         auto li = l->to<SymbolicBool>();
         clone->expr = new IR::BoolLiteral(li->value);
-        DoConstantFolding cf(refMap, typeMap);
-        auto result = expression->apply(cf);
+        auto result = cache->fold(expression, clone, li->value, 0);
         BUG_CHECK(result->is<IR::BoolLiteral>(), "%1%: expected a boolean", result);
         set(expression, new SymbolicBool(result->to<IR::BoolLiteral>()));
         return;
@@ -717,19 +848,21 @@ void ExpressionEvaluator::postorder(const IR::Operation_Relation* expression) {
     auto clone = expression->clone();
     if (l->is<SymbolicInteger>()) {
         BUG_CHECK(r->is<SymbolicInteger>(), "%1%: expected an SymbolicInteger");
-        clone->left = l->to<SymbolicInteger>()->constant;
-        clone->right = r->to<SymbolicInteger>()->constant;
-        DoConstantFolding cf(refMap, typeMap);
-        auto result = expression->apply(cf);
+        auto lc = l->to<SymbolicInteger>()->constant;
+        auto rc = r->to<SymbolicInteger>()->constant;
+        clone->left = lc;
+        clone->right = rc;
+        auto result = cache->fold(expression, clone, lc->value, rc->value);
         BUG_CHECK(result->is<IR::BoolLiteral>(), "%1%: expected a boolean", result);
         set(expression, new SymbolicBool(result->to<IR::BoolLiteral>()));
         return;
     } else if (l->is<SymbolicBool>()) {
         BUG_CHECK(r->is<SymbolicBool>(), "%1%: expected an SymbolicBool");
-        clone->left = new IR::BoolLiteral(l->to<SymbolicBool>()->value);
-        clone->right = new IR::BoolLiteral(r->to<SymbolicBool>()->value);
-        DoConstantFolding cf(refMap, typeMap);
-        auto result = expression->apply(cf);
+        bool lb = l->to<SymbolicBool>()->value;
+        bool rb = r->to<SymbolicBool>()->value;
+        clone->left = new IR::BoolLiteral(lb);
+        clone->right = new IR::BoolLiteral(rb);
+        auto result = cache->fold(expression, clone, lb, rb);
         BUG_CHECK(result->is<IR::BoolLiteral>(), "%1%: expected a boolean", result);
         set(expression, new SymbolicBool(result->to<IR::BoolLiteral>()));
         return;
@@ -755,13 +888,13 @@ void ExpressionEvaluator::postorder(const IR::Member* expression) {
         auto array = l->to<SymbolicArray>();
         SymbolicValue* v;
         if (expression->member.name == IR::Type_Stack::next) {
-            v = array->next(expression);
+            v = array->next(expression, evaluatingLeftValue);
             if (v->is<SymbolicError>()) {
                 set(expression, v);
                 return;
             }
         } else if (expression->member.name == IR::Type_Stack::last) {
-            v = array->last(expression);
+            v = array->last(expression, evaluatingLeftValue);
             if (v->is<SymbolicError>()) {
                 set(expression, v);
                 return;
@@ -772,34 +905,37 @@ void ExpressionEvaluator::postorder(const IR::Member* expression) {
         set(expression, v);
     } else {
         BUG_CHECK(l->is<SymbolicStruct>(), "%1%: expected a struct", l);
-        auto v = l->to<SymbolicStruct>()->get(expression, expression->member.name);
+        auto sv = l->to<SymbolicStruct>();
+        auto v = evaluatingLeftValue ? sv->getWritable(expression, expression->member.name)
+                : sv->get(expression, expression->member.name);
         set(expression, v);
     }
 }
 
 bool ExpressionEvaluator::preorder(const IR::ArrayIndex* expression) {
+    // The array is a left value if the element is; the index never is.
     bool lv = evaluatingLeftValue;
     evaluatingLeftValue = false;
-    visit(expression->left);
-    evaluatingLeftValue = lv;
     visit(expression->right);
+    evaluatingLeftValue = lv;
+    visit(expression->left);
+    postorder(expression);
     return false;  // prune
 }
 
 void ExpressionEvaluator::postorder(const IR::ArrayIndex* expression) {
     auto l = get(expression->left);
     auto r = get(expression->right);
-    auto rv = r->to<ScalarValue>();
-    auto lv = l->to<SymbolicArray>();
-
-    if (lv->is<SymbolicError>()) {
-        set(expression, lv);
+    if (l->is<SymbolicError>()) {
+        set(expression, l);
         return;
     }
-    if (rv->is<SymbolicError>()) {
-        set(expression, rv);
+    if (r->is<SymbolicError>()) {
+        set(expression, r);
         return;
     }
+    auto rv = r->to<ScalarValue>();
+    auto lv = l->to<SymbolicArray>();
     if (rv->isUninitialized() || rv->isUnknown()) {
         if (rv->isUninitialized()) {
             auto result = new SymbolicStaticError(expression->right, "Uninitialized");
@@ -816,7 +952,9 @@ void ExpressionEvaluator::postorder(const IR::ArrayIndex* expression) {
     CHECK_NULL(lv);
     auto ix = r->to<SymbolicInteger>();
     CHECK_NULL(ix);
-    auto result = lv->get(expression, ix->constant->asInt());
+    auto index = ix->constant->asInt();
+    auto result = evaluatingLeftValue ? lv->getWritable(expression, index)
+            : lv->get(expression, index);
     set(expression, result);
 }
 
@@ -826,14 +964,40 @@ void ExpressionEvaluator::postorder(const IR::PathExpression* expression) {
     SymbolicValue* result;
     if (type->is<IR::Type_Error>())
         result = new SymbolicEnum(type, decl->getName());
+    else if (evaluatingLeftValue)
+        result = valueMap->getWritable(decl);
     else
         result = valueMap->get(decl);
     set(expression, result);
 }
 
+bool ExpressionEvaluator::preorder(const IR::MethodCallExpression* expression) {
+    // The objects a call modifies are left values: the header or stack of
+    // the built-in methods other than isValid, and the out and inout
+    // arguments.
+    bool lv = evaluatingLeftValue;
+    auto mcd = cache->getCall(expression);
+    auto bim = mcd->instance->to<BuiltInMethod>();
+    evaluatingLeftValue = bim != nullptr && bim->name.name != IR::Type_Header::isValid;
+    visit(expression->method);
+    for (auto p : *mcd->substitution.getParameters()) {
+        auto arg = mcd->substitution.lookup(p);
+        if (arg == nullptr)
+            continue;
+        evaluatingLeftValue = p->direction == IR::Direction::Out ||
+                p->direction == IR::Direction::InOut;
+        visit(arg);
+    }
+    evaluatingLeftValue = false;
+    visit(expression->arguments);
+    evaluatingLeftValue = lv;
+    postorder(expression);
+    return false;  // prune
+}
+
 void ExpressionEvaluator::postorder(const IR::MethodCallExpression* expression) {
-    MethodCallDescription mcd(expression, refMap, typeMap);
-    auto mi = mcd.instance;
+    auto mcd = cache->getCall(expression);
+    auto mi = mcd->instance;
 
     for (auto arg : *expression->arguments) {
         auto argValue = get(arg);
@@ -930,7 +1094,7 @@ void ExpressionEvaluator::postorder(const IR::MethodCallExpression* expression)
                 }
 
                 auto decl = em->object;
-                auto obj = valueMap->get(decl);
+                auto obj = valueMap->getWritable(decl);
                 CHECK_NULL(obj);
                 if (obj->is<SymbolicError>()) {
                     set(expression, obj);
@@ -961,9 +1125,9 @@ void ExpressionEvaluator::postorder(const IR::MethodCallExpression* expression)
 
     // For all other methods we act conservatively:
     // in arguments are unchanged, and the out arguments have an unknown value.
-    for (auto p : *mcd.substitution.getParameters()) {
+    for (auto p : *mcd->substitution.getParameters()) {
         if (p->direction == IR::Direction::Out || p->direction == IR::Direction::InOut) {
-            auto expr = mcd.substitution.lookup(p);
+            auto expr = mcd->substitution.lookup(p);
             auto val = get(expr);
             val->setAllUnknown();
         }
@@ -973,8 +1137,7 @@ void ExpressionEvaluator::postorder(const IR::MethodCallExpression* expression)
         mi->actualMethodType->returnType->is<IR::Type_Void>()) {
         set(expression, SymbolicVoid::get());
     } else {
-        auto type = typeMap->getType(mi->actualMethodType->returnType, true);
-        auto res = factory->create(type, false);
+        auto res = factory->create(mi->actualMethodType->returnType, false);
         set(expression, res);
     }
 }
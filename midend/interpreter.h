@@ -17,10 +17,12 @@ limitations under the License.
 #ifndef _MIDEND_INTERPRETER_H_
 #define _MIDEND_INTERPRETER_H_
 
+#include <tuple>
 #include "ir/ir.h"
 #include "frontends/common/resolveReferences/referenceMap.h"
 #include "frontends/p4/typeMap.h"
 #include "frontends/p4/coreLibrary.h"
+#include "frontends/p4/methodInstance.h"
 
 // Symbolic P4 program evaluation.
 
@@ -31,6 +33,10 @@ class SymbolicValueFactory;
 // Base class for all abstract values
 class SymbolicValue {
     static unsigned crtid;
+    // True if this value may be referenced from more than one place,
+    // e.g. by a value and its clone.  Shared values are never modified:
+    // whoever holds one replaces it with a private copy first (see unshare).
+    mutable bool shared = false;
 
  protected:
     explicit SymbolicValue(const IR::Type* type) : id(crtid++), type(type) {}
@@ -47,13 +53,23 @@ class SymbolicValue {
         auto result = dynamic_cast<const T*>(this);
         CHECK_NULL(result); return result; }
     template<typename T> bool is() const { return dynamic_cast<const T*>(this) != nullptr; }
+    // Clones of composite values are shallow: the parts become shared
+    // between the original and the clone, and are copied when modified.
     virtual SymbolicValue* clone() const = 0;
+    void share() const { shared = true; }
+    // Replaces v with a private copy if it is shared, so that it can be modified.
+    template<typename T> static T* unshare(T*& v) {
+        if (v->shared)
+            v = v->clone()->template to<T>();
+        return v; }
     virtual void setAllUnknown() = 0;
     virtual void assign(const SymbolicValue* other) = 0;
     // Merging two symbolic values; values should form a lattice.
     // Returns 'true' if merging changed the current value.
     virtual bool merge(const SymbolicValue* other) = 0;
     virtual bool equals(const SymbolicValue* other) const = 0;
+    // Equal values have equal hashes.
+    virtual size_t hash() const = 0;
     // True if some parts of this value are definitely uninitialized
     virtual bool hasUninitializedParts() const = 0;
 };
@@ -78,8 +94,10 @@ class ValueMap final : public IHasDbPrint {
     std::map<const IR::IDeclaration*, SymbolicValue*> map;
     ValueMap* clone() const {
         auto result = new ValueMap();
-        for (auto v : map)
-            result->map.emplace(v.first, v.second->clone());
+        for (auto v : map) {
+            v.second->share();
+            result->map.emplace(v.first, v.second);
+        }
         return result;
     }
     ValueMap* filter(std::function<bool(const IR::IDeclaration*, const SymbolicValue*)> filter) {
@@ -93,6 +111,11 @@ class ValueMap final : public IHasDbPrint {
     { CHECK_NULL(left); CHECK_NULL(right); map[left] = right; }
     SymbolicValue* get(const IR::IDeclaration* left) const
     { CHECK_NULL(left); return ::get(map, left); }
+    // Like get, but the result may be modified.
+    SymbolicValue* getWritable(const IR::IDeclaration* left) {
+        CHECK_NULL(left);
+        auto it = map.find(left);
+        return it == map.end() ? nullptr : SymbolicValue::unshare(it->second); }
 
     void dbprint(std::ostream& out) const {
         bool first = true;
@@ -106,10 +129,10 @@ class ValueMap final : public IHasDbPrint {
     bool merge(const ValueMap* other) {
         bool change = false;
         BUG_CHECK(map.size() == other->map.size(), "Merging incompatible maps?");
-        for (auto d : map) {
+        for (auto &d : map) {
             auto v = other->get(d.first);
             CHECK_NULL(v);
-            change = change || d.second->merge(v);
+            change = change || SymbolicValue::unshare(d.second)->merge(v);
         }
         return change;
     }
@@ -118,17 +141,44 @@ class ValueMap final : public IHasDbPrint {
         for (auto v : map) {
             auto ov = other->get(v.first);
             CHECK_NULL(ov);
-            if (!v.second->equals(ov))
+            if (v.second != ov && !v.second->equals(ov))
                 return false;
         }
         return true;
     }
+    // Maps that are equal have equal hashes.
+    size_t hash() const;
+};
+
+// Everything ExpressionEvaluator computes that does not depend on the
+// values of variables.  Sharing one cache between the evaluators for a
+// program fragment that is evaluated repeatedly (e.g., the states of a
+// parser being unrolled) avoids recomputing it on each evaluation.
+class EvaluationCache {
+    ReferenceMap* refMap;
+    TypeMap*      typeMap;
+    std::map<const IR::MethodCallExpression*, const MethodCallDescription*> calls;
+    // Constant folding results for an operation with the given operand values.
+    std::map<std::tuple<const IR::Operation*, mpz_class, mpz_class>,
+             const IR::Node*> folded;
+
+ public:
+    const SymbolicValueFactory* factory;
+    EvaluationCache(ReferenceMap* refMap, TypeMap* typeMap) :
+            refMap(refMap), typeMap(typeMap), factory(new SymbolicValueFactory(typeMap))
+    { CHECK_NULL(refMap); CHECK_NULL(typeMap); }
+    const MethodCallDescription* getCall(const IR::MethodCallExpression* expression);
+    // Folds operation, whose operands have been replaced in withConstants
+    // by the constants left and right (1/0 for booleans; 0 if absent).
+    const IR::Node* fold(const IR::Operation* operation, const IR::Operation* withConstants,
+                         const mpz_class& left, const mpz_class& right);
 };
 
 class ExpressionEvaluator : public Inspector {
     ReferenceMap*       refMap;
     TypeMap*            typeMap;  // updated if constant folding happens
     ValueMap*           valueMap;
+    EvaluationCache*    cache;
     const SymbolicValueFactory* factory;
     bool evaluatingLeftValue = false;
 
@@ -151,13 +201,18 @@ class ExpressionEvaluator : public Inspector {
     bool preorder(const IR::ArrayIndex* expression) override;
     void postorder(const IR::ArrayIndex* expression) override;
     void postorder(const IR::ListExpression* expression) override;
+    bool preorder(const IR::MethodCallExpression* expression) override;
     void postorder(const IR::MethodCallExpression* expression) override;
 
  public:
-    ExpressionEvaluator(ReferenceMap* refMap, TypeMap* typeMap, ValueMap* valueMap) :
-            refMap(refMap), typeMap(typeMap), valueMap(valueMap) {
+    // If cache is nullptr the evaluator uses a private one.
+    ExpressionEvaluator(ReferenceMap* refMap, TypeMap* typeMap, ValueMap* valueMap,
+                        EvaluationCache* cache = nullptr) :
+            refMap(refMap), typeMap(typeMap), valueMap(valueMap), cache(cache) {
         CHECK_NULL(refMap); CHECK_NULL(typeMap); CHECK_NULL(valueMap);
-        factory = new SymbolicValueFactory(typeMap);
+        if (this->cache == nullptr)
+            this->cache = new EvaluationCache(refMap, typeMap);
+        factory = this->cache->factory;
     }
 
     // May mutate the valueMap, when evaluating expression with side-effects.
@@ -181,6 +236,7 @@ class SymbolicError : public SymbolicValue {
     virtual cstring message() const = 0;
     bool hasUninitializedParts() const override
     { return false; }
+    size_t hash() const override { return 0; }
 };
 
 class SymbolicException : public SymbolicError {
@@ -266,6 +322,7 @@ class SymbolicVoid : public SymbolicValue {
     { BUG_CHECK(other->is<SymbolicVoid>(), "%1%: expected void", other); return false; }
     bool equals(const SymbolicValue* other) const override
     { return other == instance; }
+    size_t hash() const override { return 0; }
     bool hasUninitializedParts() const override
     { return false; }
 };
@@ -296,6 +353,7 @@ class SymbolicBool final : public ScalarValue {
     void assign(const SymbolicValue* other) override;
     bool merge(const SymbolicValue* other) override;
     bool equals(const SymbolicValue* other) const override;
+    size_t hash() const override;
 };
 
 class SymbolicInteger final : public ScalarValue {
@@ -322,6 +380,7 @@ class SymbolicInteger final : public ScalarValue {
     void assign(const SymbolicValue* other) override;
     bool merge(const SymbolicValue* other) override;
     bool equals(const SymbolicValue* other) const override;
+    size_t hash() const override;
 };
 
 class SymbolicVarbit final : public ScalarValue {
@@ -338,6 +397,7 @@ class SymbolicVarbit final : public ScalarValue {
     void assign(const SymbolicValue* other) override;
     bool merge(const SymbolicValue* other) override;
     bool equals(const SymbolicValue* other) const override;
+    size_t hash() const override;
 };
 
 // represents enum, error, and match_kind
@@ -360,6 +420,7 @@ class SymbolicEnum final : public ScalarValue {
     void assign(const SymbolicValue* other) override;
     bool merge(const SymbolicValue* other) override;
     bool equals(const SymbolicValue* other) const override;
+    size_t hash() const override;
 };
 
 class SymbolicStruct : public SymbolicValue {
@@ -376,6 +437,12 @@ class SymbolicStruct : public SymbolicValue {
         CHECK_NULL(r);
         return r;
     }
+    // Like get, but the result may be modified.
+    virtual SymbolicValue* getWritable(const IR::Node*, cstring field) {
+        auto it = fieldValue.find(field);
+        BUG_CHECK(it != fieldValue.end(), "%1%: no such field", field);
+        return unshare(it->second);
+    }
     void set(cstring field, SymbolicValue* value) {
         CHECK_NULL(value);
         fieldValue[field] = value;
@@ -387,6 +454,7 @@ class SymbolicStruct : public SymbolicValue {
     void assign(const SymbolicValue* other) override;
     bool merge(const SymbolicValue* other) override;
     bool equals(const SymbolicValue* other) const override;
+    size_t hash() const override;
     bool hasUninitializedParts() const override;
 };
 
@@ -399,11 +467,13 @@ class SymbolicHeader : public SymbolicStruct {
     virtual void setValid(bool v);
     SymbolicValue* clone() const override;
     SymbolicValue* get(const IR::Node* node, cstring field) const override;
+    SymbolicValue* getWritable(const IR::Node* node, cstring field) override;
     void setAllUnknown() override;
     void assign(const SymbolicValue* other) override;
     void dbprint(std::ostream& out) const override;
     bool merge(const SymbolicValue* other) override;
     bool equals(const SymbolicValue* other) const override;
+    size_t hash() const override;
 };
 
 class SymbolicArray final : public SymbolicValue {
@@ -423,6 +493,12 @@ class SymbolicArray final : public SymbolicValue {
             return new SymbolicStaticError(node, "Out of bounds");
         return values.at(index);
     }
+    // Like get, but the result may be modified.
+    SymbolicValue* getWritable(const IR::Node* node, size_t index) {
+        if (index >= values.size())
+            return new SymbolicStaticError(node, "Out of bounds");
+        return unshare(values.at(index));
+    }
     void shift(int amount);  // negative = shift left
     void set(size_t index, SymbolicHeader* value) {
         CHECK_NULL(value);
@@ -430,13 +506,15 @@ class SymbolicArray final : public SymbolicValue {
     }
     void dbprint(std::ostream& out) const override;
     SymbolicValue* clone() const override;
-    SymbolicValue* next(const IR::Node* node);
-    SymbolicValue* last(const IR::Node* node);
+    // The elements next and last refer to; they may be modified if writable.
+    SymbolicValue* next(const IR::Node* node, bool writable);
+    SymbolicValue* last(const IR::Node* node, bool writable);
     bool isScalar() const override { return false; }
     void setAllUnknown() override;
     void assign(const SymbolicValue* other) override;
     bool merge(const SymbolicValue* other) override;
     bool equals(const SymbolicValue* other) const override;
+    size_t hash() const override;
     bool hasUninitializedParts() const override;
 };
 
@@ -458,6 +536,7 @@ class AnyElement final : public SymbolicHeader {
     void setValid(bool) override { parent->setAllUnknown(); }
     bool merge(const SymbolicValue* other) override;
     bool equals(const SymbolicValue* other) const override;
+    size_t hash() const override;
     SymbolicValue* collapse() const;
     bool hasUninitializedParts() const override
     { BUG("Should not be called"); }
@@ -490,6 +569,7 @@ class SymbolicTuple final : public SymbolicValue {
     { values.push_back(value); }
     bool merge(const SymbolicValue* other) override;
     bool equals(const SymbolicValue* other) const override;
+    size_t hash() const override;
     bool hasUninitializedParts() const override;
 };
 
@@ -510,6 +590,7 @@ class SymbolicExtern : public SymbolicValue {
     { BUG("%1%: extern is read-only", this); }
     bool merge(const SymbolicValue*) override { return false; }
     bool equals(const SymbolicValue* other) const override;
+    size_t hash() const override;
     bool hasUninitializedParts() const override
     { return false; }
 };
@@ -545,6 +626,7 @@ class SymbolicPacketIn final : public SymbolicExtern {
     { minimumStreamOffset += width; }
     bool merge(const SymbolicValue* other) override;
     bool equals(const SymbolicValue* other) const override;
+    size_t hash() const override;
 };
 
 }  // namespace P4
@@ -1,4 +1,5 @@
 #include "parserUnroll.h"
+#include <unordered_map>
 #include "lib/stringify.h"
 
 namespace P4 {
@@ -47,13 +48,25 @@ class ParserSymbolicInterpreter {
     const IR::P4Parser* parser;
     ReferenceMap*       refMap;
     TypeMap*            typeMap;
-    SymbolicValueFactory* factory;
+    const SymbolicValueFactory* factory;
+    EvaluationCache*    cache;  // shared by all evaluations of this parser
     ParserInfo*         synthesizedParser;  // output produced
     bool                unroll;
+    unsigned            maxStates;  // bound on the number of states evaluated
+    // For each original state the values it has been evaluated with, by hash.
+    std::map<const IR::ParserState*,
+             std::unordered_multimap<size_t, const ValueMap*>> explored;
+    // The worklist is a stack, so the states are evaluated depth-first:
+    // this is the chain of predecessors of the state evaluated, and for
+    // each original state the states on it produced from it.
+    std::vector<const ParserStateInfo*> path;
+    std::map<const IR::ParserState*, std::vector<const ParserStateInfo*>> onPath;
+    unsigned            evaluated = 0;  // statistics
+    unsigned            equivalent = 0;
 
     ValueMap* initializeVariables() {
         ValueMap* result = new ValueMap();
-        ExpressionEvaluator ev(refMap, typeMap, result);
+        ExpressionEvaluator ev(refMap, typeMap, result, cache);
 
         for (auto p : parser->getApplyParameters()->parameters) {
             auto type = typeMap->getType(p);
@@ -73,6 +86,9 @@ class ParserSymbolicInterpreter {
                 if (dv->initializer != nullptr)
                     value = ev.evaluate(dv->initializer, false);
             }
+            // The value of an initializer may be that of another declaration.
+            if (value != nullptr)
+                value->share();
 
             if (value == nullptr)
                 value = factory->create(type, true);
@@ -92,7 +108,11 @@ class ParserSymbolicInterpreter {
             stateName == IR::ParserState::reject)
             return nullptr;
         auto state = structure->get(stateName);
-        auto pi = new ParserStateInfo(stateName, parser, state, predecessor, values->clone());
+        // The predecessor is the last state on the path.
+        auto &clones = onPath[state];
+        auto previous = clones.empty() ? nullptr : clones.back();
+        auto pi = new ParserStateInfo(stateName, parser, state, predecessor, previous,
+                                      values->clone());
         synthesizedParser->add(pi);
         return pi;
     }
@@ -118,18 +138,7 @@ class ParserSymbolicInterpreter {
         if (value->is<SymbolicException>()) {
             auto exc = value->to<SymbolicException>();
 
-            bool stateClone = false;
-            auto orig = state->state;
-            auto crt = state;
-            while (crt->predecessor != nullptr) {
-                crt = crt->predecessor;
-                if (crt->state == orig) {
-                    stateClone = true;
-                    break;
-                }
-            }
-
-            if (!stateClone)
+            if (state->previous == nullptr)
                 // errors in the original state are signalled
                 ::error("%1%: error %2% will be triggered\n%3%",
                         exc->errorPosition, exc->message(), stateChain(state));
@@ -149,7 +158,7 @@ class ParserSymbolicInterpreter {
     // and 'false' if an error occurred.
     bool executeStatement(const ParserStateInfo* state, const IR::StatOrDecl* sord,
                           ValueMap* valueMap) const {
-        ExpressionEvaluator ev(refMap, typeMap, valueMap);
+        ExpressionEvaluator ev(refMap, typeMap, valueMap, cache);
 
         bool success = true;
         if (sord->is<IR::AssignmentStatement>()) {
@@ -248,47 +257,64 @@ class ParserSymbolicInterpreter {
 
     // Return true if we have detected a loop we cannot unroll
     bool checkLoops(ParserStateInfo* state) const {
-        const ParserStateInfo* crt = state;
-        while (true) {
-            crt = crt->predecessor;
-            if (crt == nullptr)
-                break;
-            if (crt->state == state->state) {
-                // Loop detected.
-                // Check if any packet in the valueMap has changed
-                auto filter = [](const IR::IDeclaration*, const SymbolicValue* value)
-                        { return value->is<SymbolicPacketIn>(); };
-                auto packets = state->before->filter(filter);
-                auto prevPackets = crt->before->filter(filter);
-                if (packets->equals(prevPackets)) {
-                    bool conservative = false;
-                    for (auto p : state->before->map) {
-                        auto pkt = p.second->to<SymbolicPacketIn>();
-                        if (pkt->isConservative()) {
-                            conservative = true;
-                            break;
-                        }
-                    }
-
-                    if (conservative)
-                        ::warning("Potential parser cycle without extracting any bytes:\n%1%",
-                                  stateChain(state));
-                    else
-                        ::error("Parser cycle without extracting any bytes:\n%1%",
-                                stateChain(state));
-                    return true;
-                }
-
-                // If no header validity has changed we can't really unroll
-                if (!headerValidityChange(crt->before, state->before)) {
-                    if (unroll)
-                        ::error("Parser cycle cannot be unrolled:\n%1%",
-                                stateChain(state));
-                    return true;
+        auto crt = state->previous;
+        if (crt == nullptr)
+            return false;
+        // Loop detected.
+        // Check if any packet in the valueMap has changed
+        auto filter = [](const IR::IDeclaration*, const SymbolicValue* value)
+                { return value->is<SymbolicPacketIn>(); };
+        auto packets = state->before->filter(filter);
+        auto prevPackets = crt->before->filter(filter);
+        if (packets->equals(prevPackets)) {
+            bool conservative = false;
+            for (auto p : state->before->map) {
+                auto pkt = p.second->to<SymbolicPacketIn>();
+                if (pkt->isConservative()) {
+                    conservative = true;
+                    break;
                 }
-                break;
             }
+
+            if (conservative)
+                ::warning("Potential parser cycle without extracting any bytes:\n%1%",
+                          stateChain(state));
+            else
+                ::error("Parser cycle without extracting any bytes:\n%1%",
+                        stateChain(state));
+            return true;
         }
+
+        // If no header validity has changed we can't really unroll
+        if (!headerValidityChange(crt->before, state->before)) {
+            if (unroll)
+                ::error("Parser cycle cannot be unrolled:\n%1%",
+                        stateChain(state));
+            return true;
+        }
+        return false;
+    }
+
+    // Makes state the last state on the path.
+    void enter(const ParserStateInfo* state) {
+        while (!path.empty() && path.back() != state->predecessor) {
+            onPath[path.back()->state].pop_back();
+            path.pop_back();
+        }
+        path.push_back(state);
+        onPath[state->state].push_back(state);
+    }
+
+    // True if the state has already been evaluated with equal values:
+    // the evaluation is deterministic, so its successors are known too.
+    bool alreadyExplored(const ParserStateInfo* state) {
+        auto &seen = explored[state->state];
+        auto hash = state->before->hash();
+        auto range = seen.equal_range(hash);
+        for (auto it = range.first; it != range.second; ++it)
+            if (it->second->equals(state->before))
+                return true;
+        seen.emplace(hash, state->before);
         return false;
     }
 
@@ -307,11 +333,12 @@ class ParserSymbolicInterpreter {
 
  public:
     ParserSymbolicInterpreter(ParserStructure* structure, ReferenceMap* refMap,
-                              TypeMap* typeMap, bool unroll)
+                              TypeMap* typeMap, bool unroll, unsigned maxStates)
             : structure(structure), refMap(refMap), typeMap(typeMap),
-              synthesizedParser(nullptr), unroll(unroll) {
+              synthesizedParser(nullptr), unroll(unroll), maxStates(maxStates) {
         CHECK_NULL(structure); CHECK_NULL(refMap); CHECK_NULL(typeMap);
-        factory = new SymbolicValueFactory(typeMap);
+        cache = new EvaluationCache(refMap, typeMap);
+        factory = cache->factory;
         parser = structure->parser;
     }
 
@@ -329,10 +356,24 @@ class ParserSymbolicInterpreter {
             auto stateInfo = toRun.back();
             toRun.pop_back();
             LOG1("Symbolic evaluation of " << stateChain(stateInfo));
+            enter(stateInfo);
             bool infLoop = checkLoops(stateInfo);
             if (infLoop)
                 // don't evaluate successors anymore
                 continue;
+            if (alreadyExplored(stateInfo)) {
+                LOG1("Equivalent state already evaluated");
+                equivalent++;
+                continue;
+            }
+            if (++evaluated > maxStates) {
+                if (unroll)
+                    ::error("%1%: parser exceeds %2% states when unrolled", parser, maxStates);
+                else
+                    ::error("%1%: the analysis of the parser exceeds %2% states",
+                            parser, maxStates);
+                break;
+            }
             auto nextStates = evaluateState(stateInfo);
             if (nextStates == nullptr) {
                 LOG1("No next states");
@@ -341,13 +382,16 @@ class ParserSymbolicInterpreter {
             toRun.insert(toRun.end(), nextStates->begin(), nextStates->end());
         }
 
+        LOG1("Parser " << parser->externalName() << ": evaluated " << evaluated <<
+             " states, skipped " << equivalent << " equivalent states");
         return synthesizedParser;
     }
 };
 }  // namespace ParserStructureImpl
 
-void ParserStructure::analyze(ReferenceMap* refMap, TypeMap* typeMap, bool unroll) {
-    ParserStructureImpl::ParserSymbolicInterpreter psi(this, refMap, typeMap, unroll);
+void ParserStructure::analyze(ReferenceMap* refMap, TypeMap* typeMap, bool unroll,
+                              unsigned maxStates) {
+    ParserStructureImpl::ParserSymbolicInterpreter psi(this, refMap, typeMap, unroll, maxStates);
     result = psi.run();
 }
 
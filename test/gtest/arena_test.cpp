@@ -0,0 +1,62 @@
+/*
+Copyright 2013-present Barefoot Networks, Inc.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include "gtest/gtest.h"
+#include "config.h"
+#include "ir/ir.h"
+#include "lib/arena.h"
+
+namespace Test {
+
+TEST(Arena, Allocate) {
+    Arena arena;
+    auto *a = static_cast<char *>(arena.allocate(3));
+    auto *b = static_cast<char *>(arena.allocate(8));
+    EXPECT_EQ(a + alignof(std::max_align_t), b);
+    EXPECT_EQ(2 * alignof(std::max_align_t), arena.size());
+    arena.reset();
+    EXPECT_EQ(0u, arena.size());
+}
+
+TEST(Arena, Scope) {
+    Arena outer, inner;
+    EXPECT_EQ(nullptr, Arena::current());
+    {
+        Arena::Scope s1(&outer);
+        {
+            Arena::Scope s2(&inner);
+#if HAVE_LIBGC
+            EXPECT_EQ(&inner, Arena::current());
+            auto *c = new IR::Constant(5);
+            EXPECT_EQ(5, c->asInt());
+            EXPECT_LT(0u, inner.size());
+            EXPECT_EQ(0u, outer.size());
+#else
+            EXPECT_EQ(nullptr, Arena::current());
+#endif
+        }
+        {
+            Arena::Scope none(nullptr);
+            EXPECT_EQ(nullptr, Arena::current());
+        }
+#if HAVE_LIBGC
+        EXPECT_EQ(&outer, Arena::current());
+#endif
+    }
+    EXPECT_EQ(nullptr, Arena::current());
+}
+
+}  // namespace Test
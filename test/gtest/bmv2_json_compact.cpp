@@ -0,0 +1,114 @@
+/*
+Copyright 2013-present Barefoot Networks, Inc.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include <sstream>
+#include <string>
+
+#include "gtest/gtest.h"
+#include "backends/bmv2/backend.h"
+#include "backends/bmv2/midend.h"
+#include "backends/bmv2/options.h"
+#include "frontends/common/parseInput.h"
+#include "frontends/p4/frontend.h"
+#include "helpers.h"
+#include "ir/ir.h"
+#include "lib/error.h"
+
+namespace BMV2 {
+
+namespace {
+
+/// @returns the JSON text @json without the whitespace between its tokens.
+std::string withoutSpaces(const std::string& json) {
+    std::string result;
+    bool inString = false;
+    for (size_t i = 0; i < json.size(); ++i) {
+        char c = json[i];
+        if (inString) {
+            result += c;
+            if (c == '\\' && i + 1 < json.size())
+                result += json[++i];
+            else if (c == '"')
+                inString = false;
+        } else if (c == '"') {
+            inString = true;
+            result += c;
+        } else if (!isspace(static_cast<unsigned char>(c))) {
+            result += c;
+        }
+    }
+    return result;
+}
+
+}  // namespace
+
+// Compile a program through the whole BMv2 back end, and write its json
+// both indented and with --json-compact.
+TEST(BMV2_JsonCompact, SameJsonWithoutWhitespace) {
+    auto source = P4_SOURCE(P4Headers::V1MODEL, R"(
+        header h_t { bit<8> f; bit<8> g; }
+        struct headers { h_t h; }
+        struct metadata { }
+        parser p(packet_in pkt, out headers hdr, inout metadata meta,
+                 inout standard_metadata_t sm) {
+            state start { pkt.extract(hdr.h); transition accept; }
+        }
+        control vc(inout headers hdr, inout metadata meta) { apply { } }
+        control ing(inout headers hdr, inout metadata meta,
+                    inout standard_metadata_t sm) {
+            action set(bit<9> port) { sm.egress_spec = port; hdr.h.g = 8w1; }
+            action drop() { mark_to_drop(); }
+            table t {
+                key = { hdr.h.f : exact; }
+                actions = { set; drop; }
+                default_action = drop();
+            }
+            apply { t.apply(); }
+        }
+        control eg(inout headers hdr, inout metadata meta,
+                   inout standard_metadata_t sm) { apply { } }
+        control ck(inout headers hdr, inout metadata meta) { apply { } }
+        control dp(packet_out pkt, in headers hdr) { apply { pkt.emit(hdr.h); } }
+        V1Switch(p(), vc(), ing(), eg(), ck(), dp()) main;
+    )");
+
+    BMV2Options options;
+    options.langVersion = CompilerOptions::FrontendVersion::P4_16;
+    options.file = "json-compact.p4";
+    auto program = P4::parseP4String(source, options.langVersion);
+    ASSERT_TRUE(program != nullptr);
+    program = P4::FrontEnd().run(options, program);
+    ASSERT_TRUE(program != nullptr);
+    ASSERT_EQ(0u, ::errorCount());
+
+    MidEnd midEnd(options);
+    auto toplevel = midEnd.process(program);
+    ASSERT_TRUE(toplevel != nullptr);
+    ASSERT_EQ(0u, ::errorCount());
+    Backend backend(options.isv1(), &midEnd.refMap, &midEnd.typeMap, &midEnd.enumMap);
+    backend.process(toplevel, options);
+    backend.convert(options);
+    ASSERT_EQ(0u, ::errorCount());
+
+    std::stringstream indented, compact;
+    backend.serialize(indented);
+    backend.serialize(compact, true);
+    EXPECT_NE(std::string::npos, indented.str().find('\n'));
+    EXPECT_EQ(withoutSpaces(indented.str()), compact.str());
+    EXPECT_NE(std::string::npos, compact.str().find("\"tables\":[{"));
+}
+
+}  // namespace BMV2
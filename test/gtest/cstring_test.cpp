@@ -0,0 +1,51 @@
+/*
+Copyright 2013-present Barefoot Networks, Inc.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include <string>
+#include <vector>
+#include "gtest/gtest.h"
+#include "lib/cstring.h"
+
+namespace Test {
+
+TEST(cstring, Intern) {
+    cstring a = "hdr.ethernet";
+    cstring b = std::string("hdr.") + "ethernet";
+    EXPECT_EQ(a.c_str(), b.c_str());
+    EXPECT_EQ(a.hash(), b.hash());
+    EXPECT_NE(a, cstring("hdr.ipv4"));
+
+    // Many strings, to exercise all levels of the intern table
+    std::vector<cstring> strings;
+    for (int i = 0; i < 100000; i++)
+        strings.push_back(cstring::to_cstring(i));
+    for (int i = 0; i < 100000; i++)
+        EXPECT_EQ(strings[i].c_str(), cstring::to_cstring(i).c_str());
+}
+
+TEST(cstring, Size) {
+    EXPECT_EQ(0u, cstring().size());
+    EXPECT_EQ(0u, cstring::empty.size());
+    EXPECT_EQ(5u, cstring("hello").size());
+    cstring s = "abc";
+    s += "def";
+    EXPECT_EQ(6u, s.size());
+    EXPECT_EQ(cstring("cd"), s.substr(2, 2));
+    EXPECT_TRUE(s.endsWith("def"));
+    EXPECT_EQ(cstring::hash("abcdef", 6), s.hash());
+}
+
+}  // namespace Test
@@ -17,7 +17,10 @@ limitations under the License.
 #include <iostream>
 
 #include "gtest/gtest.h"
+#include "helpers.h"
+#include "frontends/common/parseInput.h"
 #include "ir/ir.h"
+#include "ir/binary_loader.h"
 #include "ir/json_loader.h"
 #include "ir/visitor.h"
 
@@ -36,3 +39,60 @@ TEST(IR, DumpJSON) {
     loader >> e2;
     JSONGenerator(std::cout) << e2 << std::endl;
 }
+
+TEST(IR, DumpBinary) {
+    auto c = new IR::Constant(-12345678901234567LL);
+    auto e1 = new IR::Add(Util::SourceInfo(), c, c);
+
+    std::stringstream ss;
+    BinaryGenerator(ss) << static_cast<const IR::Node *>(e1);
+    std::string data = ss.str();
+
+    const IR::Node* e2 = nullptr;
+    BinaryLoader(data.data(), data.size()) >> e2;
+    auto add = e2->to<IR::Add>();
+    ASSERT_NE(add, nullptr);
+    EXPECT_EQ(add->left, add->right);  // sharing is preserved
+    EXPECT_EQ(add->id, e1->id);
+    EXPECT_EQ(add->left->to<IR::Constant>()->value, c->value);
+
+    const IR::Node* e3 = nullptr;
+    EXPECT_THROW(BinaryLoader(data.data(), data.size() - 1) >> e3, Util::CompilationError);
+}
+
+TEST(IR, DumpBinaryProgram) {
+    std::string source = P4_SOURCE(P4Headers::V1MODEL, R"(
+        header H { bit<8> f; bit<16> g; }
+        struct Headers { H h; H[2] stack; }
+        struct Meta {}
+        parser p(packet_in pkt, out Headers hdr, inout Meta m, inout standard_metadata_t sm) {
+            state start { pkt.extract(hdr.h); transition select(hdr.h.f) {
+                8w1 &&& 8w1: accept;
+                default: reject; } }
+        }
+        control c(inout Headers hdr, inout Meta m, inout standard_metadata_t sm) {
+            action a(bit<16> v) { hdr.h.g = v + 16w1; }
+            table t { key = { hdr.h.f : exact; } actions = { a; } }
+            apply { if (hdr.h.isValid()) t.apply(); }
+        }
+    )");
+    auto program = P4::parseP4String(source, CompilerOptions::FrontendVersion::P4_16);
+    ASSERT_NE(program, nullptr);
+
+    std::stringstream ss;
+    BinaryGenerator(ss) << static_cast<const IR::Node *>(program);
+    std::string data = ss.str();
+
+    const IR::P4Program* loaded = nullptr;
+    BinaryLoader loader(data.data(), data.size());
+    loader >> loaded;
+    ASSERT_NE(loaded, nullptr);
+    EXPECT_TRUE(loader.done());
+
+    // Node ids are preserved, so both programs have the same JSON dump.
+    std::stringstream json, loadedJson;
+    JSONGenerator(json) << static_cast<const IR::Node *>(program);
+    JSONGenerator(loadedJson) << static_cast<const IR::Node *>(loaded);
+    EXPECT_EQ(json.str(), loadedJson.str());
+    EXPECT_EQ(program->objects.size(), loaded->objects.size());
+}
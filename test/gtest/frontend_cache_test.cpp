@@ -0,0 +1,219 @@
+/*
+Copyright 2013-present Barefoot Networks, Inc.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include <dirent.h>
+#include <unistd.h>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "helpers.h"
+#include "ir/ir.h"
+#include "frontends/common/options.h"
+#include "frontends/common/parseInput.h"
+#include "frontends/p4/frontend.h"
+#include "frontends/p4/toP4/toP4.h"
+#include "lib/error.h"
+
+namespace P4 {
+
+namespace {
+
+const char* program = R"(control c(inout bit<8> x) { apply { x = x + 1; } }
+control proto(inout bit<8> x);
+package top(proto p);
+top(c()) main;
+)";
+
+// x may be uninitialized
+const char* programWithWarning = R"(control c(out bit<8> y) { apply { bit<8> x; y = x; } }
+control proto(out bit<8> y);
+package top(proto p);
+top(c()) main;
+)";
+
+class FrontendCacheTest : public ::Test::TempDirTest {
+ protected:
+    void SetUp() override {
+        ASSERT_NO_FATAL_FAILURE(TempDirTest::SetUp());
+        makeDir("cache");
+        write("main.p4", program);
+    }
+
+    struct Result {
+        const IR::P4Program* program;
+        bool hit;        // the front end output was read from the cache
+        std::string p4;  // the front end output
+    };
+
+    /// Runs the front end on main.p4 with the front end cache, and with
+    /// the additional command line arguments @args.
+    Result compile(std::vector<const char*> args = {}) {
+        std::string cache = dir + "/cache";
+        std::vector<const char*> argv = { "p4test", "--p4v", "16", "--builtin-cpp",
+                                          "--frontend-cache", cache.c_str() };
+        argv.insert(argv.end(), args.begin(), args.end());
+        CompilerOptions options;
+        options.process(argv.size(), const_cast<char* const*>(argv.data()));
+        options.file = dir + "/main.p4";
+        clearErrorReporter();
+
+        Result result;
+        result.program = FrontEnd().run(options, parseP4File(options));
+        result.hit = options.loadBinaryFile != nullptr;
+        if (result.program != nullptr) {
+            std::stringstream out;
+            ToP4 top4(&out, false);
+            result.program->apply(top4);
+            result.p4 = out.str();
+        }
+        return result;
+    }
+
+    /// @returns the front end cache entries.
+    std::vector<std::string> entries() {
+        std::vector<std::string> result;
+        std::string cache = dir + "/cache";
+        DIR* d = opendir(cache.c_str());
+        while (auto entry = readdir(d)) {
+            std::string name = entry->d_name;
+            if (name.size() > 5 && name.compare(name.size() - 5, 5, ".p4ir") == 0)
+                result.push_back(cache + "/" + name);
+        }
+        closedir(d);
+        return result;
+    }
+};
+
+}  // namespace
+
+TEST_F(FrontendCacheTest, Hit) {
+    auto first = compile();
+    ASSERT_NE(first.program, nullptr);
+    EXPECT_FALSE(first.hit);
+    EXPECT_EQ(entries().size(), 1u);
+
+    auto second = compile();
+    ASSERT_NE(second.program, nullptr);
+    EXPECT_TRUE(second.hit);
+    EXPECT_EQ(::errorCount(), 0u);
+    EXPECT_EQ(first.p4, second.p4);
+    EXPECT_EQ(entries().size(), 1u);
+}
+
+// Options that do not change the preprocessed program or the front end,
+// like those of another target, reuse its output.
+TEST_F(FrontendCacheTest, HitWithOtherTargetOptions) {
+    auto first = compile();
+    ASSERT_NE(first.program, nullptr);
+    std::string include = "-I" + makeDir("include");
+    std::string out = dir + "/out.json";
+    std::string p4runtime = dir + "/p4info.bin";
+    auto other = compile({ "-DUNUSED", include.c_str(), "--target", "other",
+                           "-o", out.c_str(), "--p4runtime-file", p4runtime.c_str() });
+    ASSERT_NE(other.program, nullptr);
+    EXPECT_TRUE(other.hit);
+    EXPECT_EQ(first.p4, other.p4);
+    EXPECT_EQ(entries().size(), 1u);
+}
+
+TEST_F(FrontendCacheTest, MissOnOtherDefine) {
+    write("main.p4", R"(control c(inout bit<8> x) { apply { x = x + VALUE; } }
+control proto(inout bit<8> x);
+package top(proto p);
+top(c()) main;
+)");
+    auto one = compile({ "-DVALUE=1" });
+    ASSERT_NE(one.program, nullptr);
+    auto two = compile({ "-DVALUE=2" });
+    ASSERT_NE(two.program, nullptr);
+    EXPECT_FALSE(two.hit);
+    EXPECT_NE(one.p4, two.p4);
+    EXPECT_EQ(entries().size(), 2u);
+}
+
+TEST_F(FrontendCacheTest, MissOnOtherSource) {
+    auto first = compile();
+    ASSERT_NE(first.program, nullptr);
+    write("main.p4", std::string(program) + "const bit<8> y = 2;\n");
+    auto changed = compile();
+    ASSERT_NE(changed.program, nullptr);
+    EXPECT_FALSE(changed.hit);
+    EXPECT_NE(first.p4, changed.p4);
+    EXPECT_EQ(entries().size(), 2u);
+}
+
+// A hit would not report the warnings of the front end.
+TEST_F(FrontendCacheTest, WarningsNotCached) {
+    write("main.p4", programWithWarning);
+    auto first = compile();
+    ASSERT_NE(first.program, nullptr);
+    EXPECT_GT(ErrorReporter::instance.getWarningCount(), 0u);
+    EXPECT_TRUE(entries().empty());
+
+    auto second = compile();
+    ASSERT_NE(second.program, nullptr);
+    EXPECT_FALSE(second.hit);
+    EXPECT_GT(ErrorReporter::instance.getWarningCount(), 0u);
+}
+
+// An entry holding another key, as after a hash collision, is a miss,
+// and is replaced.
+TEST_F(FrontendCacheTest, KeyChecked) {
+    ASSERT_NE(compile().program, nullptr);
+    auto files = entries();
+    ASSERT_EQ(files.size(), 1u);
+    std::string data;
+    {
+        std::ifstream in(files[0], std::ios::binary);
+        std::stringstream contents;
+        contents << in.rdbuf();
+        data = contents.str();
+    }
+    // The key ends with the program text.
+    auto pos = data.find("x + 1");
+    ASSERT_NE(pos, std::string::npos);
+    data[pos + 4] = '2';
+    std::ofstream(files[0], std::ios::binary) << data;
+
+    auto result = compile();
+    ASSERT_NE(result.program, nullptr);
+    EXPECT_FALSE(result.hit);
+    EXPECT_NE(result.p4.find("x + 8w1"), std::string::npos) << result.p4;
+    EXPECT_TRUE(compile().hit);
+}
+
+// A hit skips the front end, and so the output it is asked for.
+TEST_F(FrontendCacheTest, NotUsedForFrontendOutput) {
+    ASSERT_NE(compile().program, nullptr);
+
+    std::string pp = dir + "/pp.p4";
+    auto result = compile({ "--pp", pp.c_str() });
+    ASSERT_NE(result.program, nullptr);
+    EXPECT_FALSE(result.hit);
+    EXPECT_EQ(access(pp.c_str(), R_OK), 0);
+    EXPECT_EQ(entries().size(), 1u);
+
+    std::string dump = makeDir("dump");
+    result = compile({ "--top4", "FrontEndLast", "--dump", dump.c_str() });
+    ASSERT_NE(result.program, nullptr);
+    EXPECT_FALSE(result.hit);
+    EXPECT_EQ(entries().size(), 1u);
+}
+
+}  // namespace P4
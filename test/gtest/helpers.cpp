@@ -14,6 +14,10 @@ See the License for the specific language governing permissions and
 limitations under the License.
 */
 
+#include <ftw.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/stat.h>
 #include <fstream>
 #include <sstream>
 #include <stdexcept>
@@ -128,4 +132,32 @@ FrontendTestCase::create(const std::string& source,
     return FrontendTestCase{program};
 }
 
+void TempDirTest::SetUp() {
+    char pattern[] = "/tmp/p4c-test-XXXXXX";
+    ASSERT_NE(mkdtemp(pattern), nullptr);
+    dir = pattern;
+}
+
+void TempDirTest::TearDown() {
+    if (dir.empty())
+        return;
+    // Visit the contents of each directory before the directory itself.
+    auto removeEntry = [](const char* path, const struct stat*, int, struct FTW*) {
+        return ::remove(path);
+    };
+    EXPECT_EQ(nftw(dir.c_str(), removeEntry, 16, FTW_DEPTH | FTW_PHYS), 0);
+}
+
+std::string TempDirTest::makeDir(const std::string& name) const {
+    std::string path = dir + "/" + name;
+    EXPECT_EQ(mkdir(path.c_str(), 0755), 0) << path;
+    return path;
+}
+
+std::string TempDirTest::write(const std::string& name, const std::string& text) const {
+    std::string path = dir + "/" + name;
+    std::ofstream(path) << text;
+    return path;
+}
+
 }  // namespace Test
@@ -98,6 +98,25 @@ struct FrontendTestCase {
     const IR::P4Program* program;
 };
 
+/// A test fixture with a fresh temporary directory, which is removed
+/// together with its contents after the test.
+class TempDirTest : public ::testing::Test {
+ protected:
+    /// The temporary directory.
+    std::string dir;
+
+    void SetUp() override;
+    void TearDown() override;
+
+    /// Creates the directory @name in the temporary directory.
+    /// @return the path of the new directory.
+    std::string makeDir(const std::string& name) const;
+
+    /// Writes @text to the file @name in the temporary directory.
+    /// @return the path of the file.
+    std::string write(const std::string& name, const std::string& text) const;
+};
+
 }  // namespace Test
 
 #endif /* TEST_GTEST_HELPERS_H_ */
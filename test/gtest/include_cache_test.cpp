@@ -0,0 +1,150 @@
+/*
+Copyright 2013-present Barefoot Networks, Inc.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include <dirent.h>
+#include <stdlib.h>
+#include <sys/stat.h>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "helpers.h"
+#include "ir/ir.h"
+#include "frontends/common/options.h"
+#include "frontends/common/parseInput.h"
+#include "frontends/common/resolveReferences/referenceMap.h"
+#include "frontends/p4/frontend.h"
+#include "frontends/p4/toP4/toP4.h"
+#include "frontends/p4/typeMap.h"
+#include "lib/error.h"
+
+namespace P4 {
+
+namespace {
+
+class IncludeCacheTest : public ::Test::TempDirTest {
+ protected:
+    void SetUp() override {
+        ASSERT_NO_FATAL_FAILURE(TempDirTest::SetUp());
+        makeDir("include");
+        makeDir("cache");
+        write("include/arch.p4", "extern E { E(); }\n");
+        write("main.p4", "#include <arch.p4>\n"
+                         "const bit<8> x = 1;\n"
+                         "E() e;\n");
+        setenv("P4C_16_INCLUDE_PATH", (dir + "/include").c_str(), 1);
+    }
+    void TearDown() override {
+        unsetenv("P4C_16_INCLUDE_PATH");
+        TempDirTest::TearDown();
+    }
+
+    /// @returns the include cache entries.
+    std::vector<std::string> entries() {
+        std::vector<std::string> result;
+        std::string cache = dir + "/cache";
+        DIR* d = opendir(cache.c_str());
+        while (auto entry = readdir(d)) {
+            std::string name = entry->d_name;
+            if (name.size() > 6 && name.compare(name.size() - 6, 6, ".p4inc") == 0)
+                result.push_back(cache + "/" + name);
+        }
+        closedir(d);
+        return result;
+    }
+
+    const IR::P4Program* parse(bool builtinPreprocessor) {
+        CompilerOptions options;
+        options.langVersion = CompilerOptions::FrontendVersion::P4_16;
+        options.file = dir + "/main.p4";
+        options.frontendCacheDir = dir + "/cache";
+        options.builtinPreprocessor = builtinPreprocessor;
+        return parseP4File(options);
+    }
+
+    /// The standard include file is parsed once, and taken from the cache
+    /// the second time.
+    void checkCached(bool builtinPreprocessor) {
+        auto program = parse(builtinPreprocessor);
+        ASSERT_NE(program, nullptr);
+        EXPECT_EQ(program->objects.size(), 3u);
+        auto files = entries();
+        ASSERT_EQ(files.size(), 1u);
+        struct stat before;
+        ASSERT_EQ(stat(files[0].c_str(), &before), 0);
+
+        program = parse(builtinPreprocessor);
+        ASSERT_NE(program, nullptr);
+        EXPECT_EQ(program->objects.size(), 3u);
+        EXPECT_EQ(::errorCount(), 0u);
+        files = entries();
+        ASSERT_EQ(files.size(), 1u);
+        struct stat after;
+        ASSERT_EQ(stat(files[0].c_str(), &after), 0);
+        EXPECT_EQ(before.st_ino, after.st_ino);  // not written again
+    }
+};
+
+}  // namespace
+
+TEST_F(IncludeCacheTest, Cpp) {
+    checkCached(false);
+}
+
+TEST_F(IncludeCacheTest, BuiltinPreprocessor) {
+    checkCached(true);
+}
+
+// The references and types of preparsed include files seed the maps of
+// the front end, which then gives the same program as without them.
+TEST_F(IncludeCacheTest, SeededMaps) {
+    write("main.p4", "#include <arch.p4>\n"
+                     "control c(inout bit<8> x) { apply { x = x + 1; } }\n"
+                     "control proto(inout bit<8> x);\n"
+                     "package top(proto p);\n"
+                     "top(c()) main;\n");
+    CompilerOptions options;
+    options.langVersion = CompilerOptions::FrontendVersion::P4_16;
+    options.file = dir + "/main.p4";
+    options.builtinPreprocessor = true;
+    options.incrementalMaps = true;
+    auto toP4 = [](const IR::P4Program* program) {
+        std::stringstream out;
+        ToP4 top4(&out, false);
+        program->apply(top4);
+        return out.str();
+    };
+
+    auto program = parseP4File(options);
+    ASSERT_NE(program, nullptr);
+    ReferenceMap refMap;
+    TypeMap typeMap;
+    EXPECT_FALSE(seedIncludeMaps(program, refMap, typeMap));
+    auto expected = FrontEnd().run(options, program);
+    ASSERT_NE(expected, nullptr);
+
+    ASSERT_TRUE(preparseIncludes(options));
+    program = parseP4File(options);
+    ASSERT_NE(program, nullptr);
+    EXPECT_TRUE(seedIncludeMaps(program, refMap, typeMap));
+    auto seeded = FrontEnd().run(options, program);
+    ASSERT_NE(seeded, nullptr);
+    EXPECT_EQ(::errorCount(), 0u);
+    EXPECT_EQ(toP4(expected), toP4(seeded));
+}
+
+}  // namespace P4
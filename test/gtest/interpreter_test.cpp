@@ -0,0 +1,288 @@
+/*
+Copyright 2013-present Barefoot Networks, Inc.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include "gtest/gtest.h"
+#include "ir/ir.h"
+#include "helpers.h"
+
+#include "frontends/common/parseInput.h"
+#include "frontends/common/resolveReferences/referenceMap.h"
+#include "frontends/p4/typeChecking/typeChecker.h"
+#include "frontends/p4/typeMap.h"
+#include "midend/interpreter.h"
+
+using namespace P4;
+
+namespace {
+
+// header h_t { bit<8> f; }
+const IR::Type_Header* headerType() {
+    static const IR::Type_Header* type = new IR::Type_Header(IR::ID("h_t"),
+        IR::IndexedVector<IR::StructField>({
+            new IR::StructField(IR::ID("f"), IR::Type_Bits::get(8)) }));
+    return type;
+}
+
+// h_t[2]
+const IR::Type_Stack* stackType() {
+    return new IR::Type_Stack(headerType(), new IR::Constant(2));
+}
+
+// struct s_t { h_t a; h_t[2] s; }
+const IR::Type_Struct* structType() {
+    return new IR::Type_Struct(IR::ID("s_t"),
+        IR::IndexedVector<IR::StructField>({
+            new IR::StructField(IR::ID("a"), headerType()),
+            new IR::StructField(IR::ID("s"), stackType()) }));
+}
+
+SymbolicInteger* constant(unsigned value) {
+    return new SymbolicInteger(new IR::Constant(IR::Type_Bits::get(8), value));
+}
+
+// Field f of header hdr, regardless of its validity.
+const SymbolicInteger* field(const SymbolicValue* hdr) {
+    return hdr->to<SymbolicHeader>()->fieldValue.at("f")->to<SymbolicInteger>();
+}
+
+bool isValid(const SymbolicValue* hdr) {
+    auto valid = hdr->to<SymbolicHeader>()->valid;
+    return valid->isKnown() && valid->value;
+}
+
+bool isInvalid(const SymbolicValue* hdr) {
+    auto valid = hdr->to<SymbolicHeader>()->valid;
+    return valid->isKnown() && !valid->value;
+}
+
+// Makes hdr valid, with f set to value.
+void setHeader(SymbolicHeader* hdr, unsigned value) {
+    hdr->setValid(true);
+    hdr->getWritable(nullptr, "f")->assign(constant(value));
+}
+
+}  // namespace
+
+TEST(interpreter, cloneUnaffectedByStructChanges) {
+    TypeMap typeMap;
+    SymbolicValueFactory factory(&typeMap);
+    auto value = factory.create(structType(), false)->to<SymbolicStruct>();
+    auto copy = value->clone()->to<SymbolicStruct>();
+    EXPECT_TRUE(value->equals(copy));
+
+    setHeader(value->getWritable(nullptr, "a")->to<SymbolicHeader>(), 5);
+    EXPECT_TRUE(isValid(value->get(nullptr, "a")));
+    EXPECT_EQ(5, field(value->get(nullptr, "a"))->constant->asInt());
+
+    auto a = copy->get(nullptr, "a");
+    EXPECT_TRUE(isInvalid(a));
+    EXPECT_TRUE(field(a)->isUnknown());
+    EXPECT_FALSE(value->equals(copy));
+
+    // Assigning the original back from the copy leaves the copy alone too.
+    value->assign(copy);
+    EXPECT_TRUE(value->equals(copy));
+    setHeader(value->getWritable(nullptr, "a")->to<SymbolicHeader>(), 6);
+    EXPECT_TRUE(isInvalid(copy->get(nullptr, "a")));
+}
+
+TEST(interpreter, cloneUnaffectedByAssign) {
+    TypeMap typeMap;
+    SymbolicValueFactory factory(&typeMap);
+    auto value = factory.create(headerType(), false)->to<SymbolicHeader>();
+    setHeader(value, 1);
+    auto copy = value->clone();
+
+    auto other = factory.create(headerType(), false)->to<SymbolicHeader>();
+    setHeader(other, 2);
+    value->assign(other);
+    EXPECT_EQ(2, field(value)->constant->asInt());
+    EXPECT_TRUE(isValid(copy));
+    EXPECT_EQ(1, field(copy)->constant->asInt());
+
+    // The source of the assignment is not aliased either.
+    value->getWritable(nullptr, "f")->assign(constant(3));
+    EXPECT_EQ(2, field(other)->constant->asInt());
+
+    value->setValid(false);
+    EXPECT_TRUE(isInvalid(value));
+    EXPECT_TRUE(isValid(copy));
+    EXPECT_EQ(1, field(copy)->constant->asInt());
+}
+
+TEST(interpreter, cloneUnaffectedByShift) {
+    TypeMap typeMap;
+    SymbolicValueFactory factory(&typeMap);
+    auto stack = factory.create(stackType(), false)->to<SymbolicArray>();
+    setHeader(stack->getWritable(nullptr, 0)->to<SymbolicHeader>(), 1);
+    auto copy = stack->clone()->to<SymbolicArray>();
+
+    // push_front(1)
+    stack->shift(1);
+    EXPECT_TRUE(isInvalid(stack->get(nullptr, 0)));
+    EXPECT_TRUE(isValid(stack->get(nullptr, 1)));
+    EXPECT_EQ(1, field(stack->get(nullptr, 1))->constant->asInt());
+    EXPECT_TRUE(isValid(copy->get(nullptr, 0)));
+    EXPECT_TRUE(isInvalid(copy->get(nullptr, 1)));
+
+    // The vacated element is not an alias of the moved one.
+    setHeader(stack->getWritable(nullptr, 0)->to<SymbolicHeader>(), 2);
+    EXPECT_EQ(1, field(stack->get(nullptr, 1))->constant->asInt());
+    stack->getWritable(nullptr, 1)->to<SymbolicHeader>()->setValid(false);
+    EXPECT_TRUE(isValid(stack->get(nullptr, 0)));
+    EXPECT_TRUE(isValid(copy->get(nullptr, 0)));
+    EXPECT_EQ(1, field(copy->get(nullptr, 0))->constant->asInt());
+
+    // pop_front(1)
+    auto copy2 = stack->clone()->to<SymbolicArray>();
+    stack->shift(-1);
+    EXPECT_TRUE(isInvalid(stack->get(nullptr, 0)));
+    EXPECT_TRUE(isInvalid(stack->get(nullptr, 1)));
+    EXPECT_TRUE(isValid(copy2->get(nullptr, 0)));
+    EXPECT_EQ(2, field(copy2->get(nullptr, 0))->constant->asInt());
+    EXPECT_TRUE(isValid(copy->get(nullptr, 0)));
+    EXPECT_TRUE(isInvalid(copy->get(nullptr, 1)));
+}
+
+TEST(interpreter, valueMapCloneUnaffectedByChanges) {
+    TypeMap typeMap;
+    SymbolicValueFactory factory(&typeMap);
+    auto decl = new IR::Declaration_Variable(IR::ID("hdr"), structType());
+    ValueMap values;
+    values.set(decl, factory.create(structType(), false));
+    auto copy = values.clone();
+    EXPECT_TRUE(values.equals(copy));
+
+    auto s = values.getWritable(decl)->to<SymbolicStruct>()->getWritable(nullptr, "s");
+    auto next = s->to<SymbolicArray>()->next(nullptr, true);
+    setHeader(next->to<SymbolicHeader>(), 4);
+    EXPECT_FALSE(values.equals(copy));
+
+    auto copyStack = copy->get(decl)->to<SymbolicStruct>()->get(nullptr, "s");
+    EXPECT_TRUE(isInvalid(copyStack->to<SymbolicArray>()->get(nullptr, 0)));
+    EXPECT_TRUE(isInvalid(copyStack->to<SymbolicArray>()->get(nullptr, 1)));
+
+    // Setting the value back makes the maps equal again.
+    next->to<SymbolicHeader>()->setValid(false);
+    EXPECT_TRUE(values.equals(copy));
+}
+
+TEST(interpreter, evaluationCacheFoldsEachValue) {
+    auto source = P4_SOURCE(R"(
+        control c(inout bit<8> x, out bool b) {
+            apply {
+                x = x + x;
+                b = x < 8w3;
+            }
+        }
+    )");
+    auto program = parseP4String(source, CompilerOptions::FrontendVersion::P4_16);
+    ASSERT_TRUE(program != nullptr);
+    ReferenceMap refMap;
+    TypeMap typeMap;
+    PassManager passes({
+        new TypeChecking(&refMap, &typeMap)
+    });
+    program = program->apply(passes);
+    ASSERT_TRUE(program != nullptr);
+
+    const IR::Parameter* x = nullptr;
+    const IR::Expression* sum = nullptr;
+    const IR::Expression* less = nullptr;
+    forAllMatching<IR::Parameter>(program, [&](const IR::Parameter* p) {
+        if (p->name.name == "x") x = p; });
+    forAllMatching<IR::Add>(program, [&](const IR::Add* e) { sum = e; });
+    forAllMatching<IR::Lss>(program, [&](const IR::Lss* e) { less = e; });
+    ASSERT_TRUE(x != nullptr && sum != nullptr && less != nullptr);
+
+    // The same expressions are evaluated with one cache and different
+    // values of x; each evaluation must fold its own operand values.
+    EvaluationCache cache(&refMap, &typeMap);
+    ValueMap values;
+    auto evaluate = [&](const IR::Expression* expression, int value) {
+        values.set(x, constant(value));
+        ExpressionEvaluator ev(&refMap, &typeMap, &values, &cache);
+        return ev.evaluate(expression, false);
+    };
+    for (int value : { 1, 2, 1, 5 }) {
+        auto s = evaluate(sum, value)->to<SymbolicInteger>();
+        ASSERT_TRUE(s->isKnown());
+        EXPECT_EQ(value + value, s->constant->asInt());
+        auto l = evaluate(less, value)->to<SymbolicBool>();
+        ASSERT_TRUE(l->isKnown());
+        EXPECT_EQ(value < 3, l->value);
+    }
+}
+
+TEST(interpreter, readingDoesNotCopyValues) {
+    auto source = P4_SOURCE(R"(
+        header h_t { bit<8> f; }
+        control c(inout h_t h, out bit<8> y) {
+            apply {
+                y = h.f;
+                h.f = 8w1;
+                h.setInvalid();
+            }
+        }
+    )");
+    auto program = parseP4String(source, CompilerOptions::FrontendVersion::P4_16);
+    ASSERT_TRUE(program != nullptr);
+    ReferenceMap refMap;
+    TypeMap typeMap;
+    PassManager passes({
+        new TypeChecking(&refMap, &typeMap)
+    });
+    program = program->apply(passes);
+    ASSERT_TRUE(program != nullptr);
+
+    const IR::Parameter* h = nullptr;
+    std::vector<const IR::AssignmentStatement*> assignments;
+    const IR::MethodCallExpression* setInvalid = nullptr;
+    forAllMatching<IR::Parameter>(program, [&](const IR::Parameter* p) {
+        if (p->name.name == "h") h = p; });
+    forAllMatching<IR::AssignmentStatement>(program, [&](const IR::AssignmentStatement* s) {
+        assignments.push_back(s); });
+    forAllMatching<IR::MethodCallExpression>(program, [&](const IR::MethodCallExpression* e) {
+        setInvalid = e; });
+    ASSERT_TRUE(h != nullptr && assignments.size() == 2 && setInvalid != nullptr);
+
+    TypeMap valueTypes;
+    SymbolicValueFactory factory(&valueTypes);
+    auto hdr = factory.create(headerType(), false)->to<SymbolicHeader>();
+    setHeader(hdr, 5);
+    ValueMap values;
+    values.set(h, hdr);
+    auto copy = values.clone();
+    EvaluationCache cache(&refMap, &typeMap);
+
+    // Reading h.f leaves h shared with the copy.
+    ExpressionEvaluator(&refMap, &typeMap, &values, &cache).evaluate(assignments[0]->right,
+                                                                     false);
+    EXPECT_EQ(copy->get(h), values.get(h));
+
+    // Writing h.f, or calling a method that modifies h, copies it first.
+    auto f = ExpressionEvaluator(&refMap, &typeMap, &values, &cache).evaluate(
+        assignments[1]->left, true);
+    EXPECT_NE(copy->get(h), values.get(h));
+    f->assign(constant(1));
+    EXPECT_EQ(5, field(copy->get(h))->constant->asInt());
+
+    auto again = values.clone();
+    ExpressionEvaluator(&refMap, &typeMap, &values, &cache).evaluate(setInvalid, false);
+    EXPECT_TRUE(isInvalid(values.get(h)));
+    EXPECT_TRUE(isValid(again->get(h)));
+    EXPECT_TRUE(isValid(copy->get(h)));
+}
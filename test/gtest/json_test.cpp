@@ -14,6 +14,7 @@ See the License for the specific language governing permissions and
 limitations under the License.
 */
 
+#include <sstream>
 #include "gtest/gtest.h"
 #include "lib/json.h"
 
@@ -51,6 +52,29 @@ TEST(Util, Json) {
     obj->emplace("y", arr);
     EXPECT_EQ("{\n  \"x\" : \"x\",\n  \"y\" : [\n    5,\n    \"5\",\n    [true]\n  ]\n}",
               obj->toString());
+
+    std::stringstream compact;
+    obj->serialize(compact, true);
+    EXPECT_EQ("{\"x\":\"x\",\"y\":[5,\"5\",[true]]}", compact.str());
+}
+
+TEST(Util, JsonWriter) {
+    std::stringstream str;
+    {
+        JsonWriter writer(str);
+        writer.beginObject();
+        writer.key("a").beginArray().value(1).beginObject().endObject().endArray();
+        writer.key("b").beginArray().endArray();
+        writer.key("c").value(mpz_class("123456789012345678901234567890"));
+        writer.endObject();
+    }
+    EXPECT_EQ("{\n  \"a\" : [\n    1,\n    {\n    }\n  ],\n  \"b\" : [],\n"
+              "  \"c\" : 123456789012345678901234567890\n}", str.str());
+
+    JsonWriter writer(str);
+    writer.beginObject();
+    EXPECT_THROW(writer.value(1), std::logic_error);
+    EXPECT_THROW(writer.endArray(), std::logic_error);
 }
 
 }  // namespace Util
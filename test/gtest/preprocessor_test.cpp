@@ -0,0 +1,173 @@
+/*
+Copyright 2013-present Barefoot Networks, Inc.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <sys/stat.h>
+#include <string>
+
+#include "gtest/gtest.h"
+#include "helpers.h"
+#include "frontends/common/options.h"
+#include "frontends/common/preprocessor.h"
+#include "lib/error.h"
+
+namespace P4 {
+
+namespace {
+
+class PreprocessorTest : public ::Test::TempDirTest {};
+
+}  // namespace
+
+TEST_F(PreprocessorTest, Macros) {
+    auto file = write("main.p4",
+                      "#define W 32\n"
+                      "#define FIELD(w, n) bit<w> n ## _f;\n"
+                      "#define STR(x) #x\n"
+                      "#define REC REC + 1\n"
+                      "FIELD(W,\n"
+                      "      a)\n"
+                      "STR(x \"y\") REC __LINE__\n");
+    Preprocessor preprocessor({});
+    std::string output;
+    auto errors = ::errorCount();
+    EXPECT_TRUE(preprocessor.process(file, output));
+    EXPECT_EQ(errors, ::errorCount());
+    std::string expected = "# 1 \"" + std::string(file) + "\"\n"
+                           "\n\n\n\n"
+                           "bit<32> a_f;\n\n"
+                           "\"x \\\"y\\\"\" REC + 1 7\n";
+    EXPECT_EQ(expected, output);
+}
+
+// An empty operand of ## is a placemarker: nothing is pasted.
+TEST_F(PreprocessorTest, EmptyPasteOperands) {
+    auto file = write("main.p4",
+                      "#define CAT3(a, x, y) a x ## y\n"
+                      "#define CAT(x, y) x ## y\n"
+                      "CAT3(p, , q)\n"
+                      "CAT(, q) CAT(p, ) CAT(, )x\n");
+    Preprocessor preprocessor({});
+    std::string output;
+    auto errors = ::errorCount();
+    EXPECT_TRUE(preprocessor.process(file, output));
+    EXPECT_EQ(errors, ::errorCount());
+    EXPECT_EQ("# 1 \"" + std::string(file) + "\"\n\n\np q\nq p x\n", output);
+}
+
+// A function-like macro name that ends a line without being called leaves
+// the following lines where they are.
+TEST_F(PreprocessorTest, MacroNameAtEndOfLine) {
+    auto file = write("main.p4",
+                      "#define F(x) x\n"
+                      "a F\n"
+                      "b\n"
+                      "F\n"
+                      "\n"
+                      "(c) d\n"
+                      "e\n");
+    Preprocessor preprocessor({});
+    std::string output;
+    EXPECT_TRUE(preprocessor.process(file, output));
+    EXPECT_EQ("# 1 \"" + std::string(file) + "\"\n\na F\nb\nc d\n\n\ne\n", output);
+}
+
+// A file rewritten with the same size is read again, even within the
+// same second.
+TEST_F(PreprocessorTest, ChangedFileReadAgain) {
+    auto file = write("main.p4", "a\n");
+    struct timespec times[2] = { { 1000000000, 1 }, { 1000000000, 1 } };
+    ASSERT_EQ(0, utimensat(AT_FDCWD, file.c_str(), times, 0));
+    Preprocessor preprocessor({});
+    std::string output;
+    EXPECT_TRUE(preprocessor.process(file, output));
+    EXPECT_EQ("# 1 \"" + std::string(file) + "\"\na\n", output);
+
+    write("main.p4", "b\n");
+    times[0].tv_nsec = times[1].tv_nsec = 2;
+    ASSERT_EQ(0, utimensat(AT_FDCWD, file.c_str(), times, 0));
+    output.clear();
+    EXPECT_TRUE(Preprocessor({}).process(file, output));
+    EXPECT_EQ("# 1 \"" + std::string(file) + "\"\nb\n", output);
+}
+
+TEST_F(PreprocessorTest, Conditionals) {
+    auto file = write("main.p4",
+                      "#if defined(A) && A > 1\n"
+                      "big\n"
+                      "#elif defined B\n"
+                      "b\n"
+                      "#else\n"
+                      "none\n"
+                      "#endif\n");
+    Preprocessor preprocessor({});
+    preprocessor.define("A=1");
+    preprocessor.define("B");
+    std::string output;
+    EXPECT_TRUE(preprocessor.process(file, output));
+    EXPECT_EQ("# 1 \"" + std::string(file) + "\"\n\n\n\nb\n\n\n\n", output);
+}
+
+TEST_F(PreprocessorTest, Include) {
+    write("arch.p4",
+          "#pragma once\n"
+          "extern E;\n");
+    auto file = write("main.p4",
+                      "#include <arch.p4>\n"
+                      "#include \"arch.p4\"\n"
+                      "x\n");
+    Preprocessor preprocessor({ dir });
+    std::string output;
+    EXPECT_TRUE(preprocessor.process(file, output));
+    std::string main = "\"" + std::string(file) + "\"\n";
+    std::string arch = "\"" + dir + "/arch.p4\"\n";
+    EXPECT_EQ("# 1 " + main + "# 1 " + arch + "\nextern E;\n# 2 " + main + "\n" + "x\n",
+              output);
+}
+
+// The -I, -D and -U options of --builtin-cpp accept their argument
+// as a separate word.
+TEST_F(PreprocessorTest, SeparateOptionArguments) {
+    write("arch.p4", "extern E;\n");
+    auto file = write("main.p4",
+                      "#include <arch.p4>\n"
+                      "#ifdef A\n"
+                      "a\n"
+                      "#endif\n"
+                      "#ifdef B\n"
+                      "b\n"
+                      "#endif\n");
+    CompilerOptions options;
+    options.file = file;
+    options.preprocessor_options = cstring(" -I " + dir + " -D A -D B -U B");
+    auto warnings = ErrorReporter::instance.getWarningCount();
+    auto errors = ::errorCount();
+    FILE* in = options.preprocessBuiltin();
+    ASSERT_NE(in, nullptr);
+    std::string output;
+    char buffer[256];
+    while (size_t count = fread(buffer, 1, sizeof(buffer), in))
+        output.append(buffer, count);
+    fclose(in);
+    EXPECT_EQ(warnings, ErrorReporter::instance.getWarningCount());
+    EXPECT_EQ(errors, ::errorCount());
+    EXPECT_NE(output.find("extern E;"), std::string::npos) << output;
+    EXPECT_NE(output.find("\na\n"), std::string::npos) << output;
+    EXPECT_EQ(output.find("\nb\n"), std::string::npos) << output;
+}
+
+}  // namespace P4
@@ -0,0 +1,100 @@
+/*
+Copyright 2013-present Barefoot Networks, Inc.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include "gtest/gtest.h"
+#include "ir/ir.h"
+#include "helpers.h"
+
+#include "frontends/common/parseInput.h"
+#include "frontends/common/resolveReferences/referenceMap.h"
+#include "frontends/common/resolveReferences/resolveReferences.h"
+#include "frontends/p4/simplify.h"
+#include "frontends/p4/typeChecking/typeChecker.h"
+#include "frontends/p4/typeMap.h"
+
+using namespace P4;
+
+namespace {
+
+// Counts the if statements in a program.
+class CountIfs : public Inspector {
+ public:
+    unsigned count = 0;
+    bool preorder(const IR::IfStatement*) override { count++; return true; }
+};
+
+// Runs SimplifyControlFlow on a program where empty if statements appear
+// in a control, in an action, and in the abstract method implemented by a
+// top-level instance, with @p jobs threads.
+void simplifyAll(unsigned jobs) {
+    std::string source = P4_SOURCE(R"(
+        extern Virtual {
+            Virtual();
+            abstract bit<16> f(in bit<16> ix);
+        }
+        Virtual() v = {
+            bit<16> f(in bit<16> ix) {
+                if (ix > 1) { }
+                return ix + 1;
+            }
+        };
+        action a(inout bit<16> x) { if (x > 2) { } x = 1; }
+        control c(inout bit<16> p) {
+            apply { if (p > 3) { } a(p); p = v.f(p); }
+        }
+        control proto(inout bit<16> p);
+        package top(proto p);
+        top(c()) main;
+    )");
+    auto program = P4::parseP4String(source, CompilerOptions::FrontendVersion::P4_16);
+    ASSERT_TRUE(program != nullptr);
+
+    CountIfs before;
+    program->apply(before);
+    ASSERT_EQ(3u, before.count);
+
+    unsigned saved = ApplyToDeclarations::jobs;
+    ApplyToDeclarations::jobs = jobs;
+    ReferenceMap refMap;
+    TypeMap typeMap;
+    PassManager passes = {
+        new ResolveReferences(&refMap),
+        new TypeInference(&refMap, &typeMap, false),
+        new SimplifyControlFlow(&refMap, &typeMap)
+    };
+    program = program->apply(passes);
+    ApplyToDeclarations::jobs = saved;
+    ASSERT_TRUE(program != nullptr);
+
+    CountIfs after;
+    program->apply(after);
+    EXPECT_EQ(0u, after.count);
+    // the declarations stay in the original order
+    ASSERT_EQ(7u, program->declarations.size());
+    EXPECT_TRUE(program->declarations.at(1)->is<IR::Declaration_Instance>());
+    EXPECT_TRUE(program->declarations.at(2)->is<IR::P4Action>());
+}
+
+}  // namespace
+
+TEST(simplify, controlFlow) {
+    simplifyAll(1);
+}
+
+// In builds with MULTITHREAD the declarations are simplified on several threads.
+TEST(simplify, controlFlowParallel) {
+    simplifyAll(4);
+}
@@ -69,6 +69,10 @@ TEST(UtilSourceFile, InputSources) {
     cstring sl = sources.getLine(2);
     EXPECT_EQ("Second line\n", sl);
 
+    cstring tl = sources.getLine(3);
+    EXPECT_EQ("Third line\n", tl);
+    EXPECT_EQ("", sources.getLine(4));
+
     SourceFileLine original = sources.getSourceLine(3);
     EXPECT_EQ("fakesource.p4", original.fileName);
     EXPECT_EQ(5u, original.sourceLine);
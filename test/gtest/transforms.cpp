@@ -37,3 +37,39 @@ TEST(IR, Transform) {
     auto* n = e->apply(TestTrans(c));
     EXPECT_EQ(e, n);
 }
+
+TEST(IR, TransformCloneOnlyOnChange) {
+    struct TestTrans : public Transform {
+        TestTrans() { cloneOnlyOnChange = true; }
+
+        const IR::Node* postorder(IR::Constant* c) override {
+            if (c->value == 2)
+                return new IR::Constant(3);
+            return c;
+        }
+    };
+
+    auto c1 = new IR::Constant(1);
+    auto c2 = new IR::Constant(2);
+    auto left = new IR::Add(Util::SourceInfo(), c1, c1);
+    auto right = new IR::Sub(Util::SourceInfo(), c1, c2);
+    IR::Expression* e = new IR::Mul(Util::SourceInfo(), left, right);
+
+    TestTrans trans;
+    // Visit twice, so that the node types without a preorder/postorder are known.
+    for (int i = 0; i < 2; i++) {
+        auto* n = e->apply(trans);
+        ASSERT_NE(e, n);
+        auto mul = n->to<IR::Mul>();
+        ASSERT_NE(nullptr, mul);
+        EXPECT_EQ(left, mul->left);
+        auto sub = mul->right->to<IR::Sub>();
+        ASSERT_NE(nullptr, sub);
+        EXPECT_NE(right, sub);
+        EXPECT_EQ(c1, sub->left);
+        EXPECT_EQ(3, sub->right->to<IR::Constant>()->value);
+    }
+
+    IR::Expression* unchanged = new IR::Mul(Util::SourceInfo(), left, left);
+    EXPECT_EQ(unchanged, unchanged->apply(trans));
+}
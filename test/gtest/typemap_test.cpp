@@ -0,0 +1,196 @@
+/*
+Copyright 2013-present Barefoot Networks, Inc.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include "gtest/gtest.h"
+#include "ir/ir.h"
+#include "helpers.h"
+
+#include "frontends/common/parseInput.h"
+#include "frontends/common/resolveReferences/referenceMap.h"
+#include "frontends/common/resolveReferences/resolveReferences.h"
+#include "frontends/p4/typeChecking/typeChecker.h"
+#include "frontends/p4/typeMap.h"
+
+using namespace P4;
+
+TEST(typeMap, canonicalTuples) {
+    TypeMap typeMap;
+    auto b8 = IR::Type_Bits::get(8);
+    auto tuple = new IR::Type_Tuple(IR::Vector<IR::Type>({ b8, IR::Type_Boolean::get() }));
+    auto same = new IR::Type_Tuple(IR::Vector<IR::Type>({ b8, IR::Type_Boolean::get() }));
+    auto other = new IR::Type_Tuple(IR::Vector<IR::Type>({ IR::Type_Boolean::get(), b8 }));
+
+    EXPECT_EQ(TypeMap::hash(tuple), TypeMap::hash(same));
+    EXPECT_EQ(tuple, typeMap.getCanonical(tuple));
+    EXPECT_EQ(tuple, typeMap.getCanonical(same));
+    EXPECT_EQ(other, typeMap.getCanonical(other));
+    EXPECT_EQ(tuple, typeMap.getCanonical(same));
+}
+
+TEST(typeMap, canonicalStacks) {
+    TypeMap typeMap;
+    auto b8 = IR::Type_Bits::get(8);
+    auto stack = new IR::Type_Stack(b8, new IR::Constant(4));
+    auto same = new IR::Type_Stack(b8, new IR::Constant(4));
+    auto other = new IR::Type_Stack(b8, new IR::Constant(2));
+
+    EXPECT_EQ(stack, typeMap.getCanonical(stack));
+    EXPECT_EQ(other, typeMap.getCanonical(other));
+    EXPECT_EQ(stack, typeMap.getCanonical(same));
+}
+
+namespace {
+
+const char* incrementalProgram = R"(
+    action a(inout bit<8> x) { x = x + 1; }
+    control c(inout bit<8> x) { apply { a(x); x = x + 2; } }
+    control d(inout bit<8> y) { apply { y = 3; } }
+    control proto(inout bit<8> x);
+    package top(proto p1, proto p2);
+    top(c(), d()) main;
+)";
+
+// Replaces constant @from with @to in the top-level declaration @decl.
+class ReplaceConstant : public Transform {
+    cstring decl;
+    unsigned from, to;
+
+ public:
+    ReplaceConstant(cstring decl, unsigned from, unsigned to) :
+            decl(decl), from(from), to(to) { setName("ReplaceConstant"); }
+    const IR::Node* postorder(IR::Constant* constant) override {
+        auto ctxt = findContext<IR::IDeclaration>();
+        if (ctxt == nullptr || ctxt->getName() != decl || constant->value != from)
+            return constant;
+        return new IR::Constant(constant->type, to);
+    }
+};
+
+// Checks that the maps computed incrementally for a program
+// are the same as the ones computed from scratch.
+class CompareMaps : public Inspector {
+    const ReferenceMap& refMap;
+    const TypeMap& typeMap;
+    const ReferenceMap& fullRefMap;
+    const TypeMap& fullTypeMap;
+
+    static const IR::Type* unwrap(const IR::Type* type) {
+        if (auto tt = type->to<IR::Type_Type>())
+            return tt->type;
+        return type;
+    }
+
+ public:
+    CompareMaps(const ReferenceMap& refMap, const TypeMap& typeMap,
+                const ReferenceMap& fullRefMap, const TypeMap& fullTypeMap) :
+            refMap(refMap), typeMap(typeMap), fullRefMap(fullRefMap), fullTypeMap(fullTypeMap)
+    { visitDagOnce = false; }
+    bool preorder(const IR::Path* path) override {
+        EXPECT_EQ(fullRefMap.getDeclaration(path), refMap.getDeclaration(path));
+        return true;
+    }
+    bool preorder(const IR::Node* node) override {
+        auto full = fullTypeMap.getType(node);
+        auto type = typeMap.getType(node);
+        EXPECT_EQ(full == nullptr, type == nullptr) << node->toString();
+        if (full == nullptr || type == nullptr)
+            return true;
+        EXPECT_TRUE(TypeMap::equivalent(full, type)) << node->toString();
+        // controls and parsers are their own types
+        if (unwrap(full)->is<IR::IApply>())
+            EXPECT_EQ(unwrap(full), unwrap(type)) << node->toString();
+        if (auto expr = node->to<IR::Expression>()) {
+            EXPECT_EQ(fullTypeMap.isLeftValue(expr), typeMap.isLeftValue(expr)) << node->toString();
+            EXPECT_EQ(fullTypeMap.isCompileTimeConstant(expr),
+                      typeMap.isCompileTimeConstant(expr)) << node->toString();
+        }
+        return true;
+    }
+};
+
+// Type-checks @program, inserting casts, and returns the result.
+const IR::P4Program* typeCheck(const IR::P4Program* program,
+                               ReferenceMap& refMap, TypeMap& typeMap) {
+    refMap.setIncremental(true);
+    typeMap.setIncremental(true);
+    PassManager passes = {
+        new ResolveReferences(&refMap),
+        new TypeInference(&refMap, &typeMap, false)
+    };
+    return program->apply(passes);
+}
+
+// Type-checks @program with @refMap and @typeMap, and checks that the
+// result is the same as type-checking it with new maps.
+void checkIncremental(const IR::P4Program* program, ReferenceMap& refMap, TypeMap& typeMap) {
+    PassManager typeChecking = {
+        new ClearTypeMap(&typeMap),
+        new TypeChecking(&refMap, &typeMap)
+    };
+    auto result = program->apply(typeChecking);
+    ASSERT_EQ(program, result);
+
+    ReferenceMap fullRefMap;
+    TypeMap fullTypeMap;
+    result = program->apply(TypeChecking(&fullRefMap, &fullTypeMap));
+    ASSERT_EQ(program, result);
+    program->apply(CompareMaps(refMap, typeMap, fullRefMap, fullTypeMap));
+}
+
+}  // namespace
+
+TEST(typeMap, incrementalControl) {
+    auto program = P4::parseP4String(P4_SOURCE(incrementalProgram),
+                                     CompilerOptions::FrontendVersion::P4_16);
+    ASSERT_TRUE(program != nullptr);
+
+    ReferenceMap refMap;
+    TypeMap typeMap;
+    program = typeCheck(program, refMap, typeMap);
+    ASSERT_TRUE(program != nullptr);
+
+    auto changed = program->apply(ReplaceConstant("d", 3, 4));
+    ASSERT_NE(program, changed);
+    checkIncremental(changed, refMap, typeMap);
+    // only d has been type-checked again
+    for (auto decl : changed->declarations) {
+        bool replaced = decl->to<IR::IDeclaration>()->getName() == "d";
+        EXPECT_EQ(!replaced, typeMap.isRetained(changed, decl)) << decl->toString();
+    }
+}
+
+TEST(typeMap, incrementalAction) {
+    auto program = P4::parseP4String(P4_SOURCE(incrementalProgram),
+                                     CompilerOptions::FrontendVersion::P4_16);
+    ASSERT_TRUE(program != nullptr);
+
+    ReferenceMap refMap;
+    TypeMap typeMap;
+    program = typeCheck(program, refMap, typeMap);
+    ASSERT_TRUE(program != nullptr);
+
+    auto changed = program->apply(ReplaceConstant("a", 1, 5));
+    ASSERT_NE(program, changed);
+    checkIncremental(changed, refMap, typeMap);
+    EXPECT_FALSE(typeMap.isRetained(changed, changed->getDeclByName("a")->getNode()));
+    EXPECT_TRUE(typeMap.isRetained(changed, changed->getDeclByName("c")->getNode()));
+
+    // a second change is also applied incrementally
+    auto again = changed->apply(ReplaceConstant("d", 3, 7));
+    ASSERT_NE(changed, again);
+    checkIncremental(again, refMap, typeMap);
+    EXPECT_TRUE(typeMap.isRetained(again, again->getDeclByName("a")->getNode()));
+}
@@ -82,15 +82,19 @@ void IrDefinitions::generate(std::ostream &t, std::ostream &out, std::ostream &i
 
     impl << "#include \"ir/ir.h\"\n"
          << "#include \"ir/visitor.h\"\n"
-         << "#include \"ir/json_loader.h\"\n" << std::endl;
+         << "#include \"ir/json_loader.h\"\n"
+         << "#include \"ir/binary_loader.h\"\n" << std::endl;
 
     out << "#include <map>\n"
         << "#include <functional>\n" << std::endl
         << "class JSONLoader;\n"
         << "using NodeFactoryFn = IR::Node*(*)(JSONLoader&);\n"
+        << "class BinaryLoader;\n"
+        << "using BinaryNodeFactoryFn = IR::Node*(*)(BinaryLoader&);\n"
         << std::endl
         << "namespace IR {\n"
         << "extern std::map<cstring, NodeFactoryFn> unpacker_table;\n"
+        << "extern std::map<cstring, BinaryNodeFactoryFn> binary_unpacker_table;\n"
         << "}\n";
 
     impl << "std::map<cstring, NodeFactoryFn> IR::unpacker_table = {\n";
@@ -108,6 +112,24 @@ void IrDefinitions::generate(std::ostream &t, std::ostream &out, std::ostream &i
             impl << cls->name << "::fromJSON)}"; } }
     impl << " };\n" << std::endl;
 
+    // The binary loader looks node types up by the name written by
+    // toBinary, which for vectors is their node_type_name().
+    impl << "std::map<cstring, BinaryNodeFactoryFn> IR::binary_unpacker_table = {\n"
+         << "{\"Vector<Node>\", binaryNodeFactory<IR::Vector<IR::Node>>},\n"
+         << "{\"IndexedVector<Node>\", binaryNodeFactory<IR::IndexedVector<IR::Node>>}";
+    for (auto cls : *getClasses()) {
+        if (cls->kind == NodeKind::Concrete)
+            impl << ",\n{\"" << cls->name << "\", BinaryNodeFactoryFn(&IR::"
+                 << cls->containedIn << cls->name << "::fromBinary)}";
+        if (cls->needVector || cls->needIndexedVector)
+            impl << ",\n{\"Vector<" << cls->name << ">\", binaryNodeFactory<IR::Vector<IR::"
+                 << cls->containedIn << cls->name << ">>}";
+        if (cls->needIndexedVector)
+            impl << ",\n{\"IndexedVector<" << cls->name << ">\", "
+                 << "binaryNodeFactory<IR::IndexedVector<IR::"
+                 << cls->containedIn << cls->name << ">>}"; }
+    impl << " };\n" << std::endl;
+
     for (auto e : elements) {
         e->generate_hdr(out);
         e->generate_impl(impl); }
@@ -142,13 +164,64 @@ void IrDefinitions::generate(std::ostream &t, std::ostream &out, std::ostream &i
             BUG("visitable (non-inline) NodeMap not yet implemented"); }
     t << std::endl;
 
+    // Every class except the nested ones gets a type ID, which with the table
+    // of ancestors lets Node::is/to test types without a dynamic_cast.  ID 0
+    // is reserved for classes that have none (Node, the templates).
+    std::vector<const IrClass *> typed = { IrClass::ideclaration };
+    for (auto cls : *getClasses())
+        if (cls->kind != NodeKind::Nested)
+            typed.push_back(cls);
+    std::map<const IrClass *, unsigned> typeIds;
+    for (auto cls : typed)
+        typeIds.emplace(cls, typeIds.size() + 1);
+    size_t idCount = typed.size() + 1, idWords = (idCount + 63) / 64;
+
+    t << "#include <stdint.h>" << std::endl;
     t << "namespace IR {" << std::endl;
+    IrClass::ideclaration->declare(t);
     for (auto cls : *getClasses()) {
         enter_namespace(t, cls->containedIn);
         cls->declare(t);
         exit_namespace(t, cls->containedIn);
     }
+    t << std::endl
+      << "typedef unsigned TypeId;" << std::endl
+      << "template<class T> struct NodeTypeId { static constexpr TypeId value = 0; };"
+      << std::endl;
+    for (auto cls : typed)
+        t << "template<> struct NodeTypeId<" << cls->containedIn << cls->name << "> "
+          << "{ static constexpr TypeId value = " << typeIds.at(cls) << "; };" << std::endl;
+    t << "extern const uint64_t typeAncestors[" << idCount << "][" << idWords << "];"
+      << std::endl
+      << "/// True if the class with ID @p type is, or derives from, the one with ID @p base."
+      << std::endl
+      << "inline bool typeIsA(TypeId type, TypeId base) {" << std::endl
+      << "    return (typeAncestors[type][base / 64] >> (base % 64)) & 1; }" << std::endl;
     t << "}  // namespace IR" << std::endl;
+
+    impl << "const uint64_t IR::typeAncestors[" << idCount << "][" << idWords << "] = {"
+         << std::endl << "{}";
+    for (auto cls : typed) {
+        std::vector<uint64_t> bits(idWords);
+        std::set<const IrClass *> ancestors = { cls };
+        cls->getAncestors(ancestors);
+        for (auto a : ancestors) {
+            auto it = typeIds.find(a);
+            if (it != typeIds.end())
+                bits[it->second / 64] |= uint64_t(1) << (it->second % 64); }
+        impl << "," << std::endl << "{";
+        const char *sep = "";
+        for (auto word : bits) {
+            impl << sep << "0x" << std::hex << word << std::dec << "ULL";
+            sep = ", "; }
+        impl << "}  /* " << cls->containedIn << cls->name << " */"; }
+    impl << " };" << std::endl << std::endl;
+}
+
+void IrClass::getAncestors(std::set<const IrClass *> &out) const {
+    for (auto p : parentClasses)
+        if (out.insert(p).second)
+            p->getAncestors(out);
 }
 
 void IrClass::generateTreeMacro(std::ostream &out) const {
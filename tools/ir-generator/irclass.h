@@ -19,6 +19,7 @@ limitations under the License.
 
 #include <vector>
 #include <map>
+#include <set>
 #include <stdexcept>
 
 #include "lib/cstring.h"
@@ -262,6 +263,8 @@ class IrClass : public IrElement {
     void resolve() override;
     cstring toString() const override { return name; }
     std::string fullName() const;
+    /// Add all direct and indirect base classes to @out.
+    void getAncestors(std::set<const IrClass *> &out) const;
     Util::Enumerator<IrField*>* getFields() const;
     Util::Enumerator<IrMethod*>* getUserMethods() const;
 };
@@ -169,6 +169,39 @@ const ordered_map<cstring, IrMethod::info_t> IrMethod::Generate = {
         buf << "{ return new " << cl->name << "(json); }";
         return buf.str();
     } } },
+{ "toBinary", { &NamedType::Void, {
+        new IrField(new ReferenceType(&NamedType::BinaryGenerator), "bin")
+    }, CONST + IN_IMPL + OVERRIDE + INCL_NESTED,
+    [](IrClass *cl, Util::SourceInfo, cstring) -> cstring {
+        std::stringstream buf;
+        buf << "{" << std::endl;
+        if (auto parent = cl->getParent())
+            buf << cl->indent << parent->name << "::toBinary(bin);" << std::endl;
+        for (auto f : *cl->getFields())
+            buf << cl->indent << "bin << this->" << f->name << ";" << std::endl;
+        buf << "}";
+        return buf.str(); } } },
+{ "BinaryLoader", { nullptr, {
+        new IrField(new ReferenceType(&NamedType::BinaryLoader), "bin")
+    }, IN_IMPL + CONSTRUCTOR + INCL_NESTED,
+    [](IrClass *cl, Util::SourceInfo, cstring) -> cstring {
+        // Fields are read back in exactly the order toBinary wrote them.
+        std::stringstream buf;
+        if (auto parent = cl->getParent())
+            buf << ": " << parent->name << "(bin)";
+        buf << " {" << std::endl;
+        for (auto f : *cl->getFields())
+            buf << cl->indent << "bin >> " << f->name << ";" << std::endl;
+        buf << "}";
+        return buf.str(); } } },
+{ "fromBinary", { nullptr, {
+        new IrField(new ReferenceType(&NamedType::BinaryLoader), "bin"),
+    }, FACTORY + IN_IMPL + CONCRETE_ONLY + INCL_NESTED,
+    [](IrClass *cl, Util::SourceInfo, cstring) -> cstring {
+        std::stringstream buf;
+        buf << "{ return new " << cl->name << "(bin); }";
+        return buf.str();
+    } } },
 { "toString", { &NamedType::Cstring, {}, CONST + IN_IMPL + OVERRIDE + NOT_DEFAULT,
     [](IrClass *, Util::SourceInfo, cstring) -> cstring { return cstring(); } } },
 };
@@ -239,7 +272,7 @@ void IrClass::generateMethods() {
         if (!IrMethod::Generate.count(m->name))
             throw Util::CompilationError("Unrecognized predefined method %1%", m->name);
         auto &info = IrMethod::Generate.at(m->name);
-        if (m->name) {
+        if (!(info.flags & CONSTRUCTOR)) {
             if (info.rtype) {
                 // This predefined method has an explicit return type.
                 m->rtype = info.rtype;
@@ -59,6 +59,7 @@ NamedType NamedType::Bool("bool"), NamedType::Int("int"), NamedType::Void("void"
           NamedType::Unordered_Set(new LookupScope("std"), "unordered_set"),
           NamedType::JSONGenerator("JSONGenerator"), NamedType::JSONLoader("JSONLoader"),
           NamedType::JsonObject("JsonObject"),
+          NamedType::BinaryGenerator("BinaryGenerator"), NamedType::BinaryLoader("BinaryLoader"),
           NamedType::SourceInfo(new LookupScope("Util"), "SourceInfo");
 
 cstring NamedType::toString() const {
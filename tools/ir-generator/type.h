@@ -88,7 +88,7 @@ class NamedType : public Type {
         return (lookup == t.lookup || (lookup && t.lookup && *lookup == *t.lookup)); }
 
     static NamedType Bool, Int, Void, Cstring, Ostream, Visitor, Unordered_Set, JSONGenerator,
-        JSONLoader, JsonObject, SourceInfo;
+        JSONLoader, JsonObject, BinaryGenerator, BinaryLoader, SourceInfo;
 };
 
 class TemplateInstantiation : public Type {